@@ -0,0 +1,379 @@
+#include "db/database.hpp"
+#include "storage/lsm/engine/lsm_engine.hpp"
+#include "storage/btree/btree_engine.hpp"
+#include "common/utils/histogram.hpp"
+#include "common/utils/logger.hpp"
+#include "common/utils/thread_pool.hpp"
+#include "config.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * end-to-end engine benchmark through Database, in the spirit of LevelDB's
+ * db_bench.
+ *
+ *   db_bench [--benchmarks fillseq,fillrandom,...] [--num <keys>] [--reads <ops>]
+ *            [--threads <n>] [--key_size <bytes>] [--value_size <bytes>]
+ *            [--batch_size <ops>] [--scan_length <entries>] [--read_percent <0-100>]
+ *            [--engine lsm|btree] [--db <dir>] [--use_existing_db 0|1]
+ *            [--memtable_bytes <n>] [--block_cache_bytes <n>] [--pool_threads <n>]
+ *            [--page_size <n>] [--buffer_pool_bytes <n>] [--direct_io 0|1] [--seed <n>]
+ *
+ * benchmarks run in the order given, against the same database:
+ *
+ *   fillseq      num puts of keys in order, each thread a contiguous slice
+ *   fillrandom   num puts of random keys
+ *   overwrite    num puts of random keys, meant to run after a fill
+ *   readrandom   reads gets of random keys, most of which exist after a fill
+ *   readmissing  reads gets of keys that are never written
+ *   seekrandom   reads cursors seeked to a random key, each reading scan_length entries
+ *   readseq      one full scan per thread
+ *   mixed        reads ops, read_percent of them gets and the rest puts, of random keys
+ *
+ * each reports ops/s, MB/s of keys and values moved, and per-op latency
+ * percentiles in microseconds over all threads. fills with batch_size > 1
+ * time each WriteBatch as one op.
+ */
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    std::string benchmarks = "fillseq,fillrandom,overwrite,readrandom,readmissing,seekrandom,readseq,mixed";
+    size_t num = 1'000'000;
+    size_t reads = 0; // 0 means num
+    int threads = 1;
+    size_t keySize = 16;
+    size_t valueSize = 100;
+    size_t batchSize = 1;
+    size_t scanLength = 100;
+    int readPercent = 90;
+    EngineType engine = EngineType::LSM;
+    std::filesystem::path db = "data-bench";
+    bool useExistingDb = false;
+    size_t memtableBytes = LSM_MEMTABLE_BYTES;
+    size_t blockCacheBytes = LSM_BLOCK_CACHE_BYTES;
+    size_t poolThreads = THREAD_POOL_THREADS;
+    uint32_t pageSize = BTREE_PAGE_SIZE;
+    size_t bufferPoolBytes = BTREE_BUFFER_POOL_BYTES;
+    bool directIO = BTREE_DIRECT_IO;
+    uint64_t seed = 301;
+};
+
+[[noreturn]] void usage(const std::string& error) {
+    std::cerr << error << "\nsee the comment at the top of bench/db_bench.cpp for the options\n";
+    std::exit(EXIT_FAILURE);
+}
+
+Options parseOptions(int argc, char** argv) {
+    Options o;
+    for (int i = 1; i < argc; i += 2) {
+        std::string flag = argv[i];
+        if (i + 1 >= argc) usage("Missing value for " + flag);
+        std::string value = argv[i + 1];
+        auto number = [&]() { return std::strtoull(value.c_str(), nullptr, 10); };
+        if (flag == "--benchmarks") o.benchmarks = value;
+        else if (flag == "--num") o.num = number();
+        else if (flag == "--reads") o.reads = number();
+        else if (flag == "--threads") o.threads = std::max(1, std::atoi(value.c_str()));
+        else if (flag == "--key_size") o.keySize = number();
+        else if (flag == "--value_size") o.valueSize = number();
+        else if (flag == "--batch_size") o.batchSize = std::max<size_t>(1, number());
+        else if (flag == "--scan_length") o.scanLength = number();
+        else if (flag == "--read_percent") o.readPercent = std::clamp(std::atoi(value.c_str()), 0, 100);
+        else if (flag == "--db") o.db = value;
+        else if (flag == "--use_existing_db") o.useExistingDb = value != "0";
+        else if (flag == "--memtable_bytes") o.memtableBytes = number();
+        else if (flag == "--block_cache_bytes") o.blockCacheBytes = number();
+        else if (flag == "--pool_threads") o.poolThreads = number();
+        else if (flag == "--page_size") o.pageSize = static_cast<uint32_t>(number());
+        else if (flag == "--buffer_pool_bytes") o.bufferPoolBytes = number();
+        else if (flag == "--direct_io") o.directIO = value != "0";
+        else if (flag == "--seed") o.seed = number();
+        else if (flag == "--engine") {
+            if (value != "lsm" && value != "btree") usage("Unknown engine " + value + ", expected lsm or btree");
+            o.engine = value == "btree" ? EngineType::BTREE : EngineType::LSM;
+        } else {
+            usage("Unknown option " + flag);
+        }
+    }
+    if (o.reads == 0) o.reads = o.num;
+    if (o.num == 0) usage("--num must be at least 1");
+    if (o.keySize < 8) usage("--key_size must be at least 8");
+    return o;
+}
+
+// key for index i: zero-padded decimal, keySize bytes. missing keys get a
+// suffix no written key has
+std::string makeKey(uint64_t i, size_t keySize, bool missing = false) {
+    std::string key(keySize, '0');
+    for (size_t pos = keySize; pos > 0 && i > 0; --pos, i /= 10) key[pos - 1] = static_cast<char>('0' + i % 10);
+    if (missing) key.push_back('.');
+    return key;
+}
+
+// a megabyte of half-compressible data that values are cut from, so block
+// compression sees something realistic
+class ValueSource {
+public:
+    explicit ValueSource(uint64_t seed) {
+        std::mt19937_64 rng(seed);
+        data.resize(1 << 20);
+        for (size_t i = 0; i < data.size(); i += 2) {
+            data[i] = static_cast<char>(' ' + rng() % 95);
+            data[i + 1] = data[i];
+        }
+    }
+
+    std::string_view next(size_t size) {
+        if (pos + size > data.size()) pos = 0;
+        std::string_view v(data.data() + pos, std::min(size, data.size()));
+        pos += size;
+        return v;
+    }
+
+private:
+    std::string data;
+    size_t pos = 0;
+};
+
+struct ThreadResult {
+    Histogram latency; // nanoseconds per op
+    uint64_t ops = 0;
+    uint64_t bytes = 0;
+    uint64_t found = 0;
+};
+
+class Benchmark {
+public:
+    explicit Benchmark(Options options) : o(std::move(options)) {}
+
+    void run() {
+        if (!o.useExistingDb) std::filesystem::remove_all(o.db);
+        open();
+        printHeader();
+
+        std::stringstream names(o.benchmarks);
+        std::string name;
+        while (std::getline(names, name, ',')) {
+            if (name.empty()) continue;
+            std::function<void(int, ThreadResult&)> body;
+            if (name == "fillseq") body = [this](int t, ThreadResult& r) { fill(t, r, false); };
+            else if (name == "fillrandom" || name == "overwrite") body = [this](int t, ThreadResult& r) { fill(t, r, true); };
+            else if (name == "readrandom") body = [this](int t, ThreadResult& r) { readRandom(t, r, false); };
+            else if (name == "readmissing") body = [this](int t, ThreadResult& r) { readRandom(t, r, true); };
+            else if (name == "seekrandom") body = [this](int t, ThreadResult& r) { seekRandom(t, r); };
+            else if (name == "readseq") body = [this](int, ThreadResult& r) { readSeq(r); };
+            else if (name == "mixed") body = [this](int t, ThreadResult& r) { mixed(t, r); };
+            else {
+                std::cerr << "Unknown benchmark " << name << ", skipped\n";
+                continue;
+            }
+            report(name, runThreads(body));
+        }
+    }
+
+private:
+    Options o;
+    std::unique_ptr<Database> db;
+
+    void open() {
+        std::unique_ptr<StorageEngine> engine;
+        if (o.engine == EngineType::BTREE) {
+            engine = std::make_unique<BTreeEngine>(o.db / "btree.db", o.pageSize, o.bufferPoolBytes, o.directIO);
+        } else {
+            engine = std::make_unique<LSMEngine>(o.db / "db.wal", o.memtableBytes, (o.db / "segments").string(),
+                                                 o.blockCacheBytes, MemoryBudget::process(),
+                                                 std::make_shared<ThreadPool>(o.poolThreads));
+        }
+        db = std::make_unique<Database>(std::move(engine));
+    }
+
+    void printHeader() const {
+        std::printf("engine:     %s\n", o.engine == EngineType::BTREE ? "btree" : "lsm");
+        std::printf("keys:       %zu bytes\n", o.keySize);
+        std::printf("values:     %zu bytes\n", o.valueSize);
+        std::printf("entries:    %zu\n", o.num);
+        std::printf("threads:    %d\n", o.threads);
+        std::printf("------------------------------------------------\n");
+    }
+
+    // this thread's slice [begin, end) of n
+    std::pair<size_t, size_t> slice(int thread, size_t n) const {
+        return {n * thread / o.threads, n * (thread + 1) / o.threads};
+    }
+
+    std::mt19937_64 rngFor(int thread) const { return std::mt19937_64(o.seed + static_cast<uint64_t>(thread) * 7919); }
+
+    void fill(int thread, ThreadResult& r, bool random) {
+        auto [begin, end] = slice(thread, o.num);
+        auto rng = rngFor(thread);
+        ValueSource values(o.seed + thread);
+        for (size_t i = begin; i < end; i += o.batchSize) {
+            size_t n = std::min(o.batchSize, end - i);
+            auto start = Clock::now();
+            if (n == 1) {
+                std::string key = makeKey(random ? rng() % o.num : i, o.keySize);
+                db->put(key, std::string(values.next(o.valueSize)));
+            } else {
+                WriteBatch batch;
+                for (size_t j = 0; j < n; ++j) {
+                    batch.put(makeKey(random ? rng() % o.num : i + j, o.keySize), std::string(values.next(o.valueSize)));
+                }
+                db->write(batch);
+            }
+            r.latency.add(elapsed(start));
+            r.ops += n;
+            r.bytes += n * (o.keySize + o.valueSize);
+        }
+    }
+
+    void readRandom(int thread, ThreadResult& r, bool missing) {
+        auto [begin, end] = slice(thread, o.reads);
+        auto rng = rngFor(thread);
+        for (size_t i = begin; i < end; ++i) {
+            std::string key = makeKey(rng() % o.num, o.keySize, missing);
+            auto start = Clock::now();
+            auto value = db->get(key);
+            r.latency.add(elapsed(start));
+            ++r.ops;
+            if (value) {
+                ++r.found;
+                r.bytes += key.size() + value->size();
+            }
+        }
+    }
+
+    void seekRandom(int thread, ThreadResult& r) {
+        auto [begin, end] = slice(thread, o.reads);
+        auto rng = rngFor(thread);
+        for (size_t i = begin; i < end; ++i) {
+            ScanOptions options;
+            options.start = makeKey(rng() % o.num, o.keySize);
+            auto start = Clock::now();
+            auto cursor = db->newCursor(options);
+            size_t n = 0;
+            for (; n < o.scanLength && cursor->valid(); ++n, cursor->next()) {
+                r.bytes += cursor->key().size() + cursor->value().size();
+            }
+            r.latency.add(elapsed(start));
+            ++r.ops;
+            if (n > 0) ++r.found;
+        }
+    }
+
+    void readSeq(ThreadResult& r) {
+        auto cursor = db->newCursor();
+        auto start = Clock::now();
+        for (; cursor->valid(); cursor->next()) {
+            r.bytes += cursor->key().size() + cursor->value().size();
+            ++r.ops;
+            ++r.found;
+            // one sample per entry would mostly measure the clock
+            if (r.ops % 1000 == 0) {
+                r.latency.add(elapsed(start) / 1000);
+                start = Clock::now();
+            }
+        }
+    }
+
+    void mixed(int thread, ThreadResult& r) {
+        auto [begin, end] = slice(thread, o.reads);
+        auto rng = rngFor(thread);
+        ValueSource values(o.seed + thread);
+        for (size_t i = begin; i < end; ++i) {
+            std::string key = makeKey(rng() % o.num, o.keySize);
+            bool read = static_cast<int>(rng() % 100) < o.readPercent;
+            auto start = Clock::now();
+            if (read) {
+                auto value = db->get(key);
+                if (value) {
+                    ++r.found;
+                    r.bytes += key.size() + value->size();
+                }
+            } else {
+                db->put(key, std::string(values.next(o.valueSize)));
+                r.bytes += key.size() + o.valueSize;
+            }
+            r.latency.add(elapsed(start));
+            ++r.ops;
+        }
+    }
+
+    static uint64_t elapsed(Clock::time_point start) {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+    }
+
+    struct Result {
+        double seconds = 0;
+        ThreadResult total;
+    };
+
+    Result runThreads(const std::function<void(int, ThreadResult&)>& body) {
+        std::vector<ThreadResult> results(static_cast<size_t>(o.threads));
+        std::vector<std::thread> workers;
+        std::atomic<int> ready{0};
+        std::atomic<bool> go{false};
+        for (int t = 0; t < o.threads; ++t) {
+            workers.emplace_back([&, t]() {
+                ready.fetch_add(1);
+                while (!go.load()) std::this_thread::yield();
+                body(t, results[static_cast<size_t>(t)]);
+            });
+        }
+        while (ready.load() < o.threads) std::this_thread::yield();
+        auto start = Clock::now();
+        go = true;
+        for (auto& w : workers) w.join();
+
+        Result result;
+        result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        for (const auto& r : results) {
+            result.total.latency.merge(r.latency);
+            result.total.ops += r.ops;
+            result.total.bytes += r.bytes;
+            result.total.found += r.found;
+        }
+        return result;
+    }
+
+    void report(const std::string& name, const Result& result) const {
+        const auto& t = result.total;
+        double secs = std::max(result.seconds, 1e-9);
+        std::printf("%-12s : %10.0f ops/s %8.1f MB/s  p50 %8.2f  p99 %8.2f  p999 %9.2f us",
+                    name.c_str(), static_cast<double>(t.ops) / secs,
+                    static_cast<double>(t.bytes) / secs / (1024.0 * 1024.0),
+                    t.latency.percentile(50) / 1000.0, t.latency.percentile(99) / 1000.0,
+                    t.latency.percentile(99.9) / 1000.0);
+        if (name.rfind("read", 0) == 0 || name == "seekrandom") {
+            std::printf("  (%llu of %llu found)", static_cast<unsigned long long>(t.found),
+                        static_cast<unsigned long long>(t.ops));
+        }
+        std::printf("\n");
+        std::fflush(stdout);
+    }
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options = parseOptions(argc, argv);
+    // flush and compaction notices would interleave with the report
+    Logger::process().setLevel(LogLevel::WARN);
+    Benchmark(std::move(options)).run();
+    return 0;
+}
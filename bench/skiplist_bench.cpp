@@ -0,0 +1,105 @@
+#include "common/containers/arena_skiplist.hpp"
+#include "common/containers/skiplist.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * memtable skiplist scaling: 1..N threads each insert then look up their
+ * share of TOTAL_OPS random keys.
+ *
+ *   skiplist_bench [max threads] [total ops]
+ *
+ * the concurrent ArenaSkipList is compared against the old SkipList behind
+ * a single mutex, which is what a multi-threaded front end would otherwise need.
+ */
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+std::vector<std::string> makeKeys(size_t n) {
+    std::mt19937_64 gen(7);
+    std::vector<std::string> keys;
+    keys.reserve(n);
+    char buf[24];
+    for (size_t i = 0; i < n; ++i) {
+        std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(gen()));
+        keys.emplace_back(buf);
+    }
+    return keys;
+}
+
+// runs fn(threadIndex, begin, end) on `threads` threads over [0, n); returns seconds
+template<typename Fn>
+double runThreads(int threads, size_t n, Fn&& fn) {
+    auto start = Clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        size_t begin = n * t / threads;
+        size_t end = n * (t + 1) / threads;
+        workers.emplace_back([&, t, begin, end]() { fn(t, begin, end); });
+    }
+    for (auto& w : workers) w.join();
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void report(const char* name, int threads, size_t ops, double secs) {
+    std::printf("%-20s threads=%-3d %12.0f ops/s\n", name, threads, ops / secs);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int maxThreads = argc > 1 ? std::atoi(argv[1]) : static_cast<int>(std::thread::hardware_concurrency());
+    size_t totalOps = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1'000'000;
+    if (maxThreads < 1) maxThreads = 1;
+
+    const std::string value(100, 'v');
+    auto keys = makeKeys(totalOps);
+
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        {
+            ArenaSkipList list;
+            double secs = runThreads(threads, keys.size(), [&](int, size_t b, size_t e) {
+                for (size_t i = b; i < e; ++i) list.insert(keys[i], value);
+            });
+            report("arena insert", threads, keys.size(), secs);
+
+            secs = runThreads(threads, keys.size(), [&](int, size_t b, size_t e) {
+                for (size_t i = b; i < e; ++i) {
+                    if (!list.get(keys[i])) std::abort();
+                }
+            });
+            report("arena get", threads, keys.size(), secs);
+        }
+        {
+            SkipList<std::string, std::string> list;
+            std::mutex mtx;
+            double secs = runThreads(threads, keys.size(), [&](int, size_t b, size_t e) {
+                for (size_t i = b; i < e; ++i) {
+                    std::lock_guard lock(mtx);
+                    list.insert(keys[i], value);
+                }
+            });
+            report("mutex insert", threads, keys.size(), secs);
+
+            secs = runThreads(threads, keys.size(), [&](int, size_t b, size_t e) {
+                for (size_t i = b; i < e; ++i) {
+                    std::lock_guard lock(mtx);
+                    if (!list.get(keys[i])) std::abort();
+                }
+            });
+            report("mutex get", threads, keys.size(), secs);
+        }
+        if (threads < maxThreads && threads * 2 > maxThreads) threads = maxThreads / 2; // always end on maxThreads
+    }
+    return 0;
+}
@@ -1,4 +1,5 @@
 #include "../db/database.hpp"
+#include "../common/utils/stats.hpp"
 #include <iostream>
 #include <string>
 
@@ -59,4 +60,39 @@ public:
 
 private:
     std::string key_;
-};
\ No newline at end of file
+};
+
+// "-" leaves a bound open. returns at most limit rows, in reverse when asked.
+class ScanCommand : public Command {
+public:
+    ScanCommand(std::string start, std::string end, int limit, bool reverse)
+        : start_(std::move(start)), end_(std::move(end)), limit_(limit), reverse_(reverse) {}
+
+    std::string execute(Database& db) override {
+        ScanOptions options;
+        if (start_ != "-") options.start = start_;
+        if (end_ != "-") options.end = end_;
+        options.reverse = reverse_;
+
+        std::string res;
+        int rows = 0;
+        for (auto cursor = db.newCursor(options); cursor->valid() && rows < limit_; cursor->next(), ++rows) {
+            res.append(cursor->key()).append(": ").append(cursor->value()).append("\n");
+        }
+        return res;
+    }
+
+private:
+    std::string start_;
+    std::string end_;
+    int limit_;
+    bool reverse_;
+};
+
+// every metric of the process, one "name value" line each
+class StatsCommand : public Command {
+public:
+    std::string execute(Database&) override {
+        return StatsRegistry::process().dump();
+    }
+};
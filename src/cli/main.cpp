@@ -3,6 +3,7 @@
 #include <unistd.h>
 #include <iostream>
 #include <string>
+#include <cstring>
 #include <sstream>
 
 #define SOCKET_PATH "/.kvdb/db.sock"
@@ -13,6 +14,9 @@ put <key> <value>       - Insert or update a key-value pair
 get <key>               - Retrieve the value for a given key
 del <key>               - Delete the specified key
 getall                  - Retrieves all key-value pairs
+scan <start> <end> <n>  - Up to n pairs with start <= key < end ("-" for no bound)
+rscan <start> <end> <n> - Like scan, from the end of the range backwards
+stats                   - Show the server's counters and latencies
 help                    - Show this help message
 exit                    - Quit the CLI
 )";
@@ -38,8 +42,10 @@ std::string sendCommandToServer(const std::string& command) {
         return "ERROR: Failed to connect to server.\n";
     }
 
-    // Send command
-    if (write(sock, command.c_str(), command.size()) < 0) {
+    // send the command; quit has the server close the connection after
+    // replying, which marks the end of the response
+    std::string request = command + "quit\n";
+    if (write(sock, request.c_str(), request.size()) < 0) {
         perror("write");
         close(sock);
         return "ERROR: Failed to send command.\n";
@@ -49,10 +55,8 @@ std::string sendCommandToServer(const std::string& command) {
     char buffer[1024];
     std::ostringstream response;
     ssize_t bytesRead;
-    while ((bytesRead = read(sock, buffer, sizeof(buffer) - 1)) > 0) {
-        buffer[bytesRead] = '\0';
-        response << buffer;
-        if (bytesRead < static_cast<ssize_t>(sizeof(buffer) - 1)) break;
+    while ((bytesRead = read(sock, buffer, sizeof(buffer))) > 0) {
+        response.write(buffer, bytesRead);
     }
 
     close(sock);
@@ -77,8 +81,15 @@ int main() {
             std::string key;
             std::cin >> key;
             oss << "del " << key << "\n";
+        } else if (cmd == "scan" || cmd == "rscan") {
+            std::string start, end;
+            int limit;
+            std::cin >> start >> end >> limit;
+            oss << cmd << " " << start << " " << end << " " << limit << "\n";
         } else if (cmd == "getall") {
             oss << "getall\n";
+        } else if (cmd == "stats") {
+            oss << "stats\n";
         } else if (cmd == "help") {
             printHelp();
             continue;
@@ -0,0 +1,268 @@
+#pragma once
+#include "../utils/arena.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <new>
+#include <optional>
+#include <random>
+#include <string_view>
+
+/**
+ * concurrent skiplist of byte-string keys and values whose nodes live in an Arena.
+ *
+ * 1. each node is one allocation: header, height-sized forward array, key bytes
+ * 2. values are copied into the arena too, each tagged with a sequence number.
+ *    a key's versions hang off its node in a chain sorted newest first, and
+ *    writing an existing key links one more version in rather than replacing
+ * 3. there is no per-key remove, deletes are written as tombstone values
+ * 4. clear() drops every node at once by resetting the arena
+ *
+ * concurrency: get() and Iterator never lock. insert() may run on many
+ * threads at once, linking a node bottom-up with one CAS per level and a
+ * version with one CAS in its chain. neither is ever unlinked, so a reader
+ * always sees sorted lists. clear() needs exclusive access.
+ *
+ * views returned by get() and Iterator point into the arena and stay valid
+ * until clear().
+ */
+class ArenaSkipList {
+public:
+    // one value of a key in the arena, laid out as [Version][value bytes]
+    struct Version {
+        uint64_t sequence;
+        std::atomic<Version*> next; // the next older version
+        uint32_t size;
+
+        std::string_view value() const { return {reinterpret_cast<const char*>(this + 1), size}; }
+        const Version* older() const { return next.load(std::memory_order_acquire); }
+    };
+
+private:
+    static constexpr int MAX_HEIGHT = 12;
+    static constexpr unsigned BRANCHING = 4; // 1 in 4 nodes is promoted a level
+
+    // laid out as [Node][atomic<Node*> next[height]][key bytes]
+    struct Node {
+        std::atomic<Version*> versions; // newest first
+        uint32_t keySize;
+        uint32_t height;
+
+        std::atomic<Node*>* next() { return reinterpret_cast<std::atomic<Node*>*>(this + 1); }
+        const std::atomic<Node*>* next() const { return reinterpret_cast<const std::atomic<Node*>*>(this + 1); }
+        Node* loadNext(int i) const { return next()[i].load(std::memory_order_acquire); }
+
+        std::string_view key() const {
+            return {reinterpret_cast<const char*>(next() + height), keySize};
+        }
+        const Version* newest() const { return versions.load(std::memory_order_acquire); }
+        // newest version with sequence <= snapshot, or nullptr
+        const Version* visible(uint64_t snapshot) const {
+            const Version* v = newest();
+            while (v && v->sequence > snapshot) v = v->older();
+            return v;
+        }
+    };
+
+    Arena arena;
+    Node* head = nullptr;
+    std::atomic<int> height{1}; // current highest level in list
+    std::atomic<size_t> count{0};
+    std::atomic<size_t> dataBytes{0}; // bytes requested for entries, head excluded
+
+    static int randomHeight() {
+        thread_local std::minstd_rand gen{std::random_device{}()};
+        int h = 1;
+        while (h < MAX_HEIGHT && gen() % BRANCHING == 0) ++h;
+        return h;
+    }
+
+    Version* newVersion(std::string_view value, uint64_t sequence) {
+        size_t bytes = sizeof(Version) + value.size();
+        char* mem = arena.allocateAligned(bytes);
+        dataBytes.fetch_add(bytes, std::memory_order_relaxed);
+        Version* v = reinterpret_cast<Version*>(mem);
+        v->sequence = sequence;
+        new (&v->next) std::atomic<Version*>(nullptr);
+        v->size = static_cast<uint32_t>(value.size());
+        std::memcpy(mem + sizeof(Version), value.data(), value.size());
+        return v;
+    }
+
+    Node* newNode(std::string_view key, Version* version, int h) {
+        size_t bytes = sizeof(Node) + h * sizeof(std::atomic<Node*>) + key.size();
+        char* mem = arena.allocateAligned(bytes);
+        dataBytes.fetch_add(bytes, std::memory_order_relaxed);
+        Node* node = reinterpret_cast<Node*>(mem);
+        new (&node->versions) std::atomic<Version*>(version);
+        node->keySize = static_cast<uint32_t>(key.size());
+        node->height = static_cast<uint32_t>(h);
+        for (int i = 0; i < h; ++i) new (&node->next()[i]) std::atomic<Node*>(nullptr);
+        std::memcpy(const_cast<char*>(node->key().data()), key.data(), key.size());
+        return node;
+    }
+
+    // links v into node's chain behind every newer version. between equal
+    // sequences the one linked last goes first, so it wins
+    static void linkVersion(Node* node, Version* v) {
+        std::atomic<Version*>* link = &node->versions;
+        while (true) {
+            Version* curr = link->load(std::memory_order_acquire);
+            if (curr && curr->sequence > v->sequence) {
+                link = &curr->next;
+                continue;
+            }
+            v->next.store(curr, std::memory_order_relaxed);
+            // lost a race with another version here: look again from the same link
+            if (link->compare_exchange_weak(curr, v, std::memory_order_release)) return;
+        }
+    }
+
+    // starting at `from` on level i, returns the last node with key < target
+    // and stores its successor in succ
+    static Node* findSpliceForLevel(std::string_view target, Node* from, int i, Node** succ) {
+        Node* curr = from;
+        while (true) {
+            Node* next = curr->loadNext(i);
+            if (!next || !(next->key() < target)) {
+                *succ = next;
+                return curr;
+            }
+            curr = next;
+        }
+    }
+
+    // first node with key >= target, or nullptr
+    Node* findGreaterOrEqual(std::string_view target) const {
+        Node* curr = head;
+        Node* succ = nullptr;
+        for (int i = height.load(std::memory_order_relaxed) - 1; i >= 0; --i) {
+            curr = findSpliceForLevel(target, curr, i, &succ);
+        }
+        return succ;
+    }
+
+    // last node with key < target, or head
+    Node* findLessThan(std::string_view target) const {
+        Node* curr = head;
+        Node* succ = nullptr;
+        for (int i = height.load(std::memory_order_relaxed) - 1; i >= 0; --i) {
+            curr = findSpliceForLevel(target, curr, i, &succ);
+        }
+        return curr;
+    }
+
+    // last node in the list, or head when empty
+    Node* findLast() const {
+        Node* curr = head;
+        for (int i = height.load(std::memory_order_relaxed) - 1; i >= 0; --i) {
+            while (Node* next = curr->loadNext(i)) curr = next;
+        }
+        return curr;
+    }
+
+public:
+    // walks the base level in key order. entries inserted while iterating may
+    // or may not be seen. there are no back links, so each prev() is a
+    // fresh O(log n) search.
+    class Iterator {
+    public:
+        explicit Iterator(const ArenaSkipList& list) : list(&list) {}
+
+        bool valid() const { return node != nullptr; }
+        std::string_view key() const { return node->key(); }
+        // the newest version's value
+        std::string_view value() const { return node->newest()->value(); }
+        // newest version with sequence <= snapshot, or nullptr if every
+        // version is newer. older ones follow through Version::older()
+        const Version* version(uint64_t snapshot = UINT64_MAX) const { return node->visible(snapshot); }
+
+        void next() { node = node->loadNext(0); }
+        void seekToFirst() { node = list->head->loadNext(0); }
+        void seek(std::string_view target) { node = list->findGreaterOrEqual(target); }
+
+        void prev() { node = orNull(list->findLessThan(node->key())); }
+        void seekToLast() { node = orNull(list->findLast()); }
+        // last entry with key <= target
+        void seekForPrev(std::string_view target) {
+            seek(target);
+            if (!valid()) seekToLast();
+            else if (key() != target) prev();
+        }
+
+    private:
+        const Node* orNull(const Node* n) const { return n == list->head ? nullptr : n; }
+
+        const ArenaSkipList* list;
+        const Node* node = nullptr;
+    };
+
+    explicit ArenaSkipList(std::shared_ptr<MemoryBudget> budget = nullptr) : arena(std::move(budget)) { clear(); }
+    ArenaSkipList(const ArenaSkipList&) = delete;
+    ArenaSkipList& operator=(const ArenaSkipList&) = delete;
+
+    // inserts key, or adds a version to it if it exists. safe to call concurrently.
+    void insert(std::string_view key, std::string_view value, uint64_t sequence = 0) {
+        Node* prev[MAX_HEIGHT];
+        Node* succ[MAX_HEIGHT];
+
+        int h = randomHeight();
+        int listHeight = height.load(std::memory_order_relaxed);
+        while (h > listHeight && !height.compare_exchange_weak(listHeight, h, std::memory_order_relaxed)) {}
+        int top = std::max(h, listHeight);
+
+        // each level's splice starts from the one found a level above
+        Node* curr = head;
+        for (int i = top - 1; i >= 0; --i) {
+            curr = findSpliceForLevel(key, curr, i, &succ[i]);
+            prev[i] = curr;
+        }
+
+        Version* version = newVersion(value, sequence);
+        Node* node = nullptr;
+        for (int i = 0; i < h; ++i) {
+            while (true) {
+                if (i == 0 && succ[0] && succ[0]->key() == key) {
+                    // the key already exists (possibly just linked by another
+                    // thread): add the version to it instead. a node we already
+                    // built is simply left unused in the arena.
+                    linkVersion(succ[0], version);
+                    return;
+                }
+                if (!node) node = newNode(key, version, h);
+
+                node->next()[i].store(succ[i], std::memory_order_relaxed);
+                // release publishes the node's contents along with the link
+                if (prev[i]->next()[i].compare_exchange_strong(succ[i], node, std::memory_order_release)) break;
+
+                // lost a race with another insert here: nodes are never removed,
+                // so re-search forward from the same predecessor
+                prev[i] = findSpliceForLevel(key, prev[i], i, &succ[i]);
+            }
+        }
+        count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // value of the newest version with sequence <= snapshot
+    std::optional<std::string_view> get(std::string_view key, uint64_t snapshot = UINT64_MAX) const {
+        Node* node = findGreaterOrEqual(key);
+        if (!node || node->key() != key) return std::nullopt;
+        if (const Version* v = node->visible(snapshot)) return v->value();
+        return std::nullopt;
+    }
+
+    size_t size() const { return count.load(std::memory_order_relaxed); }
+
+    // bytes held by the arena, nodes, keys and every value version included
+    size_t memoryUsage() const { return arena.memoryUsage(); }
+    // bytes of nodes, keys and values written so far, without the arena's block slack
+    size_t dataSize() const { return dataBytes.load(std::memory_order_relaxed); }
+
+    void clear() {
+        arena.reset();
+        head = newNode({}, nullptr, MAX_HEIGHT);
+        height.store(1, std::memory_order_relaxed);
+        count.store(0, std::memory_order_relaxed);
+        dataBytes.store(0, std::memory_order_relaxed);
+    }
+};
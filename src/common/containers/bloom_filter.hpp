@@ -0,0 +1,97 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * 1. a bit array of m bits and k hash functions
+ * 2. add sets the k bits chosen by the key's hashes
+ * 3. mayContain checks those k bits: any unset bit means "definitely absent",
+ *    all set means "probably present"
+ * 4. with b bits per key and k = b * ln2, the false positive rate is ~0.6185^b
+ *    (about 1% at 10 bits per key)
+ *
+ * the k probes are derived from one 64-bit hash by double hashing, so the key
+ * is only hashed once per add/lookup.
+ */
+class BloomFilter {
+public:
+    BloomFilter(size_t expectedKeys, int bitsPerKey) {
+        // k = bitsPerKey * ln(2), clamped to a sane range
+        numProbes = static_cast<uint8_t>(std::clamp(static_cast<int>(bitsPerKey * 0.69), 1, 30));
+        size_t numBits = std::max<size_t>(64, expectedKeys * std::max(bitsPerKey, 1));
+        bits.assign((numBits + 7) / 8, 0);
+    }
+
+    static uint64_t hash(std::string_view key) {
+        // FNV-1a followed by the murmur3 finalizer to spread the low bits
+        uint64_t h = 0xcbf29ce484222325ULL;
+        for (unsigned char c : key) {
+            h ^= c;
+            h *= 0x100000001b3ULL;
+        }
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    void add(std::string_view key) { addHash(hash(key)); }
+
+    void addHash(uint64_t h) {
+        const uint64_t numBits = bits.size() * 8;
+        uint64_t delta = (h >> 17) | (h << 47);
+        for (uint8_t i = 0; i < numProbes; ++i) {
+            uint64_t pos = h % numBits;
+            bits[pos / 8] |= static_cast<uint8_t>(1u << (pos % 8));
+            h += delta;
+        }
+    }
+
+    bool mayContain(std::string_view key) const {
+        uint64_t h = hash(key);
+        const uint64_t numBits = bits.size() * 8;
+        uint64_t delta = (h >> 17) | (h << 47);
+        for (uint8_t i = 0; i < numProbes; ++i) {
+            uint64_t pos = h % numBits;
+            if ((bits[pos / 8] & (1u << (pos % 8))) == 0) return false;
+            h += delta;
+        }
+        return true;
+    }
+
+    size_t byteSize() const { return bits.size(); }
+
+    /**
+     * [bit array bytes]
+     * [1B  number of probes]
+     */
+    std::string serialize() const {
+        std::string out(bits.begin(), bits.end());
+        out.push_back(static_cast<char>(numProbes));
+        return out;
+    }
+
+    static std::optional<BloomFilter> deserialize(std::string_view data) {
+        if (data.size() < 2) return std::nullopt;
+        uint8_t probes = static_cast<uint8_t>(data.back());
+        if (probes == 0 || probes > 30) return std::nullopt;
+
+        BloomFilter filter;
+        filter.numProbes = probes;
+        filter.bits.assign(data.begin(), data.end() - 1);
+        return filter;
+    }
+
+private:
+    BloomFilter() = default;
+
+    std::vector<uint8_t> bits;
+    uint8_t numProbes = 1;
+};
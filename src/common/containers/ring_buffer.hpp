@@ -0,0 +1,78 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <optional>
+
+/**
+ * bounded queue for many producers and one consumer, without locks.
+ *
+ * 1. capacity is rounded up to a power of two; every cell carries a sequence
+ *    number saying whose turn it is: seq == pos means free for the producer
+ *    claiming pos, seq == pos + 1 means filled for the consumer reading pos
+ * 2. a producer claims a position with one compare-exchange on the tail,
+ *    moves its value into the cell and publishes it by bumping the sequence
+ * 3. the consumer reads the cell at the head once it's published and hands
+ *    it back to the producer one lap later
+ * 4. tryPush never waits: when the queue is full it returns false and the
+ *    value is left with the caller
+ *
+ * only one thread may call tryPop at a time.
+ */
+template<typename T>
+class RingBuffer {
+public:
+    explicit RingBuffer(size_t capacity)
+        : mask(std::bit_ceil(std::max<size_t>(capacity, 2)) - 1),
+          cells(std::make_unique<Cell[]>(mask + 1)) {
+        for (size_t i = 0; i <= mask; ++i) cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator=(const RingBuffer&) = delete;
+
+    size_t capacity() const { return mask + 1; }
+
+    bool tryPush(T& value) {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = cells[pos & mask];
+            size_t seq = cell.seq.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq - pos);
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value = std::move(value);
+                    cell.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false; // the consumer hasn't freed this cell yet: full
+            } else {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    std::optional<T> tryPop() {
+        Cell& cell = cells[head & mask];
+        if (cell.seq.load(std::memory_order_acquire) != head + 1) return std::nullopt;
+        std::optional<T> value(std::move(cell.value));
+        cell.value = T();
+        cell.seq.store(head + mask + 1, std::memory_order_release);
+        ++head;
+        return value;
+    }
+
+private:
+    struct alignas(64) Cell {
+        std::atomic<size_t> seq{0};
+        T value{};
+    };
+
+    const size_t mask;
+    std::unique_ptr<Cell[]> cells;
+    alignas(64) std::atomic<size_t> tail{0}; // next position to claim
+    alignas(64) size_t head = 0;             // next position to read; consumer only
+};
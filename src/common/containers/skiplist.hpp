@@ -41,6 +41,17 @@ private:
         return lvl;
     }
 
+    // first node with key >= target, or nullptr
+    std::shared_ptr<Node> findGreaterOrEqual(const K& target) const {
+        auto curr = head;
+        for (int i = level - 1; i >= 0; --i) {
+            while (curr->forward[i] && curr->forward[i]->key < target) {
+                curr = curr->forward[i];
+            }
+        }
+        return curr->forward[0];
+    }
+
 public:
     SkipList() {
         head = std::make_shared<Node>(K{}, V{}, MAX_LEVEL);
@@ -102,16 +113,7 @@ public:
     }
 
     std::optional<V> get(const K& key) const {
-        auto curr = head;
-
-        // traverse from top level to level 0
-        for (int i = level - 1; i >= 0; --i) {
-            while (curr->forward[i] && curr->forward[i]->key < key) {
-                curr = curr->forward[i];
-            }
-        }
-
-        curr = curr->forward[0];
+        auto curr = findGreaterOrEqual(key);
         if (curr && curr->key == key) {
             return curr->value;
         }
@@ -0,0 +1,104 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "memory_budget.hpp"
+
+/**
+ * bump allocator for objects that all die together (e.g. a memtable).
+ *
+ * 1. memory is carved out of BLOCK_SIZE blocks; large requests get their own block
+ * 2. nothing is freed individually, reset() drops every block at once
+ * 3. memoryUsage() is the exact number of bytes reserved from the heap
+ * 4. allocate may be called from many threads; each call holds a spinlock for
+ *    a pointer bump. reset() must not race with anything.
+ * 5. every block is charged to the optional MemoryBudget until reset or destruction
+ */
+class Arena {
+public:
+    static constexpr size_t BLOCK_SIZE = 4096;
+
+    explicit Arena(std::shared_ptr<MemoryBudget> budget = nullptr) : budget(std::move(budget)) {}
+    ~Arena() { reset(); }
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    char* allocate(size_t bytes) {
+        SpinGuard guard(lock);
+        if (bytes <= remaining) {
+            char* result = ptr;
+            ptr += bytes;
+            remaining -= bytes;
+            return result;
+        }
+        return allocateFallback(bytes);
+    }
+
+    // aligned for any pointer-sized field
+    char* allocateAligned(size_t bytes) {
+        constexpr size_t align = alignof(std::max_align_t);
+        SpinGuard guard(lock);
+        size_t mod = reinterpret_cast<uintptr_t>(ptr) & (align - 1);
+        size_t slop = mod == 0 ? 0 : align - mod;
+        if (bytes + slop <= remaining) {
+            char* result = ptr + slop;
+            ptr += bytes + slop;
+            remaining -= bytes + slop;
+            return result;
+        }
+        // new blocks come from operator new[], which is max_align_t aligned
+        return allocateFallback(bytes);
+    }
+
+    size_t memoryUsage() const { return usage.load(std::memory_order_relaxed); }
+
+    void reset() {
+        if (budget) budget->release(usage.load(std::memory_order_relaxed));
+        blocks.clear();
+        ptr = nullptr;
+        remaining = 0;
+        usage.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    struct SpinGuard {
+        std::atomic_flag& flag;
+        explicit SpinGuard(std::atomic_flag& flag) : flag(flag) {
+            while (flag.test_and_set(std::memory_order_acquire)) {
+                while (flag.test(std::memory_order_relaxed)) {}
+            }
+        }
+        ~SpinGuard() { flag.clear(std::memory_order_release); }
+    };
+
+    std::vector<std::unique_ptr<char[]>> blocks;
+    char* ptr = nullptr;
+    size_t remaining = 0;
+    std::atomic<size_t> usage{0};
+    std::atomic_flag lock = ATOMIC_FLAG_INIT;
+    std::shared_ptr<MemoryBudget> budget;
+
+    char* allocateFallback(size_t bytes) {
+        if (bytes > BLOCK_SIZE / 4) {
+            // keep the rest of the current block for small allocations
+            return newBlock(bytes);
+        }
+        ptr = newBlock(BLOCK_SIZE);
+        remaining = BLOCK_SIZE;
+
+        char* result = ptr;
+        ptr += bytes;
+        remaining -= bytes;
+        return result;
+    }
+
+    char* newBlock(size_t bytes) {
+        blocks.emplace_back(new char[bytes]); // uninitialised, unlike make_unique
+        size_t charge = bytes + sizeof(std::unique_ptr<char[]>);
+        usage.fetch_add(charge, std::memory_order_relaxed);
+        if (budget) budget->reserve(charge);
+        return blocks.back().get();
+    }
+};
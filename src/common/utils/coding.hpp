@@ -0,0 +1,71 @@
+#pragma once
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <string_view>
+
+/**
+ * fixed-width little-endian encoding shared by the segment files, the
+ * manifest and the binary protocol.
+ *
+ * 1. integers are copied in host order; every supported target is
+ *    little-endian, which the static_assert below holds us to
+ * 2. byte strings are length-prefixed: [4B size][bytes]
+ * 3. Reader bounds checks every read, so a truncated or corrupt buffer
+ *    decodes to nullopt instead of reading past the end
+ */
+static_assert(std::endian::native == std::endian::little, "encoding assumes a little-endian host");
+
+namespace coding {
+
+inline void putU32(std::string& dst, uint32_t v) {
+    dst.append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+inline void putU64(std::string& dst, uint64_t v) {
+    dst.append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+inline void putBytes(std::string& dst, std::string_view bytes) {
+    putU32(dst, static_cast<uint32_t>(bytes.size()));
+    dst.append(bytes.data(), bytes.size());
+}
+
+// cursor over an in-memory buffer
+class Reader {
+public:
+    Reader(const char* data, size_t size) : p(data), end(data + size) {}
+    explicit Reader(std::string_view buf) : Reader(buf.data(), buf.size()) {}
+
+    bool done() const { return p >= end; }
+    size_t remaining() const { return static_cast<size_t>(end - p); }
+
+    std::optional<uint8_t> u8() { return fixed<uint8_t>(); }
+    std::optional<uint32_t> u32() { return fixed<uint32_t>(); }
+    std::optional<uint64_t> u64() { return fixed<uint64_t>(); }
+
+    std::optional<std::string_view> bytes() {
+        auto len = u32();
+        if (!len || remaining() < *len) return std::nullopt;
+        std::string_view out(p, *len);
+        p += *len;
+        return out;
+    }
+
+private:
+    const char* p;
+    const char* end;
+
+    template<typename T>
+    std::optional<T> fixed() {
+        if (remaining() < sizeof(T)) return std::nullopt;
+        T v;
+        std::memcpy(&v, p, sizeof(T));
+        p += sizeof(T);
+        return v;
+    }
+};
+
+} // namespace coding
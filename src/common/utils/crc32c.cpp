@@ -0,0 +1,107 @@
+#include "crc32c.hpp"
+#include <array>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <nmmintrin.h>
+#define KVDB_CRC32C_X86 1
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define KVDB_CRC32C_ARM 1
+#endif
+
+namespace crc32c {
+namespace {
+
+constexpr uint32_t POLY = 0x82F63B78; // reflected Castagnoli polynomial
+
+using Tables = std::array<std::array<uint32_t, 256>, 8>;
+
+// tables[k][b] is the crc of byte b followed by k zero bytes
+constexpr Tables makeTables() {
+    Tables t{};
+    for (uint32_t b = 0; b < 256; ++b) {
+        uint32_t crc = b;
+        for (int i = 0; i < 8; ++i) crc = (crc >> 1) ^ (POLY & (0u - (crc & 1)));
+        t[0][b] = crc;
+    }
+    for (uint32_t b = 0; b < 256; ++b) {
+        for (int k = 1; k < 8; ++k) t[k][b] = (t[k - 1][b] >> 8) ^ t[0][t[k - 1][b] & 0xFF];
+    }
+    return t;
+}
+
+constexpr Tables TABLES = makeTables();
+
+uint32_t extendSoftware(uint32_t crc, const uint8_t* p, size_t size) {
+    while (size >= 8) {
+        uint64_t word;
+        std::memcpy(&word, p, 8); // little-endian, like every target we build for
+        word ^= crc;
+        crc = TABLES[7][word & 0xFF] ^ TABLES[6][(word >> 8) & 0xFF] ^
+              TABLES[5][(word >> 16) & 0xFF] ^ TABLES[4][(word >> 24) & 0xFF] ^
+              TABLES[3][(word >> 32) & 0xFF] ^ TABLES[2][(word >> 40) & 0xFF] ^
+              TABLES[1][(word >> 48) & 0xFF] ^ TABLES[0][word >> 56];
+        p += 8;
+        size -= 8;
+    }
+    while (size-- > 0) crc = (crc >> 8) ^ TABLES[0][(crc ^ *p++) & 0xFF];
+    return crc;
+}
+
+#if defined(KVDB_CRC32C_X86)
+
+__attribute__((target("sse4.2")))
+uint32_t extendHardware(uint32_t crc, const uint8_t* p, size_t size) {
+    uint64_t crc64 = crc;
+    while (size >= 8) {
+        uint64_t word;
+        std::memcpy(&word, p, 8);
+        crc64 = _mm_crc32_u64(crc64, word);
+        p += 8;
+        size -= 8;
+    }
+    crc = static_cast<uint32_t>(crc64);
+    while (size-- > 0) crc = _mm_crc32_u8(crc, *p++);
+    return crc;
+}
+
+bool detectHardware() { return __builtin_cpu_supports("sse4.2"); }
+
+#elif defined(KVDB_CRC32C_ARM)
+
+uint32_t extendHardware(uint32_t crc, const uint8_t* p, size_t size) {
+    while (size >= 8) {
+        uint64_t word;
+        std::memcpy(&word, p, 8);
+        crc = __crc32cd(crc, word);
+        p += 8;
+        size -= 8;
+    }
+    while (size-- > 0) crc = __crc32cb(crc, *p++);
+    return crc;
+}
+
+bool detectHardware() { return true; }
+
+#else
+
+uint32_t extendHardware(uint32_t crc, const uint8_t* p, size_t size) { return extendSoftware(crc, p, size); }
+bool detectHardware() { return false; }
+
+#endif
+
+const bool HAS_HARDWARE = detectHardware();
+
+} // namespace
+
+uint32_t extend(uint32_t crc, const void* data, size_t size) {
+    const auto* p = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+    crc = HAS_HARDWARE ? extendHardware(crc, p, size) : extendSoftware(crc, p, size);
+    return ~crc;
+}
+
+bool hardwareAccelerated() { return HAS_HARDWARE; }
+
+} // namespace crc32c
@@ -0,0 +1,21 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * CRC-32C (Castagnoli), the checksum used by the WAL.
+ *
+ * uses the SSE4.2 / ARMv8 crc32 instructions when the CPU has them and a
+ * slicing-by-8 table otherwise. both give the same result.
+ */
+namespace crc32c {
+
+// continues crc over more data: extend(extend(0, a), b) == value(a + b)
+uint32_t extend(uint32_t crc, const void* data, size_t size);
+
+inline uint32_t value(const void* data, size_t size) { return extend(0, data, size); }
+
+// whether extend() runs on the hardware instruction
+bool hardwareAccelerated();
+
+} // namespace crc32c
@@ -1,8 +1,9 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <iostream>
 #include "../../config.hpp"
 
-inline bool isTombstone(const std::string& value) {
+inline bool isTombstone(std::string_view value) {
     return value.rfind(TOMBSTONE_MARKER, 0) == 0;
 }
\ No newline at end of file
@@ -0,0 +1,70 @@
+#include "histogram.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdio>
+
+void Histogram::add(uint64_t value) {
+    ++buckets[bucketFor(value)];
+    ++total;
+    sum += value;
+    minValue = std::min(minValue, value);
+    maxValue = std::max(maxValue, value);
+}
+
+void Histogram::merge(const Histogram& other) {
+    for (size_t i = 0; i < BUCKETS; ++i) buckets[i] += other.buckets[i];
+    total += other.total;
+    sum += other.sum;
+    minValue = std::min(minValue, other.minValue);
+    maxValue = std::max(maxValue, other.maxValue);
+}
+
+void Histogram::clear() { *this = Histogram(); }
+
+double Histogram::percentile(double p) const {
+    if (total == 0) return 0.0;
+    double target = std::clamp(p, 0.0, 100.0) / 100.0 * static_cast<double>(total);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        if (buckets[i] == 0) continue;
+        if (static_cast<double>(seen + buckets[i]) >= target) {
+            // spread the bucket's values evenly over its range
+            double fraction = (target - static_cast<double>(seen)) / static_cast<double>(buckets[i]);
+            double low = static_cast<double>(std::max(bucketLow(i), min()));
+            double high = static_cast<double>(std::min(bucketHigh(i), maxValue));
+            return low + (high - low) * fraction;
+        }
+        seen += buckets[i];
+    }
+    return static_cast<double>(maxValue);
+}
+
+std::string Histogram::summary(double scale) const {
+    char buf[160];
+    std::snprintf(buf, sizeof(buf), "count=%llu mean=%.2f p50=%.2f p99=%.2f p999=%.2f max=%.2f",
+                  static_cast<unsigned long long>(total), mean() / scale, percentile(50) / scale,
+                  percentile(99) / scale, percentile(99.9) / scale, static_cast<double>(max()) / scale);
+    return buf;
+}
+
+size_t Histogram::bucketFor(uint64_t value) {
+    if (value < SUB_BUCKETS) return static_cast<size_t>(value);
+    int exponent = std::bit_width(value) - 1; // >= SUB_BITS
+    int shift = exponent - SUB_BITS;
+    size_t sub = static_cast<size_t>(value >> shift) - SUB_BUCKETS;
+    return SUB_BUCKETS + static_cast<size_t>(shift) * SUB_BUCKETS + sub;
+}
+
+uint64_t Histogram::bucketLow(size_t bucket) {
+    if (bucket < SUB_BUCKETS) return bucket;
+    size_t shift = (bucket - SUB_BUCKETS) / SUB_BUCKETS;
+    uint64_t sub = (bucket - SUB_BUCKETS) % SUB_BUCKETS;
+    return (SUB_BUCKETS + sub) << shift;
+}
+
+uint64_t Histogram::bucketHigh(size_t bucket) {
+    if (bucket + 1 == BUCKETS) return UINT64_MAX;
+    return bucketLow(bucket + 1) - 1;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * log-linear histogram of non-negative integers, typically latencies in
+ * nanoseconds.
+ *
+ * 1. values below 16 get a bucket each; above that every power of two is
+ *    split into 16 buckets, so a percentile is off by at most ~6%
+ * 2. add() is a few instructions and never allocates
+ * 3. not thread-safe: keep one per thread and merge() them for reporting
+ */
+class Histogram {
+public:
+    void add(uint64_t value);
+    void merge(const Histogram& other);
+    void clear();
+
+    uint64_t count() const { return total; }
+    uint64_t min() const { return total ? minValue : 0; }
+    uint64_t max() const { return maxValue; }
+    double mean() const { return total ? static_cast<double>(sum) / static_cast<double>(total) : 0.0; }
+    // value below which p percent of the values fall, 0 when empty
+    double percentile(double p) const;
+
+    // "count=.. mean=.. p50=.. p99=.. p999=.. max=.." with values divided by scale
+    std::string summary(double scale = 1.0) const;
+
+private:
+    static constexpr int SUB_BITS = 4;
+    static constexpr size_t SUB_BUCKETS = size_t{1} << SUB_BITS;
+    static constexpr size_t BUCKETS = SUB_BUCKETS + (64 - SUB_BITS) * SUB_BUCKETS;
+
+    std::array<uint64_t, BUCKETS> buckets{};
+    uint64_t total = 0;
+    uint64_t sum = 0;
+    uint64_t minValue = UINT64_MAX;
+    uint64_t maxValue = 0;
+
+    static size_t bucketFor(uint64_t value);
+    static uint64_t bucketLow(size_t bucket);
+    static uint64_t bucketHigh(size_t bucket);
+};
@@ -0,0 +1,123 @@
+#include "logger.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+
+namespace {
+
+const char* levelName(LogLevel level) {
+    switch (level) {
+    case LogLevel::DEBUG: return "DEBUG";
+    case LogLevel::INFO: return "INFO ";
+    case LogLevel::WARN: return "WARN ";
+    case LogLevel::ERROR: return "ERROR";
+    default: return "";
+    }
+}
+
+} // namespace
+
+Logger::Logger(int fd, size_t capacity, std::chrono::milliseconds interval)
+    : fd(fd), interval(interval), ring(capacity) {
+    thread = std::thread([this]() {
+        std::unique_lock lock(mtx);
+        while (!stopping) {
+            cv.wait_for(lock, this->interval, [this]() { return stopping || urgent.load(); });
+            urgent.store(false);
+            lock.unlock();
+            flush();
+            lock.lock();
+        }
+    });
+}
+
+Logger::~Logger() {
+    shutdown();
+}
+
+Logger& Logger::process() {
+    // never destroyed: objects torn down after exit() starts may still log.
+    // the handler drains the ring and leaves later lines to their callers
+    static Logger* logger = []() {
+        auto* l = new Logger();
+        std::atexit([]() { Logger::process().shutdown(); });
+        return l;
+    }();
+    return *logger;
+}
+
+void Logger::log(LogLevel level, std::string message) {
+    Entry entry{level, std::chrono::system_clock::now(), std::move(message)};
+    if (synchronous.load()) {
+        std::lock_guard lock(writeMtx);
+        std::string out;
+        append(out, entry);
+        write(out);
+        return;
+    }
+
+    if (!ring.tryPush(entry)) {
+        droppedLines.fetch_add(1);
+        urgent.store(true);
+        cv.notify_one();
+        return;
+    }
+    if (level >= LogLevel::WARN) {
+        urgent.store(true);
+        cv.notify_one();
+    }
+    // shutdown may have drained the ring just before the push
+    if (synchronous.load()) flush();
+}
+
+void Logger::flush() {
+    std::lock_guard lock(writeMtx);
+    std::string out;
+    while (auto entry = ring.tryPop()) append(out, *entry);
+
+    uint64_t drops = droppedLines.load();
+    if (drops != reportedDrops) {
+        Entry note{LogLevel::WARN, std::chrono::system_clock::now(),
+                   "[Log] Dropped " + std::to_string(drops - reportedDrops) + " lines, the ring was full"};
+        append(out, note);
+        reportedDrops = drops;
+    }
+    write(out);
+}
+
+void Logger::shutdown() {
+    {
+        std::lock_guard lock(mtx);
+        if (stopping) return;
+        stopping = true;
+    }
+    cv.notify_one();
+    thread.join();
+    synchronous.store(true);
+    flush();
+}
+
+void Logger::append(std::string& out, const Entry& entry) {
+    auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(entry.time.time_since_epoch()).count();
+    std::time_t seconds = static_cast<std::time_t>(millis / 1000);
+    std::tm tm{};
+    localtime_r(&seconds, &tm);
+    char stamp[48];
+    std::snprintf(stamp, sizeof(stamp), "%04d-%02d-%02d %02d:%02d:%02d.%03d %s ", tm.tm_year + 1900, tm.tm_mon + 1,
+                  tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec, static_cast<int>(millis % 1000),
+                  levelName(entry.level));
+    out.append(stamp).append(entry.message);
+    if (out.empty() || out.back() != '\n') out.push_back('\n');
+}
+
+void Logger::write(const std::string& out) {
+    size_t written = 0;
+    while (written < out.size()) {
+        ssize_t n = ::write(fd, out.data() + written, out.size() - written);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return; // nowhere left to report it
+        written += static_cast<size_t>(n);
+    }
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include "../containers/ring_buffer.hpp"
+#include "../../config.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+enum class LogLevel { DEBUG = 0, INFO = 1, WARN = 2, ERROR = 3, OFF = 4 };
+
+// levels below this are compiled out: their arguments aren't even
+// evaluated. set by the KVDB_LOG_LEVEL cmake option, which defaults to 0
+// in Debug builds and 1 otherwise
+#ifndef KVDB_LOG_LEVEL
+#define KVDB_LOG_LEVEL 1
+#endif
+
+/**
+ * leveled logger that keeps file writes off the calling thread.
+ *
+ * 1. a call formats its line and pushes it onto a lock-free ring; the
+ *    writer thread drains the ring every LOG_FLUSH_INTERVAL_MS, or at once
+ *    for warnings and errors, and writes the batch with one write()
+ * 2. when the ring is full the line is dropped rather than blocking the
+ *    caller; the writer reports how many were lost
+ * 3. after shutdown (or at exit for the process logger) lines are written
+ *    synchronously, so destructors running late still get logged
+ *
+ * use the LOG_* macros rather than log(): they skip formatting when the
+ * level is off and remove it entirely below KVDB_LOG_LEVEL.
+ */
+class Logger {
+public:
+    explicit Logger(int fd = STDOUT_FILENO, size_t capacity = LOG_RING_CAPACITY,
+                    std::chrono::milliseconds interval = std::chrono::milliseconds(LOG_FLUSH_INTERVAL_MS));
+    ~Logger();
+
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    // the logger of the LOG_* macros, writing to stdout. drained at exit.
+    static Logger& process();
+
+    bool enabled(LogLevel level) const { return level >= minLevel.load(std::memory_order_relaxed); }
+    void setLevel(LogLevel level) { minLevel.store(level, std::memory_order_relaxed); }
+
+    void log(LogLevel level, std::string message);
+    // writes every line queued so far before returning
+    void flush();
+    // lines lost to a full ring
+    uint64_t dropped() const { return droppedLines.load(); }
+
+private:
+    struct Entry {
+        LogLevel level = LogLevel::INFO;
+        std::chrono::system_clock::time_point time;
+        std::string message;
+    };
+
+    int fd;
+    std::chrono::milliseconds interval;
+    std::atomic<LogLevel> minLevel{static_cast<LogLevel>(KVDB_LOG_LEVEL)};
+    RingBuffer<Entry> ring;
+    std::atomic<uint64_t> droppedLines{0};
+    std::atomic<bool> urgent{false};
+    std::atomic<bool> synchronous{false};
+
+    std::mutex writeMtx; // the ring's consumer side and the file
+    uint64_t reportedDrops = 0;
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool stopping = false;
+    std::thread thread;
+
+    // stops the writer; lines logged from then on are written by their caller
+    void shutdown();
+    // formats entry as one line onto out
+    void append(std::string& out, const Entry& entry);
+    // caller holds writeMtx
+    void write(const std::string& out);
+};
+
+#define KVDB_LOG(level, expr)                                                        \
+    do {                                                                             \
+        if constexpr (static_cast<int>(level) >= KVDB_LOG_LEVEL) {                   \
+            Logger& kvdbLogger = Logger::process();                                  \
+            if (kvdbLogger.enabled(level)) {                                         \
+                std::ostringstream kvdbLine;                                         \
+                kvdbLine << expr;                                                    \
+                kvdbLogger.log(level, std::move(kvdbLine).str());                    \
+            }                                                                        \
+        }                                                                            \
+    } while (0)
+
+// LOG_INFO("[Flush] Wrote " << entries << " entries")
+#define LOG_DEBUG(expr) KVDB_LOG(LogLevel::DEBUG, expr)
+#define LOG_INFO(expr) KVDB_LOG(LogLevel::INFO, expr)
+#define LOG_WARN(expr) KVDB_LOG(LogLevel::WARN, expr)
+#define LOG_ERROR(expr) KVDB_LOG(LogLevel::ERROR, expr)
@@ -0,0 +1,34 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include "../../config.hpp"
+
+/**
+ * byte budget shared by every memtable and block cache in the process.
+ *
+ * 1. components reserve() memory as they allocate and release() it when freed
+ * 2. reservations never fail; exceeded() tells the owner to give memory back
+ * 3. memtables answer by flushing early, caches by evicting further
+ */
+class MemoryBudget {
+public:
+    explicit MemoryBudget(size_t limitBytes) : limitBytes(limitBytes) {}
+
+    // the budget used by default, sized by LSM_MEMORY_BUDGET_BYTES
+    static const std::shared_ptr<MemoryBudget>& process() {
+        static auto budget = std::make_shared<MemoryBudget>(LSM_MEMORY_BUDGET_BYTES);
+        return budget;
+    }
+
+    void reserve(size_t bytes) { used.fetch_add(bytes, std::memory_order_relaxed); }
+    void release(size_t bytes) { used.fetch_sub(bytes, std::memory_order_relaxed); }
+
+    size_t usage() const { return used.load(std::memory_order_relaxed); }
+    size_t limit() const { return limitBytes; }
+    bool exceeded() const { return usage() > limitBytes; }
+
+private:
+    size_t limitBytes;
+    std::atomic<size_t> used{0};
+};
@@ -0,0 +1,123 @@
+#include "stats.hpp"
+#include "logger.hpp"
+
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+uint64_t Counter::value() const {
+    uint64_t total = 0;
+    for (const auto& slot : slots) total += slot.value.load(std::memory_order_relaxed);
+    return total;
+}
+
+void ConcurrentHistogram::add(uint64_t value) {
+    Slot& slot = slots[statsSlot()];
+    std::lock_guard lock(slot.mtx);
+    slot.histogram.add(value);
+}
+
+Histogram ConcurrentHistogram::snapshot() const {
+    Histogram merged;
+    for (const auto& slot : slots) {
+        std::lock_guard lock(slot.mtx);
+        merged.merge(slot.histogram);
+    }
+    return merged;
+}
+
+StatsRegistry& StatsRegistry::process() {
+    static StatsRegistry registry;
+    return registry;
+}
+
+Counter& StatsRegistry::counter(const std::string& name) {
+    std::lock_guard lock(mtx);
+    auto& metric = counters[name];
+    if (!metric) metric = std::make_unique<Counter>();
+    return *metric;
+}
+
+Gauge& StatsRegistry::gauge(const std::string& name) {
+    std::lock_guard lock(mtx);
+    auto& metric = gauges[name];
+    if (!metric) metric = std::make_unique<Gauge>();
+    return *metric;
+}
+
+ConcurrentHistogram& StatsRegistry::histogram(const std::string& name) {
+    std::lock_guard lock(mtx);
+    auto& metric = histograms[name];
+    if (!metric) metric = std::make_unique<ConcurrentHistogram>();
+    return *metric;
+}
+
+void StatsRegistry::callback(const std::string& name, const void* owner, std::function<uint64_t()> read) {
+    std::lock_guard lock(callbackMtx);
+    auto& owners = callbacks[name];
+    std::erase_if(owners, [owner](const Callback& cb) { return cb.owner == owner; });
+    owners.push_back(Callback{owner, std::move(read)});
+}
+
+void StatsRegistry::removeCallbacks(const void* owner) {
+    std::lock_guard lock(callbackMtx);
+    for (auto it = callbacks.begin(); it != callbacks.end();) {
+        std::erase_if(it->second, [owner](const Callback& cb) { return cb.owner == owner; });
+        it = it->second.empty() ? callbacks.erase(it) : std::next(it);
+    }
+}
+
+std::string StatsRegistry::dump() {
+    std::map<std::string, std::string> lines;
+    {
+        std::lock_guard lock(mtx);
+        for (const auto& [name, metric] : counters) lines[name] = std::to_string(metric->value());
+        for (const auto& [name, metric] : gauges) lines[name] = std::to_string(metric->value());
+        for (const auto& [name, metric] : histograms) lines[name] = metric->snapshot().summary();
+    }
+    // callbacks run under their lock, so their owner can't remove them and
+    // go away halfway through. the metric lock is free by now: a callback
+    // may wait on a thread that is creating a metric
+    std::lock_guard lock(callbackMtx);
+    for (const auto& [name, owners] : callbacks) lines[name] = std::to_string(owners.back().read());
+
+    std::string out;
+    for (const auto& [name, value] : lines) out.append(name).append(" ").append(value).append("\n");
+    return out;
+}
+
+StatsExporter::StatsExporter(std::filesystem::path path, std::chrono::milliseconds interval, StatsRegistry& registry)
+    : path(std::move(path)), interval(interval), registry(registry) {
+    thread = std::thread([this]() {
+        std::unique_lock lock(mtx);
+        while (!stopping) {
+            cv.wait_for(lock, this->interval, [this]() { return stopping; });
+            lock.unlock();
+            exportNow();
+            lock.lock();
+        }
+    });
+}
+
+StatsExporter::~StatsExporter() {
+    {
+        std::lock_guard lock(mtx);
+        stopping = true;
+    }
+    cv.notify_one();
+    thread.join();
+}
+
+void StatsExporter::exportNow() {
+    auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    std::istringstream dump(registry.dump());
+    std::string prefixed;
+    for (std::string line; std::getline(dump, line);) {
+        prefixed.append(std::to_string(now)).append(" ").append(line).append("\n");
+    }
+
+    std::ofstream out(path, std::ios::app);
+    out << prefixed;
+    if (!out) LOG_ERROR("[Stats] Failed to write " << path.string());
+}
@@ -0,0 +1,153 @@
+#pragma once
+#include "histogram.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// counters and histograms spread their updates over this many slots, one
+// picked per thread, so hot paths on different threads rarely share a line
+constexpr const size_t STATS_SLOTS = 16;
+
+// the calling thread's slot
+inline size_t statsSlot() {
+    static std::atomic<size_t> next{0};
+    thread_local size_t slot = next.fetch_add(1, std::memory_order_relaxed) % STATS_SLOTS;
+    return slot;
+}
+
+// a count that only goes up
+class Counter {
+public:
+    void add(uint64_t n = 1) { slots[statsSlot()].value.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value() const;
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> value{0};
+    };
+    std::array<Slot, STATS_SLOTS> slots;
+};
+
+// a level that is set or moved up and down
+class Gauge {
+public:
+    void set(int64_t v) { level.store(v, std::memory_order_relaxed); }
+    void add(int64_t n) { level.fetch_add(n, std::memory_order_relaxed); }
+    int64_t value() const { return level.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> level{0};
+};
+
+// a Histogram per slot, each behind its own lock; snapshot() merges them
+class ConcurrentHistogram {
+public:
+    void add(uint64_t value);
+    Histogram snapshot() const;
+
+private:
+    struct alignas(64) Slot {
+        mutable std::mutex mtx;
+        Histogram histogram;
+    };
+    std::array<Slot, STATS_SLOTS> slots;
+};
+
+// times a scope into a histogram, in nanoseconds
+class ScopedTimer {
+public:
+    explicit ScopedTimer(ConcurrentHistogram& histogram)
+        : histogram(histogram), start(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer() {
+        histogram.add(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count()));
+    }
+
+private:
+    ConcurrentHistogram& histogram;
+    std::chrono::steady_clock::time_point start;
+};
+
+/**
+ * named metrics of the process, dumped by the "stats" command and written
+ * out periodically by StatsExporter.
+ *
+ * 1. counter(), gauge() and histogram() create a metric on first use and
+ *    keep it for the life of the registry, so hot paths look it up once and
+ *    hold on to the reference
+ * 2. callbacks are read only when dumped, for state that already lives
+ *    elsewhere (memtable bytes, segment counts, queue depths). each belongs
+ *    to an owner, which removes its callbacks before it goes away. they run
+ *    under their own lock, so one may take a lock under which metrics are
+ *    created
+ * 3. names are dotted, component first ("lsm.flushes"); histograms of
+ *    latencies end in _nanos
+ */
+class StatsRegistry {
+public:
+    // the registry every component reports to
+    static StatsRegistry& process();
+
+    Counter& counter(const std::string& name);
+    Gauge& gauge(const std::string& name);
+    ConcurrentHistogram& histogram(const std::string& name);
+
+    // with several owners of one name, the newest one still registered is
+    // reported; an owner registering a name again replaces its own callback
+    void callback(const std::string& name, const void* owner, std::function<uint64_t()> read);
+    void removeCallbacks(const void* owner);
+
+    // one "name value" line per metric, sorted by name; histograms as
+    // "name count=.. mean=.. p50=.. p99=.. p999=.. max=.."
+    std::string dump();
+
+private:
+    struct Callback {
+        const void* owner;
+        std::function<uint64_t()> read;
+    };
+
+    std::mutex mtx; // guards the metric maps
+    std::map<std::string, std::unique_ptr<Counter>> counters;
+    std::map<std::string, std::unique_ptr<Gauge>> gauges;
+    std::map<std::string, std::unique_ptr<ConcurrentHistogram>> histograms;
+    std::mutex callbackMtx; // held while callbacks run
+    std::map<std::string, std::vector<Callback>> callbacks; // oldest owner first
+};
+
+/**
+ * appends a dump of the registry to a file every interval, and once more
+ * when destroyed. every line is prefixed with the dump's unix time in
+ * milliseconds, so the file can be graphed per metric.
+ */
+class StatsExporter {
+public:
+    StatsExporter(std::filesystem::path path, std::chrono::milliseconds interval,
+                  StatsRegistry& registry = StatsRegistry::process());
+    ~StatsExporter();
+
+    StatsExporter(const StatsExporter&) = delete;
+    StatsExporter& operator=(const StatsExporter&) = delete;
+
+    void exportNow();
+
+private:
+    std::filesystem::path path;
+    std::chrono::milliseconds interval;
+    StatsRegistry& registry;
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool stopping = false;
+    std::thread thread;
+};
@@ -0,0 +1,134 @@
+#include "thread_pool.hpp"
+#include "logger.hpp"
+#include "stats.hpp"
+#include <algorithm>
+
+namespace {
+
+// the pool and index of the worker running on this thread, if any
+thread_local const ThreadPool* currentPool = nullptr;
+thread_local size_t currentWorker = 0;
+
+} // namespace
+
+ThreadPool::ThreadPool(size_t threads) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t i = 0; i < threads; ++i) workers.push_back(std::make_unique<Worker>());
+    for (size_t i = 0; i < threads; ++i) {
+        workers[i]->thread = std::thread([this, i]() { run(i); });
+    }
+
+    // the most recently created pool is the one reported
+    auto& registry = StatsRegistry::process();
+    registry.callback("pool.threads", this, [this]() { return workers.size(); });
+    registry.callback("pool.queued.high", this, [this]() { return queued[0].load(); });
+    registry.callback("pool.queued.normal", this, [this]() { return queued[1].load(); });
+    registry.callback("pool.queued.low", this, [this]() { return queued[2].load(); });
+    registry.callback("pool.running", this, [this]() { return running.load(); });
+    registry.callback("pool.executed", this, [this]() { return executed.load(); });
+    registry.callback("pool.stolen", this, [this]() { return stolen.load(); });
+}
+
+ThreadPool::~ThreadPool() {
+    StatsRegistry::process().removeCallbacks(this);
+    {
+        std::lock_guard lock(sleepMtx);
+        stopping = true;
+    }
+    sleepCv.notify_all();
+    for (auto& worker : workers) {
+        if (worker->thread.joinable()) worker->thread.join();
+    }
+}
+
+const std::shared_ptr<ThreadPool>& ThreadPool::process() {
+    static auto pool = std::make_shared<ThreadPool>(THREAD_POOL_THREADS);
+    return pool;
+}
+
+void ThreadPool::submit(Priority priority, std::function<void()> task) {
+    size_t target = currentPool == this ? currentWorker : nextWorker.fetch_add(1) % workers.size();
+    // counted before it's visible, so a thief can't take it and drop the count below zero
+    pending.fetch_add(1);
+    queued[static_cast<size_t>(priority)].fetch_add(1);
+    {
+        std::lock_guard lock(workers[target]->mtx);
+        workers[target]->queues[static_cast<size_t>(priority)].push_back(std::move(task));
+    }
+    // taking the lock orders this wakeup after a sleeping worker's last check
+    { std::lock_guard lock(sleepMtx); }
+    sleepCv.notify_one();
+}
+
+bool ThreadPool::runPendingTask(Priority lowest) {
+    size_t self = currentPool == this ? currentWorker : workers.size();
+    std::function<void()> task;
+    if (!take(self, lowest, task)) return false;
+    execute(task);
+    return true;
+}
+
+ThreadPool::Stats ThreadPool::stats() const {
+    Stats s;
+    s.threads = workers.size();
+    for (size_t p = 0; p < PRIORITIES; ++p) s.queued[p] = queued[p].load();
+    s.running = running.load();
+    s.executed = executed.load();
+    s.stolen = stolen.load();
+    return s;
+}
+
+void ThreadPool::run(size_t self) {
+    currentPool = this;
+    currentWorker = self;
+    std::function<void()> task;
+    while (true) {
+        if (take(self, Priority::LOW, task)) {
+            execute(task);
+            continue;
+        }
+        std::unique_lock lock(sleepMtx);
+        sleepCv.wait(lock, [this]() { return stopping || pending.load() > 0; });
+        // queued work still runs on shutdown; the engine relies on it to finish a flush
+        if (stopping && pending.load() == 0) return;
+    }
+}
+
+bool ThreadPool::take(size_t self, Priority lowest, std::function<void()>& task) {
+    for (size_t p = 0; p <= static_cast<size_t>(lowest); ++p) {
+        if (queued[p].load() == 0) continue;
+        // own deque first, then the others starting from the next worker
+        for (size_t i = 0; i < workers.size(); ++i) {
+            size_t victim = (self + i) % workers.size();
+            bool own = self < workers.size() && i == 0;
+            Worker& w = *workers[victim];
+            std::lock_guard lock(w.mtx);
+            auto& queue = w.queues[p];
+            if (queue.empty()) continue;
+            if (own) {
+                task = std::move(queue.front());
+                queue.pop_front();
+            } else {
+                task = std::move(queue.back());
+                queue.pop_back();
+                if (self < workers.size()) stolen.fetch_add(1);
+            }
+            queued[p].fetch_sub(1);
+            pending.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::execute(std::function<void()>& task) {
+    running.fetch_add(1);
+    try {
+        task();
+    } catch (const std::exception& e) {
+        LOG_ERROR("[ThreadPool] Task failed: " << e.what());
+    }
+    task = nullptr; // release whatever the task captured before sleeping
+    running.fetch_sub(1);
+    executed.fetch_add(1);
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "../../config.hpp"
+
+/**
+ * work-stealing pool for background and request work.
+ *
+ * 1. every worker owns one deque per priority. a task submitted from a
+ *    worker goes to that worker's deque, any other submission is spread
+ *    round robin
+ * 2. a worker looking for work goes through the priorities in order: its own
+ *    deque first, then it steals from the others. so a queued HIGH task runs
+ *    before any NORMAL or LOW one, wherever it was queued
+ * 3. owners take the oldest task from their deque, thieves the newest
+ * 4. tasks already running are never preempted: a long LOW task holds its
+ *    worker until it returns
+ *
+ * priorities used by the engine: HIGH memtable flushes, NORMAL client
+ * requests, LOW compactions.
+ */
+class ThreadPool {
+public:
+    enum class Priority { HIGH = 0, NORMAL = 1, LOW = 2 };
+    static constexpr size_t PRIORITIES = 3;
+
+    struct Stats {
+        size_t threads = 0;
+        std::array<size_t, PRIORITIES> queued{}; // waiting tasks, by priority
+        size_t running = 0;
+        uint64_t executed = 0;
+        uint64_t stolen = 0; // tasks run by a worker other than the one they were queued on
+    };
+
+    // threads 0 uses one per core
+    explicit ThreadPool(size_t threads = THREAD_POOL_THREADS);
+    // runs every queued task, then joins the workers
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // the pool used by default, sized by THREAD_POOL_THREADS
+    static const std::shared_ptr<ThreadPool>& process();
+
+    void submit(Priority priority, std::function<void()> task);
+    // runs one queued task of at least this priority on the calling thread.
+    // for callers that block on queued work, so they can't deadlock a busy pool.
+    // false if there was none.
+    bool runPendingTask(Priority lowest);
+
+    size_t size() const { return workers.size(); }
+    Stats stats() const;
+
+private:
+    struct Worker {
+        std::mutex mtx;
+        std::array<std::deque<std::function<void()>>, PRIORITIES> queues;
+        std::thread thread;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<size_t> nextWorker{0};
+    std::atomic<size_t> pending{0}; // queued tasks over every deque
+    std::array<std::atomic<size_t>, PRIORITIES> queued{};
+    std::atomic<size_t> running{0};
+    std::atomic<uint64_t> executed{0};
+    std::atomic<uint64_t> stolen{0};
+
+    std::mutex sleepMtx;
+    std::condition_variable sleepCv; // signalled on submit and on shutdown
+    bool stopping = false;
+
+    void run(size_t self);
+    // pops the best task for worker self (or for a caller outside the pool
+    // when self is size()) of priority lowest or higher
+    bool take(size_t self, Priority lowest, std::function<void()>& task);
+    void execute(std::function<void()>& task);
+};
@@ -1,7 +1,53 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
 
 constexpr const char* WAL_PATH = "data/db.wal";
+// none: leave flushing to the OS. batch: fdatasync every group commit.
+// periodic: fdatasync in the background every WAL_SYNC_INTERVAL_MS.
+enum class WalSyncMode { NONE, BATCH, PERIODIC };
+constexpr const WalSyncMode WAL_SYNC_MODE = WalSyncMode::PERIODIC;
+constexpr const int WAL_SYNC_INTERVAL_MS = 100;
+constexpr const size_t WAL_SEGMENT_BYTES = 4 * 1024 * 1024; // the log is split into segment files of this size
+constexpr const size_t WAL_RECYCLED_SEGMENTS = 4; // obsolete segments kept for reuse instead of being deleted
+// engine a Database is built on when none is passed in
+enum class EngineType { LSM, BTREE };
+constexpr const EngineType DB_ENGINE = EngineType::LSM;
 constexpr const char* SSTABLE_DIR = "data/segments";
-constexpr const int LSM_FLUSH_THRESHOLD = 2000;
-constexpr const int LSM_COMPACTION_INTERVAL_MS = 10000;
-constexpr const char* TOMBSTONE_MARKER = "\x1ETOMB";
\ No newline at end of file
+constexpr const size_t LSM_MEMTABLE_BYTES = 4 * 1024 * 1024; // a memtable is flushed once its entries take this many bytes
+constexpr const size_t LSM_MEMORY_BUDGET_BYTES = 64 * 1024 * 1024; // shared by all memtables and block caches in the process
+constexpr const size_t LSM_BLOCK_SIZE = 4096; // target size of a segment data block in bytes
+constexpr const int LSM_BLOOM_BITS_PER_KEY = 10; // 0 disables per-segment bloom filters
+constexpr const bool LSM_USE_MMAP_READS = true; // false reads segments with pread instead
+constexpr const size_t LSM_BLOCK_CACHE_BYTES = 8 * 1024 * 1024; // 0 disables the block cache
+constexpr const int LSM_NUM_LEVELS = 7;
+constexpr const size_t LSM_L0_COMPACTION_TRIGGER = 4; // number of L0 segments that triggers an L0 -> L1 compaction
+constexpr const uint64_t LSM_LEVEL1_MAX_BYTES = 10 * 1024 * 1024;
+constexpr const int LSM_LEVEL_SIZE_RATIO = 10; // each level may hold this many times the bytes of the level above
+constexpr const uint64_t LSM_TARGET_SEGMENT_BYTES = 2 * 1024 * 1024; // compaction output is split at this size
+constexpr const uint64_t LSM_MANIFEST_MAX_BYTES = 4 * 1024 * 1024; // the manifest is rewritten as a snapshot past this size
+// per-block compression. ZSTD and LZ4 need the library at build time
+// (KVDB_HAVE_ZSTD / KVDB_HAVE_LZ4) and fall back to the built-in LZ codec otherwise.
+enum class CompressionType : uint8_t { NONE = 0, LZ = 1, ZSTD = 2, LZ4 = 3 };
+// codec used for segments written to each level: hot upper levels favour
+// fast decoding, the bulk of the data in the deeper levels favours ratio
+constexpr const CompressionType LSM_LEVEL_COMPRESSION[LSM_NUM_LEVELS] = {
+    CompressionType::LZ, CompressionType::LZ, CompressionType::ZSTD, CompressionType::ZSTD,
+    CompressionType::ZSTD, CompressionType::ZSTD, CompressionType::ZSTD,
+};
+constexpr const size_t THREAD_POOL_THREADS = 4; // runs flushes, compactions and client requests; 0 uses one per core
+constexpr const char* BTREE_PATH = "data/btree.db"; // its WAL segments are <path>.wal-<id>
+constexpr const uint32_t BTREE_PAGE_SIZE = 4096;
+constexpr const size_t BTREE_CHECKPOINT_BYTES = 4 * 1024 * 1024; // WAL bytes written between two page file syncs
+constexpr const size_t BTREE_BUFFER_POOL_BYTES = 32 * 1024 * 1024; // hard cap on the pages a B+tree keeps in memory
+constexpr const int BTREE_WRITEBACK_INTERVAL_MS = 100; // dirty pages are written in the background at least this often
+constexpr const bool BTREE_DIRECT_IO = false; // O_DIRECT page I/O, bypassing the kernel page cache; needs 4 KiB multiple pages
+constexpr const int SERVER_WORKER_THREADS = 2; // event loops handing ready connections to the thread pool; 0 uses one per core
+constexpr const int SERVER_LISTEN_BACKLOG = 512;
+constexpr const size_t SERVER_MAX_REQUEST_BYTES = 16 * 1024 * 1024; // a connection sending a longer request is dropped
+constexpr const size_t SERVER_MAX_PENDING_OUTPUT = 4 * 1024 * 1024; // stop reading a client while this much is unsent
+constexpr const char* STATS_EXPORT_PATH = "stats.log"; // the daemon appends timestamped metric dumps here
+constexpr const int STATS_EXPORT_INTERVAL_MS = 10000; // 0 turns the exporter off
+constexpr const size_t LOG_RING_CAPACITY = 8192; // log lines queued for the writer; more are dropped and counted
+constexpr const int LOG_FLUSH_INTERVAL_MS = 50; // the writer drains at least this often, warnings and errors at once
+constexpr const char* TOMBSTONE_MARKER = "\x1ETOMB";
@@ -1,20 +1,110 @@
 #include "database.hpp"
+#include "../storage/lsm/engine/lsm_engine.hpp"
+#include "../storage/btree/btree_engine.hpp"
+#include "../common/utils/stats.hpp"
+
+namespace {
+
+// what clients asked of the engine, whichever it is
+struct DatabaseStats {
+    StatsRegistry& registry = StatsRegistry::process();
+    Counter& gets = registry.counter("db.gets");
+    Counter& puts = registry.counter("db.puts");
+    Counter& deletes = registry.counter("db.deletes");
+    Counter& batches = registry.counter("db.batches");
+    Counter& scans = registry.counter("db.scans");
+    Counter& bytesWritten = registry.counter("db.bytes_written"); // keys and values put
+    Counter& bytesRead = registry.counter("db.bytes_read");       // keys and values returned by gets
+    ConcurrentHistogram& getNanos = registry.histogram("db.get_nanos");
+    ConcurrentHistogram& writeNanos = registry.histogram("db.write_nanos"); // puts, deletes and batches
+};
+
+DatabaseStats& stats() {
+    static DatabaseStats s;
+    return s;
+}
+
+std::unique_ptr<StorageEngine> makeEngine(EngineType type) {
+    switch (type) {
+    case EngineType::BTREE:
+        return std::make_unique<BTreeEngine>();
+    case EngineType::LSM:
+    default:
+        return std::make_unique<LSMEngine>();
+    }
+}
+
+} // namespace
 
 Database::Database(std::unique_ptr<StorageEngine> engine)
     : engine_(std::move(engine)) {}
 
+Database::Database(EngineType type)
+    : engine_(makeEngine(type)) {}
+
 void Database::put(const std::string& key, const std::string& value) {
-    engine_->put(key, value);
+    auto& s = stats();
+    {
+        ScopedTimer timer(s.writeNanos);
+        engine_->put(key, value);
+    }
+    s.puts.add();
+    s.bytesWritten.add(key.size() + value.size());
 }
 
 std::optional<std::string> Database::get(const std::string& key) {
-    return engine_->get(key);
+    auto& s = stats();
+    std::optional<std::string> value;
+    {
+        ScopedTimer timer(s.getNanos);
+        value = engine_->get(key);
+    }
+    s.gets.add();
+    if (value) s.bytesRead.add(key.size() + value->size());
+    return value;
+}
+
+std::optional<std::string> Database::get(const std::string& key, const Snapshot& snapshot) {
+    auto& s = stats();
+    std::optional<std::string> value;
+    {
+        ScopedTimer timer(s.getNanos);
+        value = engine_->get(key, snapshot);
+    }
+    s.gets.add();
+    if (value) s.bytesRead.add(key.size() + value->size());
+    return value;
+}
+
+std::shared_ptr<const Snapshot> Database::snapshot() {
+    return engine_->snapshot();
 }
 
 void Database::remove(const std::string& key) {
-    engine_->remove(key);
+    auto& s = stats();
+    {
+        ScopedTimer timer(s.writeNanos);
+        engine_->remove(key);
+    }
+    s.deletes.add();
+    s.bytesWritten.add(key.size());
+}
+
+void Database::write(const WriteBatch& batch) {
+    auto& s = stats();
+    {
+        ScopedTimer timer(s.writeNanos);
+        engine_->write(batch);
+    }
+    s.batches.add();
+    for (const auto& op : batch.ops()) s.bytesWritten.add(op.key.size() + op.value.size());
 }
 
 std::vector<std::pair<std::string, std::string>> Database::getRange(int limit) {
     return engine_->getRange(limit);
 }
+
+std::unique_ptr<Cursor> Database::newCursor(const ScanOptions& options) {
+    stats().scans.add();
+    return engine_->newCursor(options);
+}
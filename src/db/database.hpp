@@ -1,17 +1,27 @@
 #pragma once
 #include "../storage/engine.hpp"
+#include "../config.hpp"
 #include <utility>
 #include <string>
 #include <vector>
+#include <memory>
 
 class Database {
 public:
     Database(std::unique_ptr<StorageEngine> engine);
+    // the engine of that type with its files where config.hpp puts them
+    explicit Database(EngineType type = DB_ENGINE);
 
     void put(const std::string& key, const std::string& value);
     std::optional<std::string> get(const std::string& key);
+    // the key's value as of a snapshot taken from this database
+    std::optional<std::string> get(const std::string& key, const Snapshot& snapshot);
+    // pins the current state for reads; released with the last copy
+    std::shared_ptr<const Snapshot> snapshot();
     std::vector<std::pair<std::string, std::string>> getRange(int limit = -1);
+    std::unique_ptr<Cursor> newCursor(const ScanOptions& options = {});
     void remove(const std::string& key);
+    void write(const WriteBatch& batch);
 
 private:
     std::unique_ptr<StorageEngine> engine_;
@@ -1,16 +1,17 @@
 #include "db/database.hpp"
 #include "storage/lsm/engine/lsm_engine.hpp"
-#include "cli/command.hpp"
+#include "storage/btree/btree_engine.hpp"
+#include "server/server.hpp"
+#include "common/utils/stats.hpp"
+#include "common/utils/logger.hpp"
 #include "config.hpp"
 
-#include <sys/socket.h>
-#include <sys/un.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <csignal>
+#include <cstdlib>
 #include <iostream>
 #include <memory>
-#include <sstream>
 #include <sys/stat.h>
 #include <filesystem> 
 #include <cstring>
@@ -123,43 +124,38 @@ void daemonize(const std::string& current_base_path) {
     close(out);
 }
 
-void handleClient(int clientSock, Database& db) {
-    char buffer[1024];
-    ssize_t bytesRead = read(clientSock, buffer, sizeof(buffer) - 1);
-    if (bytesRead <= 0) return;
-
-    buffer[bytesRead] = '\0';
-    std::istringstream iss(buffer);
-    std::ostringstream response;
-    std::string cmd;
-    iss >> cmd;
-
-    if (cmd == "put") {
-        std::string key, value;
-        iss >> key >> value;
-        response << PutCommand(key, value).execute(db);
-    } else if (cmd == "get") {
-        std::string key;
-        iss >> key;
-        response << GetCommand(key).execute(db);
-    } else if (cmd == "del") {
-        std::string key;
-        iss >> key;
-        response << RemoveCommand(key).execute(db);
-    } else if (cmd == "getall") {
-        for (const auto& [k, v] : db.getRange()) {
-            response << k << ": " << v << "\n";
+// db_main [--engine lsm|btree] [--workers <n>] [--backlog <n>] [--threads <n>]
+// the pool is only created after daemonize(): threads don't survive the fork
+ServerOptions parseOptions(int argc, char* argv[], EngineType& engine, size_t& poolThreads) {
+    ServerOptions options;
+    options.socketPath = SOCKET_FILE;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        if (flag == "--engine") {
+            std::string name = argv[i + 1];
+            if (name != "lsm" && name != "btree") {
+                std::cerr << "Unknown engine " << name << ", expected lsm or btree\n";
+                exit(EXIT_FAILURE);
+            }
+            engine = name == "btree" ? EngineType::BTREE : EngineType::LSM;
+        } else if (flag == "--threads") {
+            poolThreads = std::strtoul(argv[i + 1], nullptr, 10);
+        } else if (flag == "--workers") {
+            options.workers = std::atoi(argv[i + 1]);
+        } else if (flag == "--backlog") {
+            options.backlog = std::atoi(argv[i + 1]);
+        } else {
+            std::cerr << "Unknown option " << flag << "\n";
+            exit(EXIT_FAILURE);
         }
-    } else {
-        response << "Unknown command\n";
     }
-
-    std::string respStr = response.str();
-    write(clientSock, respStr.c_str(), respStr.size());
+    return options;
 }
 
-
-int main() {
+int main(int argc, char* argv[]) {
+    EngineType engine = DB_ENGINE;
+    size_t poolThreads = THREAD_POOL_THREADS;
+    ServerOptions options = parseOptions(argc, argv, engine, poolThreads);
     const std::string basePath = std::string(std::getenv("HOME")) + "/.kvdb";
     std::filesystem::create_directories(basePath);
     daemonize(basePath);
@@ -177,50 +173,33 @@ int main() {
     signal(SIGTERM, cleanupAndExit);
     signal(SIGHUP, SIG_IGN);
 
-    if (unlink(SOCKET_FILE) != 0 && errno != ENOENT) {
-        std::cerr << "Warning: Could not remove old socket file '" << SOCKET_FILE << "': " << strerror(errno) << std::endl;
-    }
+    // one pool for the engine's flushes and compactions and the server's requests
+    options.pool = std::make_shared<ThreadPool>(poolThreads);
 
-    int serverSock = socket(AF_UNIX, SOCK_STREAM, 0);
-    if (serverSock < 0) {
-        std::cerr << "Error: socket creation failed: " << strerror(errno) << std::endl;
-        cleanupAndExit(EXIT_FAILURE);
+    // initialize DB
+    std::unique_ptr<StorageEngine> storage;
+    if (engine == EngineType::BTREE) {
+        storage = std::make_unique<BTreeEngine>();
+    } else {
+        storage = std::make_unique<LSMEngine>(std::nullopt, LSM_MEMTABLE_BYTES, SSTABLE_DIR,
+                                              LSM_BLOCK_CACHE_BYTES, MemoryBudget::process(), options.pool);
     }
+    Database db(std::move(storage));
+    LOG_INFO("DB INITIALISED");
 
-    sockaddr_un addr{};
-    addr.sun_family = AF_UNIX;
-    strncpy(addr.sun_path, SOCKET_FILE, sizeof(addr.sun_path) - 1);
-
-    if (bind(serverSock, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
-        std::cerr << "Error: socket bind failed: " << strerror(errno) << std::endl;
-        close(serverSock);
-        cleanupAndExit(EXIT_FAILURE);
+    std::unique_ptr<StatsExporter> exporter;
+    if (STATS_EXPORT_INTERVAL_MS > 0) {
+        exporter = std::make_unique<StatsExporter>(STATS_EXPORT_PATH,
+                                                   std::chrono::milliseconds(STATS_EXPORT_INTERVAL_MS));
     }
 
-    if (listen(serverSock, 5) < 0) {
-        std::cerr << "Error: socket listen failed: " << strerror(errno) << std::endl;
-        close(serverSock);
+    Server server(db, options);
+    try {
+        server.start();
+    } catch (const std::exception& e) {
+        LOG_ERROR("Error: " << e.what());
         cleanupAndExit(EXIT_FAILURE);
     }
-
-    // initialize DB
-    Database db(std::make_unique<LSMEngine>());
-    std::cout << "DB INITIALISED\n";
-
-    while (true) {
-        int clientSock = accept(serverSock, nullptr, nullptr);
-        if (clientSock >= 0) {
-            handleClient(clientSock, db);
-            close(clientSock);
-        } else {
-            // handle accept errors, especially if a signal interrupts it
-            if (errno == EINTR) {
-                continue; // interrupted by a signal, try again
-            }
-            std::cerr << "Error: accept failed: " << strerror(errno) << std::endl;
-        }
-    }
-
-    close(serverSock);
+    server.wait();
     return 0;
-}
\ No newline at end of file
+}
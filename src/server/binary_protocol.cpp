@@ -0,0 +1,214 @@
+#include "binary_protocol.hpp"
+#include "../common/utils/coding.hpp"
+#include "../common/utils/file_utils.hpp"
+#include <cstring>
+#include <stdexcept>
+
+namespace binary_protocol {
+namespace {
+
+void respond(std::string& out, Status status, std::string_view body = {}) {
+    appendFrame(out, static_cast<uint8_t>(status), body);
+}
+
+template<typename T>
+T require(std::optional<T> field) {
+    if (!field) throw std::runtime_error("malformed request");
+    return *field;
+}
+
+// values are stored as given, so one starting with the tombstone marker
+// would read back as deleted
+std::string_view storable(std::string_view value) {
+    if (isTombstone(value)) throw std::runtime_error("value starts with the reserved tombstone marker");
+    return value;
+}
+
+std::string request(Op op, std::string_view body = {}) {
+    std::string out;
+    appendFrame(out, static_cast<uint8_t>(op), body);
+    return out;
+}
+
+} // namespace
+
+void appendFrame(std::string& out, uint8_t code, std::string_view body) {
+    out.push_back(static_cast<char>(MAGIC));
+    out.push_back(static_cast<char>(code));
+    coding::putU32(out, static_cast<uint32_t>(body.size()));
+    out.append(body.data(), body.size());
+}
+
+ParseResult parse(std::string_view buf, size_t maxBody, Frame& frame, size_t& consumed) {
+    if (buf.empty()) return ParseResult::INCOMPLETE;
+    if (static_cast<uint8_t>(buf[0]) != MAGIC) return ParseResult::INVALID;
+    if (buf.size() < HEADER_BYTES) return ParseResult::INCOMPLETE;
+
+    coding::Reader in(buf.substr(2));
+    uint32_t size = *in.u32();
+    if (size > maxBody) return ParseResult::INVALID;
+    if (buf.size() - HEADER_BYTES < size) return ParseResult::INCOMPLETE;
+
+    frame.code = static_cast<uint8_t>(buf[1]);
+    frame.body = buf.substr(HEADER_BYTES, size);
+    consumed = HEADER_BYTES + size;
+    return ParseResult::FRAME;
+}
+
+bool execute(const Frame& request, Database& db, std::string& out) {
+    coding::Reader in(request.body);
+    auto finished = [&] { if (!in.done()) throw std::runtime_error("malformed request"); };
+
+    switch (static_cast<Op>(request.code)) {
+    case Op::GET: {
+        auto value = db.get(std::string(request.body));
+        if (value) respond(out, Status::OK, *value);
+        else respond(out, Status::NOT_FOUND);
+        break;
+    }
+    case Op::PUT: {
+        auto key = require(in.bytes());
+        auto value = storable(require(in.bytes()));
+        finished();
+        db.put(std::string(key), std::string(value));
+        respond(out, Status::OK);
+        break;
+    }
+    case Op::DEL:
+        db.remove(std::string(request.body));
+        respond(out, Status::OK);
+        break;
+    case Op::MULTI_GET: {
+        auto count = require(in.u32());
+        std::vector<std::string_view> keys;
+        for (uint32_t i = 0; i < count; ++i) keys.push_back(require(in.bytes()));
+        finished();
+
+        std::string body;
+        coding::putU32(body, count);
+        for (auto key : keys) {
+            auto value = db.get(std::string(key));
+            body.push_back(value ? 1 : 0);
+            if (value) coding::putBytes(body, *value);
+        }
+        respond(out, Status::OK, body);
+        break;
+    }
+    case Op::WRITE: {
+        auto batch = require(WriteBatch::decode(request.body));
+        for (const auto& op : batch.ops()) {
+            if (op.type == OpType::CREATE) storable(op.value);
+        }
+        db.write(batch);
+        respond(out, Status::OK);
+        break;
+    }
+    case Op::SCAN: {
+        auto flags = require(in.u8());
+        auto start = require(in.bytes());
+        auto end = require(in.bytes());
+        auto limit = require(in.u32());
+        finished();
+
+        ScanOptions options;
+        if (flags & SCAN_HAS_START) options.start = std::string(start);
+        if (flags & SCAN_HAS_END) options.end = std::string(end);
+        options.reverse = flags & SCAN_REVERSE;
+
+        std::string body(sizeof(uint32_t), '\0'); // row count, patched below
+        uint32_t count = 0;
+        for (auto cursor = db.newCursor(options); cursor->valid() && count < limit; cursor->next(), ++count) {
+            coding::putBytes(body, cursor->key());
+            coding::putBytes(body, cursor->value());
+        }
+        std::memcpy(body.data(), &count, sizeof(count));
+        respond(out, Status::OK, body);
+        break;
+    }
+    case Op::QUIT:
+        respond(out, Status::OK);
+        return false;
+    default:
+        respond(out, Status::ERROR, "unknown op " + std::to_string(request.code));
+        break;
+    }
+    return true;
+}
+
+std::string get(std::string_view key) {
+    return request(Op::GET, key);
+}
+
+std::string put(std::string_view key, std::string_view value) {
+    std::string body;
+    coding::putBytes(body, key);
+    coding::putBytes(body, value);
+    return request(Op::PUT, body);
+}
+
+std::string remove(std::string_view key) {
+    return request(Op::DEL, key);
+}
+
+std::string multiGet(const std::vector<std::string>& keys) {
+    std::string body;
+    coding::putU32(body, static_cast<uint32_t>(keys.size()));
+    for (const auto& key : keys) coding::putBytes(body, key);
+    return request(Op::MULTI_GET, body);
+}
+
+std::string write(const WriteBatch& batch) {
+    return request(Op::WRITE, batch.encode());
+}
+
+std::string scan(const ScanOptions& options, uint32_t limit) {
+    uint8_t flags = (options.reverse ? SCAN_REVERSE : 0) |
+                    (options.start ? SCAN_HAS_START : 0) |
+                    (options.end ? SCAN_HAS_END : 0);
+    std::string body(1, static_cast<char>(flags));
+    coding::putBytes(body, options.start.value_or(""));
+    coding::putBytes(body, options.end.value_or(""));
+    coding::putU32(body, limit);
+    return request(Op::SCAN, body);
+}
+
+std::string quit() {
+    return request(Op::QUIT);
+}
+
+std::optional<std::vector<std::optional<std::string>>> decodeMultiGet(std::string_view body) {
+    coding::Reader in(body);
+    auto count = in.u32();
+    if (!count) return std::nullopt;
+    std::vector<std::optional<std::string>> values;
+    for (uint32_t i = 0; i < *count; ++i) {
+        auto found = in.u8();
+        if (!found) return std::nullopt;
+        if (!*found) {
+            values.emplace_back();
+            continue;
+        }
+        auto value = in.bytes();
+        if (!value) return std::nullopt;
+        values.emplace_back(std::string(*value));
+    }
+    if (!in.done()) return std::nullopt;
+    return values;
+}
+
+std::optional<std::vector<std::pair<std::string, std::string>>> decodeScan(std::string_view body) {
+    coding::Reader in(body);
+    auto count = in.u32();
+    if (!count) return std::nullopt;
+    std::vector<std::pair<std::string, std::string>> rows;
+    for (uint32_t i = 0; i < *count; ++i) {
+        auto key = in.bytes();
+        auto value = in.bytes();
+        if (!key || !value) return std::nullopt;
+        rows.emplace_back(std::string(*key), std::string(*value));
+    }
+    if (!in.done()) return std::nullopt;
+    return rows;
+}
+
+} // namespace binary_protocol
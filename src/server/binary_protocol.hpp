@@ -0,0 +1,77 @@
+#pragma once
+#include "../db/database.hpp"
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/**
+ * length-prefixed protocol for clients that need arbitrary keys and values.
+ *
+ * every request and response is one frame:
+ *
+ *   [1B MAGIC][1B op or status][4B body size][body]
+ *
+ * 1. a connection speaks this protocol when its first byte is MAGIC, which
+ *    can't start a text request; anything else is the text protocol
+ * 2. a client may write any number of requests before reading. responses
+ *    come back in request order, one frame per request
+ * 3. a body that doesn't decode gets an ERROR response and the connection
+ *    carries on; a bad header or a body over SERVER_MAX_REQUEST_BYTES can't
+ *    be skipped, so the server replies ERROR and closes
+ *
+ * request bodies (bytes = [4B size][data]):
+ *   GET       [key, raw]                  -> OK [value, raw] | NOT_FOUND
+ *   PUT       [bytes key][bytes value]    -> OK
+ *   DEL       [key, raw]                  -> OK
+ *   MULTI_GET [4B count][bytes key]...    -> OK [4B count] per key: [1B found][bytes value if found]
+ *   WRITE     WriteBatch::encode()        -> OK, applied atomically
+ *   SCAN      [1B flags][bytes start][bytes end][4B limit]
+ *                                         -> OK [4B count] per row: [bytes key][bytes value]
+ *             flags: 1 reverse, 2 start given, 4 end given
+ *   QUIT      empty                       -> OK, then the connection closes
+ * ERROR responses carry the message as their body.
+ */
+namespace binary_protocol {
+
+constexpr const uint8_t MAGIC = 0xDB;
+constexpr const size_t HEADER_BYTES = 6;
+
+enum class Op : uint8_t { GET = 1, PUT = 2, DEL = 3, MULTI_GET = 4, WRITE = 5, SCAN = 6, QUIT = 7 };
+enum class Status : uint8_t { OK = 0, NOT_FOUND = 1, ERROR = 2 };
+
+enum ScanFlags : uint8_t { SCAN_REVERSE = 1, SCAN_HAS_START = 2, SCAN_HAS_END = 4 };
+
+struct Frame {
+    uint8_t code; // Op in a request, Status in a response
+    std::string_view body;
+};
+
+enum class ParseResult { FRAME, INCOMPLETE, INVALID };
+
+void appendFrame(std::string& out, uint8_t code, std::string_view body);
+// reads the frame at the start of buf. on FRAME, consumed is its total size
+// and frame.body points into buf.
+ParseResult parse(std::string_view buf, size_t maxBody, Frame& frame, size_t& consumed);
+
+// runs one request and appends its response frame to out. returns false for
+// QUIT. throws on a malformed body, like the database does on failure; the
+// server answers either with an ERROR frame.
+bool execute(const Frame& request, Database& db, std::string& out);
+
+// request builders for clients
+std::string get(std::string_view key);
+std::string put(std::string_view key, std::string_view value);
+std::string remove(std::string_view key);
+std::string multiGet(const std::vector<std::string>& keys);
+std::string write(const WriteBatch& batch);
+std::string scan(const ScanOptions& options, uint32_t limit);
+std::string quit();
+
+// response body decoders; nullopt if the body is malformed
+std::optional<std::vector<std::optional<std::string>>> decodeMultiGet(std::string_view body);
+std::optional<std::vector<std::pair<std::string, std::string>>> decodeScan(std::string_view body);
+
+} // namespace binary_protocol
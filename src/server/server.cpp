@@ -0,0 +1,389 @@
+#include "server.hpp"
+#include "text_protocol.hpp"
+#include "binary_protocol.hpp"
+#include "../common/utils/stats.hpp"
+#include "../common/utils/logger.hpp"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+
+#ifndef EPOLLEXCLUSIVE
+#define EPOLLEXCLUSIVE 0 // older kernels wake every worker; accept copes with EAGAIN
+#endif
+
+struct Server::Connection {
+    enum class Protocol { UNKNOWN, TEXT, BINARY };
+
+    int fd;
+    Protocol protocol = Protocol::UNKNOWN; // decided by the first byte received
+    std::string in;      // received bytes; requests before inPos are done
+    size_t inPos = 0;
+    std::string out;     // replies; bytes before outPos are sent
+    size_t outPos = 0;
+    bool eof = false;    // the client shut down its side
+    bool quit = false;   // close once out is sent
+    bool error = false;  // the socket reported an error
+    // one-shot events already keep tasks for a connection apart; the lock
+    // makes the hand-over from one pool thread to the next explicit
+    std::mutex mtx;
+
+    size_t pending() const { return out.size() - outPos; }
+};
+
+struct Server::Worker {
+    int epollFd = -1;
+    std::thread thread;
+    std::mutex mtx; // guards connections; pool tasks close them
+    std::unordered_map<int, std::unique_ptr<Connection>> connections;
+};
+
+namespace {
+
+constexpr uint32_t CLIENT_EVENTS = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET | EPOLLONESHOT;
+
+Counter& requests() {
+    static Counter& c = StatsRegistry::process().counter("server.requests");
+    return c;
+}
+
+} // namespace
+
+namespace {
+
+enum class ReadResult { DATA, AGAIN, CLOSED, ERROR };
+
+ReadResult readSome(int fd, std::string& in, bool& eof) {
+    char buf[64 * 1024];
+    while (true) {
+        ssize_t n = ::read(fd, buf, sizeof(buf));
+        if (n > 0) {
+            in.append(buf, static_cast<size_t>(n));
+            return ReadResult::DATA;
+        }
+        if (n == 0) {
+            eof = true;
+            return ReadResult::CLOSED;
+        }
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) return ReadResult::AGAIN;
+        return ReadResult::ERROR;
+    }
+}
+
+} // namespace
+
+Server::Server(Database& db, ServerOptions options) : db(db), options(std::move(options)) {
+    if (!this->options.pool) this->options.pool = ThreadPool::process();
+}
+
+Server::~Server() {
+    stop();
+}
+
+void Server::start() {
+    if (running.load()) return;
+
+    if (::unlink(options.socketPath.c_str()) != 0 && errno != ENOENT) {
+        LOG_WARN("[Server] Could not remove old socket file '" << options.socketPath << "': "
+                << std::strerror(errno));
+    }
+
+    listenFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listenFd < 0) throw std::runtime_error("socket creation failed: " + std::string(std::strerror(errno)));
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, options.socketPath.c_str(), sizeof(addr.sun_path) - 1);
+    if (::bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        std::string error = std::strerror(errno);
+        ::close(listenFd);
+        throw std::runtime_error("socket bind failed: " + error);
+    }
+    if (::listen(listenFd, options.backlog) < 0) {
+        std::string error = std::strerror(errno);
+        ::close(listenFd);
+        throw std::runtime_error("socket listen failed: " + error);
+    }
+
+    stopFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (stopFd < 0) throw std::runtime_error("eventfd failed: " + std::string(std::strerror(errno)));
+
+    int count = options.workers > 0 ? options.workers
+                                    : std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    for (int i = 0; i < count; ++i) {
+        auto worker = std::make_unique<Worker>();
+        worker->epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+        if (worker->epollFd < 0) throw std::runtime_error("epoll_create1 failed: " + std::string(std::strerror(errno)));
+
+        // the listening socket is level-triggered: a pending client keeps
+        // waking one worker until somebody accepts it
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+        ev.data.ptr = &listenFd;
+        ::epoll_ctl(worker->epollFd, EPOLL_CTL_ADD, listenFd, &ev);
+        ev.events = EPOLLIN;
+        ev.data.ptr = &stopFd;
+        ::epoll_ctl(worker->epollFd, EPOLL_CTL_ADD, stopFd, &ev);
+        workers.push_back(std::move(worker));
+    }
+
+    StatsRegistry::process().callback("server.connections", this, [this]() { return connections.load(); });
+    running.store(true);
+    for (auto& worker : workers) {
+        Worker* w = worker.get();
+        w->thread = std::thread([this, w]() { runWorker(*w); });
+    }
+    LOG_INFO("[Server] Listening on " << options.socketPath << " with " << count
+            << " event loops, " << options.pool->size() << " pool threads, backlog " << options.backlog);
+}
+
+void Server::stop() {
+    if (!running.exchange(false)) return;
+    StatsRegistry::process().removeCallbacks(this);
+    // the eventfd stays readable, so every worker sees it
+    uint64_t one = 1;
+    if (::write(stopFd, &one, sizeof(one)) < 0) {
+        LOG_ERROR("[Server] Failed to signal workers: " << std::strerror(errno));
+    }
+    wait();
+
+    // connections out on the pool come back (re-armed or closed) before they're torn down
+    {
+        std::unique_lock lock(tasksMtx);
+        tasksCv.wait(lock, [this]() { return tasks == 0; });
+    }
+    for (auto& worker : workers) {
+        while (!worker->connections.empty()) closeConnection(*worker, *worker->connections.begin()->second);
+        ::close(worker->epollFd);
+    }
+    workers.clear();
+    ::close(listenFd);
+    ::close(stopFd);
+    listenFd = stopFd = -1;
+    ::unlink(options.socketPath.c_str());
+    LOG_INFO("[Server] Stopped");
+}
+
+void Server::wait() {
+    std::lock_guard lock(joinMtx);
+    for (auto& worker : workers) {
+        if (worker->thread.joinable()) worker->thread.join();
+    }
+}
+
+void Server::runWorker(Worker& worker) {
+    epoll_event events[64];
+    bool stopping = false;
+    while (!stopping) {
+        int n = ::epoll_wait(worker.epollFd, events, 64, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            LOG_ERROR("[Server] epoll_wait failed: " << std::strerror(errno));
+            break;
+        }
+        for (int i = 0; i < n; ++i) {
+            void* tag = events[i].data.ptr;
+            if (tag == &stopFd) {
+                stopping = true;
+                break;
+            }
+            if (tag == &listenFd) {
+                acceptClient(worker);
+                continue;
+            }
+            auto* conn = static_cast<Connection*>(tag);
+            {
+                std::lock_guard lock(tasksMtx);
+                ++tasks;
+            }
+            if (events[i].events & EPOLLERR) conn->error = true;
+            options.pool->submit(ThreadPool::Priority::NORMAL, [this, &worker, conn]() { serveOnPool(worker, *conn); });
+        }
+    }
+}
+
+void Server::serveOnPool(Worker& worker, Connection& conn) {
+    std::unique_lock connLock(conn.mtx);
+    bool keep = false;
+    try {
+        keep = !conn.error && service(conn);
+    } catch (const std::exception& e) {
+        LOG_ERROR("[Server] " << e.what());
+    }
+    if (keep) {
+        // one-shot: nothing is reported for conn until it's re-armed here
+        epoll_event ev{};
+        ev.events = CLIENT_EVENTS;
+        ev.data.ptr = &conn;
+        connLock.unlock();
+        if (::epoll_ctl(worker.epollFd, EPOLL_CTL_MOD, conn.fd, &ev) < 0) {
+            connLock.lock();
+            keep = false;
+        }
+    }
+    if (!keep) {
+        connLock.unlock();
+        closeConnection(worker, conn);
+    }
+
+    std::lock_guard lock(tasksMtx);
+    if (--tasks == 0) tasksCv.notify_all();
+}
+
+void Server::closeConnection(Worker& worker, Connection& conn) {
+    std::lock_guard lock(worker.mtx);
+    ::epoll_ctl(worker.epollFd, EPOLL_CTL_DEL, conn.fd, nullptr);
+    ::close(conn.fd);
+    worker.connections.erase(conn.fd); // destroys conn
+    connections.fetch_sub(1);
+}
+
+void Server::acceptClient(Worker& worker) {
+    // one client per wakeup spreads a burst of connects over the workers
+    int fd = ::accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            LOG_ERROR("[Server] accept failed: " << std::strerror(errno));
+        }
+        return;
+    }
+
+    auto conn = std::make_unique<Connection>();
+    conn->fd = fd;
+    epoll_event ev{};
+    ev.events = CLIENT_EVENTS;
+    ev.data.ptr = conn.get();
+    // registered before it's armed: its first event may reach a pool task right away
+    std::lock_guard lock(worker.mtx);
+    Connection* registered = worker.connections.emplace(fd, std::move(conn)).first->second.get();
+    connections.fetch_add(1);
+    if (::epoll_ctl(worker.epollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        LOG_ERROR("[Server] epoll_ctl failed: " << std::strerror(errno));
+        worker.connections.erase(registered->fd);
+        connections.fetch_sub(1);
+        ::close(fd);
+    }
+}
+
+bool Server::flush(Connection& conn) {
+    while (conn.pending() > 0) {
+        ssize_t n = ::send(conn.fd, conn.out.data() + conn.outPos, conn.pending(), MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK; // resumes on EPOLLOUT
+        }
+        conn.outPos += static_cast<size_t>(n);
+    }
+    conn.out.clear();
+    conn.outPos = 0;
+    return true;
+}
+
+bool Server::service(Connection& conn) {
+    // edge-triggered: keep going until the socket would block, so no
+    // readiness is lost
+    while (true) {
+        if (!flush(conn)) return false;
+        if (conn.pending() >= SERVER_MAX_PENDING_OUTPUT) return true; // slow reader: wait for EPOLLOUT
+        if (conn.quit) return conn.pending() > 0;                      // close once the replies are out
+
+        if (processInput(conn)) continue;
+
+        if (conn.eof) return conn.pending() > 0;
+        if (conn.in.size() - conn.inPos > SERVER_MAX_REQUEST_BYTES + binary_protocol::HEADER_BYTES) {
+            LOG_WARN("[Server] Dropping client with a request over " << SERVER_MAX_REQUEST_BYTES << " bytes");
+            return false;
+        }
+
+        switch (readSome(conn.fd, conn.in, conn.eof)) {
+        case ReadResult::DATA:
+        case ReadResult::CLOSED:
+            continue;
+        case ReadResult::AGAIN:
+            return true;
+        case ReadResult::ERROR:
+            return false;
+        }
+    }
+}
+
+bool Server::processInput(Connection& conn) {
+    using Protocol = Connection::Protocol;
+    if (conn.protocol == Protocol::UNKNOWN) {
+        if (conn.inPos == conn.in.size()) return false;
+        conn.protocol = static_cast<uint8_t>(conn.in[conn.inPos]) == binary_protocol::MAGIC ? Protocol::BINARY
+                                                                                         : Protocol::TEXT;
+    }
+
+    bool progressed = false;
+    while (!conn.quit && conn.pending() < SERVER_MAX_PENDING_OUTPUT) {
+        bool ran = conn.protocol == Protocol::BINARY ? runBinaryRequest(conn) : runTextRequest(conn);
+        if (!ran) break;
+        progressed = true;
+    }
+    if (conn.inPos == conn.in.size()) {
+        conn.in.clear();
+        conn.inPos = 0;
+    } else if (conn.inPos > conn.in.size() / 2) {
+        conn.in.erase(0, conn.inPos);
+        conn.inPos = 0;
+    }
+    return progressed;
+}
+
+bool Server::runTextRequest(Connection& conn) {
+    size_t end = conn.in.find('\n', conn.inPos);
+    if (end == std::string::npos) {
+        // a last request without its newline still counts once the client is done
+        if (!conn.eof || conn.inPos == conn.in.size()) return false;
+        end = conn.in.size();
+    }
+    std::string_view line(conn.in.data() + conn.inPos, end - conn.inPos);
+    if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+    conn.inPos = std::min(end + 1, conn.in.size());
+
+    requests().add();
+    try {
+        if (!text_protocol::execute(line, db, conn.out)) conn.quit = true;
+    } catch (const std::exception& e) {
+        conn.out.append("ERROR: ").append(e.what()).append("\n");
+    }
+    return true;
+}
+
+bool Server::runBinaryRequest(Connection& conn) {
+    binary_protocol::Frame frame;
+    size_t consumed = 0;
+    std::string_view buf(conn.in.data() + conn.inPos, conn.in.size() - conn.inPos);
+    switch (binary_protocol::parse(buf, SERVER_MAX_REQUEST_BYTES, frame, consumed)) {
+    case binary_protocol::ParseResult::INCOMPLETE:
+        return false;
+    case binary_protocol::ParseResult::INVALID:
+        // the stream can't be resynced past a bad header
+        binary_protocol::appendFrame(conn.out, static_cast<uint8_t>(binary_protocol::Status::ERROR), "invalid frame");
+        conn.inPos = conn.in.size();
+        conn.quit = true;
+        return true;
+    case binary_protocol::ParseResult::FRAME:
+        break;
+    }
+
+    requests().add();
+    size_t responseStart = conn.out.size();
+    try {
+        if (!binary_protocol::execute(frame, db, conn.out)) conn.quit = true;
+    } catch (const std::exception& e) {
+        conn.out.resize(responseStart);
+        binary_protocol::appendFrame(conn.out, static_cast<uint8_t>(binary_protocol::Status::ERROR), e.what());
+    }
+    conn.inPos += consumed;
+    return true;
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include "../db/database.hpp"
+#include "../config.hpp"
+#include "../common/utils/thread_pool.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct ServerOptions {
+    std::string socketPath;
+    int workers = SERVER_WORKER_THREADS;   // event loops; 0: one per core
+    int backlog = SERVER_LISTEN_BACKLOG;
+    std::shared_ptr<ThreadPool> pool;      // runs the requests; null uses ThreadPool::process()
+};
+
+/**
+ * event-driven server on a unix socket.
+ *
+ * 1. each worker thread runs its own epoll loop; the listening socket is in
+ *    every loop with EPOLLEXCLUSIVE, so one worker wakes per new client and
+ *    keeps that connection for its lifetime
+ * 2. a ready connection is handed to the thread pool as a NORMAL task, which
+ *    reads whatever arrived, runs every complete request in order and writes
+ *    the replies, parking the rest until the socket is writable again.
+ *    sockets are edge-triggered and one-shot: the task re-arms its
+ *    connection when done, so no two tasks ever serve the same one
+ * 3. connections are persistent: a client may send any number of requests
+ *    and closes (or sends quit) when done
+ * 4. the first byte picks the protocol for the connection: binary_protocol
+ *    frames start with its MAGIC byte, anything else is text_protocol
+ *
+ * flushes queued on the pool run ahead of client requests, compactions after.
+ */
+class Server {
+public:
+    Server(Database& db, ServerOptions options);
+    ~Server();
+
+    Server(const Server&) = delete;
+    Server& operator=(const Server&) = delete;
+
+    // binds and listens, replacing a stale socket file, then starts the
+    // workers. throws if the socket can't be set up.
+    void start();
+    // wakes every worker, closes all connections and joins them
+    void stop();
+    // blocks until stop() is called from another thread
+    void wait();
+
+    size_t connectionCount() const { return connections.load(); }
+
+private:
+    struct Connection;
+    struct Worker;
+
+    Database& db;
+    ServerOptions options;
+    int listenFd = -1;
+    int stopFd = -1; // eventfd, readable once stop() was called
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<size_t> connections{0};
+    std::atomic<bool> running{false};
+    std::mutex joinMtx;
+
+    std::mutex tasksMtx;
+    std::condition_variable tasksCv; // signalled when the last pool task of the server ends
+    size_t tasks = 0;                // connections handed to the pool and not back yet
+
+    void runWorker(Worker& worker);
+    void acceptClient(Worker& worker);
+    // pool task: services conn, then re-arms or closes it
+    void serveOnPool(Worker& worker, Connection& conn);
+    void closeConnection(Worker& worker, Connection& conn);
+    // reads, runs requests and writes replies until the socket would block.
+    // false once the connection should be closed
+    bool service(Connection& conn);
+    // false on a write error
+    bool flush(Connection& conn);
+    // runs the complete requests buffered in conn; false if there were none
+    bool processInput(Connection& conn);
+    // each runs the next buffered request, if it's complete
+    bool runTextRequest(Connection& conn);
+    bool runBinaryRequest(Connection& conn);
+};
@@ -0,0 +1,43 @@
+#include "text_protocol.hpp"
+#include "../cli/command.hpp"
+#include <sstream>
+
+namespace text_protocol {
+
+bool execute(std::string_view line, Database& db, std::string& out) {
+    std::istringstream iss{std::string(line)};
+    std::string cmd;
+    iss >> cmd;
+
+    if (cmd == "put") {
+        std::string key, value;
+        iss >> key >> value;
+        out += PutCommand(key, value).execute(db);
+    } else if (cmd == "get") {
+        std::string key;
+        iss >> key;
+        out += GetCommand(key).execute(db);
+    } else if (cmd == "del") {
+        std::string key;
+        iss >> key;
+        out += RemoveCommand(key).execute(db);
+    } else if (cmd == "scan" || cmd == "rscan") {
+        std::string start = "-", end = "-";
+        int limit = 100;
+        iss >> start >> end >> limit;
+        out += ScanCommand(start, end, limit, cmd == "rscan").execute(db);
+    } else if (cmd == "getall") {
+        for (const auto& [k, v] : db.getRange()) {
+            out.append(k).append(": ").append(v).append("\n");
+        }
+    } else if (cmd == "stats") {
+        out += StatsCommand().execute(db);
+    } else if (cmd == "quit") {
+        return false;
+    } else if (!cmd.empty()) {
+        out += "Unknown command\n";
+    }
+    return true;
+}
+
+} // namespace text_protocol
@@ -0,0 +1,23 @@
+#pragma once
+#include "../db/database.hpp"
+#include <string>
+#include <string_view>
+
+/**
+ * the line-based protocol spoken by db_cli and nc:
+ *
+ *   put <key> <value> | get <key> | del <key> | getall
+ *   scan <start> <end> <limit> | rscan <start> <end> <limit>
+ *   stats | quit
+ *
+ * keys and values are whitespace-free words. every request is one line; the
+ * reply is zero or more lines. quit makes the server close the connection
+ * once every earlier reply is sent.
+ */
+namespace text_protocol {
+
+// runs one request line (without its newline) and appends the reply to out.
+// returns false for quit.
+bool execute(std::string_view line, Database& db, std::string& out);
+
+} // namespace text_protocol
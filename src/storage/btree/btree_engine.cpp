@@ -0,0 +1,527 @@
+#include "btree_engine.hpp"
+#include "../../common/utils/stats.hpp"
+#include "../../common/utils/logger.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+using namespace btree;
+
+namespace {
+
+// meta page fields, after the common header's crc and type
+constexpr size_t META_MAGIC = 8;
+constexpr size_t META_VERSION = 16;
+constexpr size_t META_PAGE_SIZE = 20;
+constexpr size_t META_ROOT = 24;
+constexpr size_t META_FREE_LIST = 32;
+
+bool byKey(const LeafCell& cell, const std::string& key) { return cell.key < key; }
+
+uint32_t checkedPageSize(uint32_t pageSize) {
+    if (pageSize < 512 || pageSize > 65536 || pageSize % 512 != 0) {
+        throw std::runtime_error("B+tree page size must be a multiple of 512 between 512 and 65536");
+    }
+    return pageSize;
+}
+
+Counter& checkpoints() {
+    static Counter& c = StatsRegistry::process().counter("btree.checkpoints");
+    return c;
+}
+
+} // namespace
+
+BTreeEngine::BTreeEngine(std::filesystem::path path, uint32_t pageSize, size_t bufferBytes, bool directIO)
+    : pageSize(checkedPageSize(pageSize)),
+      pager(path, pageSize, directIO),
+      buffers(pager, bufferBytes / pageSize),
+      wal(path.string() + ".wal") {
+    std::unique_lock lock(mtx);
+    if (pager.pageCount() == 0) {
+        // a new tree: the meta page and an empty leaf as the root
+        pager.allocate();
+        root = allocatePage();
+        Page leaf = newPage(root);
+        writeLeaf(leaf.data(), pageSize, {}, NO_PAGE, NO_PAGE);
+        writeMeta();
+    } else {
+        loadMeta();
+    }
+
+    // puts and deletes are idempotent, so records whose pages already made
+    // it to disk can be replayed again
+    size_t replayed = 0;
+    wal.replay([this, &replayed](const WalRecord& rec) {
+        switch (rec.opType) {
+        case OpType::CREATE:
+        case OpType::UPDATE:
+            applyPut(rec.key, rec.value);
+            break;
+        case OpType::DELETE:
+            applyRemove(rec.key);
+            break;
+        default:
+            return;
+        }
+        ++replayed;
+    });
+    checkpoint();
+    LOG_INFO("[BTree] Opened " << path.string() << ": " << pager.pageCount() << " pages, replayed "
+            << replayed << " WAL records");
+
+    // page counts and buffer stats have their own locks, so a dump never
+    // waits for the tree's
+    auto& registry = StatsRegistry::process();
+    registry.callback("btree.pages", this, [this]() { return pager.pageCount(); });
+    registry.callback("btree.buffer.hits", this, [this]() { return buffers.stats().hits; });
+    registry.callback("btree.buffer.misses", this, [this]() { return buffers.stats().misses; });
+    registry.callback("btree.buffer.evictions", this, [this]() { return buffers.stats().evictions; });
+    registry.callback("btree.buffer.writes", this, [this]() { return buffers.stats().writes; });
+    registry.callback("btree.buffer.dirty", this, [this]() { return buffers.stats().dirty; });
+}
+
+BTreeEngine::~BTreeEngine() {
+    StatsRegistry::process().removeCallbacks(this);
+    std::unique_lock lock(mtx);
+    try {
+        checkpoint();
+    } catch (const std::exception& e) {
+        // the WAL is still there, so the next open replays it
+        LOG_ERROR("[BTree] Checkpoint on close failed: " << e.what());
+    }
+}
+
+void BTreeEngine::put(const std::string& key, const std::string& value) {
+    validate(key);
+    std::unique_lock lock(mtx);
+    log(WalRecord{OpType::CREATE, key, value});
+    applyPut(key, value);
+    if (metaDirty) writeMeta();
+    if (loggedBytes >= BTREE_CHECKPOINT_BYTES) checkpoint();
+}
+
+std::optional<std::string> BTreeEngine::get(const std::string& key) {
+    std::shared_lock lock(mtx);
+    Page page = readPage(findLeaf(key));
+    Node leaf(page.data());
+    size_t i = leaf.lowerBound(key);
+    if (i == leaf.size() || leaf.key(i) != key) return std::nullopt;
+    return readValue(leaf, i);
+}
+
+void BTreeEngine::remove(const std::string& key) {
+    validate(key);
+    std::unique_lock lock(mtx);
+    log(WalRecord{OpType::DELETE, key, ""});
+    applyRemove(key);
+    if (metaDirty) writeMeta();
+    if (loggedBytes >= BTREE_CHECKPOINT_BYTES) checkpoint();
+}
+
+void BTreeEngine::write(const WriteBatch& batch) {
+    if (batch.empty()) return;
+    for (const auto& op : batch.ops()) validate(op.key);
+    std::unique_lock lock(mtx);
+    // one record for the whole batch; readers wait for all of it
+    log(WalRecord{OpType::BATCH, "", batch.encode()});
+    for (const auto& op : batch.ops()) {
+        if (op.type == OpType::DELETE) applyRemove(op.key);
+        else applyPut(op.key, op.value);
+    }
+    if (metaDirty) writeMeta();
+    if (loggedBytes >= BTREE_CHECKPOINT_BYTES) checkpoint();
+}
+
+int BTreeEngine::height() {
+    std::shared_lock lock(mtx);
+    int levels = 1;
+    for (uint64_t id = root;; ++levels) {
+        Page page = readPage(id);
+        if (pageType(page.data()) == LEAF) return levels;
+        id = Node(page.data()).leftmost();
+    }
+}
+
+BTreeEngine::Page BTreeEngine::readPage(uint64_t id) const {
+    return buffers.fetch(id);
+}
+
+BTreeEngine::Page BTreeEngine::newPage(uint64_t id) {
+    Page page = buffers.create(id);
+    page.markDirty();
+    return page;
+}
+
+uint64_t BTreeEngine::allocatePage() {
+    if (freeList == NO_PAGE) return pager.allocate();
+    uint64_t id = freeList;
+    freeList = pageNext(readPage(id).data());
+    metaDirty = true;
+    return id;
+}
+
+void BTreeEngine::freePage(uint64_t id) {
+    Page page = newPage(id);
+    initPage(page.data(), pageSize, FREE, 0, freeList);
+    freeList = id;
+    metaDirty = true;
+}
+
+void BTreeEngine::loadMeta() {
+    Page page = readPage(META_PAGE);
+    const char* p = page.data();
+    if (pageType(p) != META || load<uint64_t>(p + META_MAGIC) != BTREE_MAGIC ||
+        load<uint32_t>(p + META_VERSION) != BTREE_FORMAT_VERSION) {
+        throw std::runtime_error("Not a B+tree page file");
+    }
+    if (load<uint32_t>(p + META_PAGE_SIZE) != pageSize) {
+        throw std::runtime_error("B+tree page file was written with " +
+                                 std::to_string(load<uint32_t>(p + META_PAGE_SIZE)) + " byte pages");
+    }
+    root = load<uint64_t>(p + META_ROOT);
+    freeList = load<uint64_t>(p + META_FREE_LIST);
+}
+
+void BTreeEngine::writeMeta() {
+    Page page = newPage(META_PAGE);
+    char* p = page.data();
+    initPage(p, pageSize, META);
+    store(p + META_MAGIC, BTREE_MAGIC);
+    store(p + META_VERSION, BTREE_FORMAT_VERSION);
+    store(p + META_PAGE_SIZE, pageSize);
+    store(p + META_ROOT, root);
+    store(p + META_FREE_LIST, freeList);
+    metaDirty = false;
+}
+
+void BTreeEngine::validate(const std::string& key) const {
+    if (key.size() > maxKeySize()) {
+        throw std::runtime_error("B+tree keys are limited to " + std::to_string(maxKeySize()) + " bytes");
+    }
+}
+
+void BTreeEngine::log(WalRecord&& record) {
+    loggedBytes += record.key.size() + record.value.size();
+    wal.append(std::move(record));
+}
+
+void BTreeEngine::checkpoint() {
+    // every record logged so far is on a page by now; once the pages are
+    // committed the log is no longer needed
+    if (metaDirty) writeMeta();
+    buffers.flush();
+    pager.commit();
+    wal.removeSealed(wal.rotate());
+    loggedBytes = 0;
+    checkpoints().add();
+}
+
+uint64_t BTreeEngine::findLeaf(std::string_view key, std::vector<uint64_t>* path) const {
+    uint64_t id = root;
+    while (true) {
+        Page page = readPage(id);
+        if (pageType(page.data()) == LEAF) return id;
+        if (path) path->push_back(id);
+        id = Node(page.data()).childFor(key);
+    }
+}
+
+void BTreeEngine::applyPut(const std::string& key, const std::string& value) {
+    std::vector<uint64_t> path;
+    uint64_t id = findLeaf(key, &path);
+    Page page = readPage(id);
+    Node leaf(page.data());
+    uint64_t prev = leaf.prev(), next = leaf.next();
+    auto cells = leaf.leafCells();
+
+    auto it = std::lower_bound(cells.begin(), cells.end(), key, byKey);
+    if (it != cells.end() && it->key == key) {
+        // freed first, so a new chain can reuse the old one's pages
+        if (it->overflow) freeOverflow(load<uint64_t>(it->value.data()));
+        *it = makeCell(key, value);
+    } else {
+        cells.insert(it, makeCell(key, value));
+    }
+
+    if (fits(cells, pageSize)) {
+        writeLeaf(page.data(), pageSize, cells, prev, next);
+        page.markDirty();
+        return;
+    }
+
+    // split: the upper half moves to a new leaf linked in right after this one
+    size_t split = splitPoint(cells);
+    std::vector<LeafCell> upper(std::make_move_iterator(cells.begin() + split), std::make_move_iterator(cells.end()));
+    cells.resize(split);
+    uint64_t rightId = allocatePage();
+    Page right = newPage(rightId);
+    writeLeaf(right.data(), pageSize, upper, id, next);
+    writeLeaf(page.data(), pageSize, cells, prev, rightId);
+    page.markDirty();
+    if (next != NO_PAGE) {
+        Page following = readPage(next);
+        setPagePrev(following.data(), rightId);
+        following.markDirty();
+    }
+    insertIntoParent(path, id, upper.front().key, rightId);
+}
+
+void BTreeEngine::insertIntoParent(std::vector<uint64_t>& path, uint64_t left, std::string key, uint64_t right) {
+    while (true) {
+        if (path.empty()) {
+            // the root split: the tree grows a level
+            uint64_t newRoot = allocatePage();
+            Page page = newPage(newRoot);
+            writeInternal(page.data(), pageSize, left, {{std::move(key), right}});
+            root = newRoot;
+            metaDirty = true;
+            return;
+        }
+
+        uint64_t id = path.back();
+        path.pop_back();
+        Page page = readPage(id);
+        Node node(page.data());
+        uint64_t leftmost = node.leftmost();
+        auto cells = node.internalCells();
+        auto it = std::upper_bound(cells.begin(), cells.end(), key,
+                                   [](const std::string& k, const InternalCell& c) { return k < c.key; });
+        cells.insert(it, {std::move(key), right});
+
+        if (fits(cells, pageSize)) {
+            writeInternal(page.data(), pageSize, leftmost, cells);
+            page.markDirty();
+            return;
+        }
+
+        // split: the middle cell moves up, its child becomes the new node's leftmost
+        size_t split = splitPoint(cells);
+        InternalCell middle = std::move(cells[split]);
+        std::vector<InternalCell> upper(std::make_move_iterator(cells.begin() + split + 1),
+                                        std::make_move_iterator(cells.end()));
+        cells.resize(split);
+        uint64_t rightId = allocatePage();
+        Page rightPage = newPage(rightId);
+        writeInternal(rightPage.data(), pageSize, middle.child, upper);
+        writeInternal(page.data(), pageSize, leftmost, cells);
+        page.markDirty();
+
+        left = id;
+        key = std::move(middle.key);
+        right = rightId;
+    }
+}
+
+void BTreeEngine::applyRemove(const std::string& key) {
+    uint64_t id = findLeaf(key);
+    Page page = readPage(id);
+    Node leaf(page.data());
+    size_t i = leaf.lowerBound(key);
+    if (i == leaf.size() || leaf.key(i) != key) return;
+
+    if (leaf.overflow(i)) freeOverflow(leaf.overflowPage(i));
+    uint64_t prev = leaf.prev(), next = leaf.next();
+    auto cells = leaf.leafCells();
+    cells.erase(cells.begin() + static_cast<std::ptrdiff_t>(i));
+    writeLeaf(page.data(), pageSize, cells, prev, next);
+    page.markDirty();
+}
+
+LeafCell BTreeEngine::makeCell(const std::string& key, const std::string& value) {
+    LeafCell cell;
+    cell.key = key;
+    cell.valueSize = static_cast<uint32_t>(value.size());
+    if (LEAF_CELL_HEADER + key.size() + value.size() <= maxCellBytes(pageSize)) {
+        cell.value = value;
+        return cell;
+    }
+
+    // the value goes to a chain of overflow pages, the cell keeps the first one
+    size_t capacity = overflowCapacity(pageSize);
+    std::vector<uint64_t> ids((value.size() + capacity - 1) / capacity);
+    for (auto& id : ids) id = allocatePage();
+    for (size_t i = 0; i < ids.size(); ++i) {
+        size_t offset = i * capacity;
+        size_t n = std::min(capacity, value.size() - offset);
+        Page page = newPage(ids[i]);
+        initPage(page.data(), pageSize, OVERFLOW, static_cast<uint16_t>(n),
+                 i + 1 < ids.size() ? ids[i + 1] : NO_PAGE);
+        std::memcpy(page.data() + HEADER_BYTES, value.data() + offset, n);
+    }
+    cell.overflow = true;
+    cell.value.resize(sizeof(uint64_t));
+    store(cell.value.data(), ids.front());
+    return cell;
+}
+
+std::string BTreeEngine::readValue(const Node& leaf, size_t i) const {
+    if (!leaf.overflow(i)) return std::string(leaf.value(i));
+    std::string value;
+    value.reserve(leaf.valueSize(i));
+    for (uint64_t id = leaf.overflowPage(i); id != NO_PAGE && value.size() < leaf.valueSize(i);) {
+        Page page = readPage(id);
+        value.append(page.data() + HEADER_BYTES, btree::pageCount(page.data()));
+        id = pageNext(page.data());
+    }
+    if (value.size() != leaf.valueSize(i)) throw std::runtime_error("Broken B+tree overflow chain");
+    return value;
+}
+
+void BTreeEngine::freeOverflow(uint64_t first) {
+    for (uint64_t id = first; id != NO_PAGE;) {
+        uint64_t next = pageNext(readPage(id).data());
+        freePage(id);
+        id = next;
+    }
+}
+
+BTreeEngine::Leaf BTreeEngine::loadLeaf(uint64_t id) {
+    std::shared_lock lock(mtx);
+    return readLeaf(id);
+}
+
+uint64_t BTreeEngine::loadLeafFor(std::string_view key, Leaf& leaf) {
+    std::shared_lock lock(mtx);
+    uint64_t id = findLeaf(key);
+    leaf = readLeaf(id);
+    return id;
+}
+
+uint64_t BTreeEngine::loadEdgeLeaf(bool last, Leaf& leaf) {
+    std::shared_lock lock(mtx);
+    uint64_t id = root;
+    while (true) {
+        Page page = readPage(id);
+        if (pageType(page.data()) == LEAF) break;
+        Node node(page.data());
+        id = last && node.size() > 0 ? node.child(node.size() - 1) : node.leftmost();
+    }
+    leaf = readLeaf(id);
+    return id;
+}
+
+BTreeEngine::Leaf BTreeEngine::readLeaf(uint64_t id) {
+    Page page = readPage(id);
+    Node node(page.data());
+    Leaf leaf;
+    leaf.prev = node.prev();
+    leaf.next = node.next();
+    leaf.entries.reserve(node.size());
+    for (size_t i = 0; i < node.size(); ++i) leaf.entries.emplace_back(node.key(i), readValue(node, i));
+    return leaf;
+}
+
+/**
+ * holds a copy of one leaf at a time. leaves are never freed (nodes don't
+ * merge), so a sibling link read earlier still leads to a leaf, and moving
+ * on picks up whatever that leaf holds by then.
+ *
+ * 1. forward: a split moves the upper half of a leaf into a new right
+ *    sibling, which the copy's next link skips, but those keys are already
+ *    in the copy
+ * 2. backward: a split of the previous leaf puts its upper half between it
+ *    and the copy, so the prev link alone would skip it. stepping back checks
+ *    that the leaf reached links forward to the one left, and otherwise walks
+ *    forward to the leaf that does
+ * 3. a seek finds and copies its leaf under one lock; a split in between
+ *    would move the keys a reverse scan starts from out of the copy
+ */
+class BTreeCursor : public Cursor {
+public:
+    BTreeCursor(BTreeEngine& engine, ScanOptions options) : engine(engine), options(std::move(options)) {
+        if (!this->options.reverse) {
+            if (this->options.start) {
+                seek(*this->options.start);
+            } else {
+                leafId = engine.loadEdgeLeaf(false, leaf);
+                forwardFrom(0);
+            }
+        } else if (this->options.end) {
+            seekBefore(*this->options.end);
+        } else {
+            leafId = engine.loadEdgeLeaf(true, leaf);
+            backwardFrom(leaf.entries.size());
+        }
+    }
+
+    bool valid() const override {
+        if (pos >= leaf.entries.size()) return false;
+        const auto& key = leaf.entries[pos].first;
+        if (!options.reverse) return !options.end || key < *options.end;
+        return !options.start || key >= *options.start;
+    }
+
+    void seek(const std::string& target) override {
+        if (!options.reverse) {
+            const std::string& from = options.start && target < *options.start ? *options.start : target;
+            leafId = engine.loadLeafFor(from, leaf);
+            forwardFrom(lowerBound(from));
+        } else if (options.end && target >= *options.end) {
+            seekBefore(*options.end);
+        } else {
+            leafId = engine.loadLeafFor(target, leaf);
+            auto it = std::upper_bound(leaf.entries.begin(), leaf.entries.end(), target,
+                                       [](const std::string& t, const auto& e) { return t < e.first; });
+            backwardFrom(static_cast<size_t>(it - leaf.entries.begin()));
+        }
+    }
+
+    void next() override {
+        if (options.reverse) backwardFrom(pos);
+        else forwardFrom(pos + 1);
+    }
+
+    std::string_view key() const override { return leaf.entries[pos].first; }
+    std::string_view value() const override { return leaf.entries[pos].second; }
+
+private:
+    BTreeEngine& engine;
+    ScanOptions options;
+    BTreeEngine::Leaf leaf;
+    uint64_t leafId = NO_PAGE;
+    size_t pos = 0; // entries.size() once the scan ran off the tree
+
+    void load(uint64_t id) {
+        leaf = engine.loadLeaf(id);
+        leafId = id;
+    }
+
+    size_t lowerBound(const std::string& target) const {
+        auto it = std::lower_bound(leaf.entries.begin(), leaf.entries.end(), target,
+                                   [](const auto& e, const std::string& t) { return e.first < t; });
+        return static_cast<size_t>(it - leaf.entries.begin());
+    }
+
+    // the entry at i, or the first one in a following leaf
+    void forwardFrom(size_t i) {
+        while (i >= leaf.entries.size() && leaf.next != NO_PAGE) {
+            load(leaf.next);
+            i = 0;
+        }
+        pos = std::min(i, leaf.entries.size());
+    }
+
+    // the entry before i, or the last one in a preceding leaf
+    void backwardFrom(size_t i) {
+        while (i == 0 && leaf.prev != NO_PAGE) {
+            uint64_t from = leafId;
+            load(leaf.prev);
+            while (leaf.next != from && leaf.next != NO_PAGE) load(leaf.next);
+            i = leaf.entries.size();
+        }
+        pos = i == 0 ? leaf.entries.size() : i - 1;
+    }
+
+    // last entry strictly before key
+    void seekBefore(const std::string& key) {
+        leafId = engine.loadLeafFor(key, leaf);
+        backwardFrom(lowerBound(key));
+    }
+};
+
+std::unique_ptr<Cursor> BTreeEngine::newCursor(const ScanOptions& options) {
+    if (options.snapshot) throw std::runtime_error("Snapshots are not supported by the B+tree engine");
+    return std::make_unique<BTreeCursor>(*this, options);
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include "../engine.hpp"
+#include "../wal/wal.hpp"
+#include "btree_node.hpp"
+#include "buffer_manager.hpp"
+#include "pager.hpp"
+#include "../../config.hpp"
+#include <filesystem>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * page-oriented B+tree, for read-mostly data.
+ *
+ * 1. keys and values live in fixed-size leaf pages, sorted, and are updated
+ *    in place; internal pages only route. a lookup reads one page per level,
+ *    and leaves are linked both ways for range scans
+ * 2. an overfull node splits in two and pushes a separator into its parent;
+ *    deletes only remove the cell, underfull nodes are not merged
+ * 3. values too large for a quarter page go to a chain of overflow pages.
+ *    freed pages are kept on a free list and reused
+ * 4. pages are cached in a BufferManager of bufferBytes, which writes
+ *    dirty ones back in the background and on eviction
+ * 5. every write is logged to a WAL before the pages change. every
+ *    BTREE_CHECKPOINT_BYTES of log, and on close, all dirty pages are
+ *    written, the page file is committed and the log dropped. after a
+ *    crash the Pager rolls the file back to the last commit from its
+ *    journal, and opening replays the log on top
+ *
+ * reads share a lock and writes take it exclusively. cursors copy one leaf
+ * at a time and follow the sibling links, so they hold no lock between
+ * calls.
+ */
+class BTreeEngine : public StorageEngine {
+public:
+    explicit BTreeEngine(std::filesystem::path path = BTREE_PATH, uint32_t pageSize = BTREE_PAGE_SIZE,
+                         size_t bufferBytes = BTREE_BUFFER_POOL_BYTES, bool directIO = BTREE_DIRECT_IO);
+    ~BTreeEngine();
+
+    void put(const std::string& key, const std::string& value) override;
+    std::optional<std::string> get(const std::string& key) override;
+    using StorageEngine::get; // no snapshots: pages are updated in place
+    void remove(const std::string& key) override;
+    void write(const WriteBatch& batch) override;
+    std::unique_ptr<Cursor> newCursor(const ScanOptions& options = {}) override;
+
+    size_t maxKeySize() const { return btree::maxKeyBytes(pageSize); }
+    // number of levels, 1 while the root is a leaf
+    int height();
+    // pages in the file, including those not written back yet
+    uint64_t pageCount() const { return pager.pageCount(); }
+    BufferManager::Stats bufferStats() { return buffers.stats(); }
+
+private:
+    friend class BTreeCursor;
+
+    using Page = BufferManager::PageRef;
+
+    struct Leaf {
+        std::vector<std::pair<std::string, std::string>> entries;
+        uint64_t prev = btree::NO_PAGE;
+        uint64_t next = btree::NO_PAGE;
+    };
+
+    uint32_t pageSize;
+    Pager pager;
+    mutable BufferManager buffers; // a cache, so reading through it is const
+    WAL wal;
+    std::shared_mutex mtx; // shared by readers, exclusive for writers and checkpoints
+
+    // guarded by mtx
+    uint64_t root = btree::NO_PAGE;
+    uint64_t freeList = btree::NO_PAGE;
+    bool metaDirty = false;
+    size_t loggedBytes = 0; // since the last checkpoint
+
+    Page readPage(uint64_t id) const;
+    // a page about to be rewritten in full; marked dirty
+    Page newPage(uint64_t id);
+    uint64_t allocatePage();
+    void freePage(uint64_t id);
+    void loadMeta();
+    void writeMeta();
+
+    void validate(const std::string& key) const;
+    void log(WalRecord&& record);
+    void checkpoint();
+    void applyPut(const std::string& key, const std::string& value);
+    void applyRemove(const std::string& key);
+    // leaf that holds key; path gets the internal pages above it, root first
+    uint64_t findLeaf(std::string_view key, std::vector<uint64_t>* path = nullptr) const;
+    void insertIntoParent(std::vector<uint64_t>& path, uint64_t left, std::string key, uint64_t right);
+
+    btree::LeafCell makeCell(const std::string& key, const std::string& value);
+    std::string readValue(const btree::Node& leaf, size_t i) const;
+    void freeOverflow(uint64_t first);
+
+    Leaf readLeaf(uint64_t id); // caller holds mtx
+
+    // for cursors; each takes the lock shared. finding a leaf and copying it
+    // happen under one lock, so a split can't move keys out in between
+    Leaf loadLeaf(uint64_t id);
+    uint64_t loadLeafFor(std::string_view key, Leaf& leaf); // returns the leaf's id
+    uint64_t loadEdgeLeaf(bool last, Leaf& leaf);
+};
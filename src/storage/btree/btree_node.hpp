@@ -0,0 +1,225 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * on-disk layout of B+tree pages. every page starts with the same header:
+ *
+ *   [4B crc32c of the rest of the page, kept by the Pager]
+ *   [1B PageType][1B unused][2B count]
+ *   [8B next][8B prev]
+ *
+ * meta (page 0): [8B magic][4B version][4B page size][8B root][8B free list head]
+ *                 after the crc and type, at offset 8
+ * leaf:     count cells; next/prev are the right and left siblings
+ * internal: count cells; next is the leftmost child
+ * overflow: count payload bytes after the header; next is the following page
+ * free:     next is the following free page
+ *
+ * leaf and internal pages keep a slot array of [2B cell offset] right after
+ * the header, sorted by key, and pack the cells from the end of the page:
+ *
+ *   leaf cell:     [2B key size][1B flags][4B value size][key][value]
+ *                  with FLAG_OVERFLOW the value is [8B first overflow page]
+ *   internal cell: [2B key size][8B child][key]
+ *                  child holds the keys >= key, up to the next cell's key
+ *
+ * page 0 is the meta page, so 0 doubles as "no page" in links.
+ */
+namespace btree {
+
+enum PageType : uint8_t { META = 1, LEAF = 2, INTERNAL = 3, OVERFLOW = 4, FREE = 5 };
+
+constexpr const uint64_t META_PAGE = 0;
+constexpr const uint64_t NO_PAGE = 0;
+constexpr const size_t HEADER_BYTES = 24;
+constexpr const size_t SLOT_BYTES = 2;
+constexpr const size_t LEAF_CELL_HEADER = 7;
+constexpr const size_t INTERNAL_CELL_HEADER = 10;
+constexpr const uint8_t FLAG_OVERFLOW = 1;
+
+constexpr const uint64_t BTREE_MAGIC = 0x314552544244564BULL; // "KVDBTRE1"
+constexpr const uint32_t BTREE_FORMAT_VERSION = 1;
+
+template<typename T>
+inline T load(const char* p) {
+    T v;
+    std::memcpy(&v, p, sizeof(T));
+    return v;
+}
+
+template<typename T>
+inline void store(char* p, T v) {
+    std::memcpy(p, &v, sizeof(T));
+}
+
+inline uint8_t pageType(const char* page) { return static_cast<uint8_t>(page[4]); }
+inline uint16_t pageCount(const char* page) { return load<uint16_t>(page + 6); }
+inline uint64_t pageNext(const char* page) { return load<uint64_t>(page + 8); }
+inline uint64_t pagePrev(const char* page) { return load<uint64_t>(page + 16); }
+inline void setPageNext(char* page, uint64_t next) { store(page + 8, next); }
+inline void setPagePrev(char* page, uint64_t prev) { store(page + 16, prev); }
+
+// clears page and writes a header
+inline void initPage(char* page, size_t pageSize, PageType type, uint16_t count = 0,
+                     uint64_t next = NO_PAGE, uint64_t prev = NO_PAGE) {
+    std::memset(page, 0, pageSize);
+    page[4] = static_cast<char>(type);
+    store(page + 6, count);
+    setPageNext(page, next);
+    setPagePrev(page, prev);
+}
+
+// a cell may take at most a quarter of a page, so an overfull node always
+// splits into two halves that fit
+inline size_t maxCellBytes(size_t pageSize) { return (pageSize - HEADER_BYTES) / 4 - SLOT_BYTES; }
+inline size_t maxKeyBytes(size_t pageSize) { return maxCellBytes(pageSize) / 2; }
+inline size_t overflowCapacity(size_t pageSize) { return pageSize - HEADER_BYTES; }
+
+struct LeafCell {
+    std::string key;
+    std::string value;  // the value, or the 8B first overflow page
+    bool overflow = false;
+    uint32_t valueSize = 0; // size of the whole value, also when it overflows
+
+    size_t bytes() const { return LEAF_CELL_HEADER + key.size() + value.size(); }
+};
+
+struct InternalCell {
+    std::string key;
+    uint64_t child = NO_PAGE;
+
+    size_t bytes() const { return INTERNAL_CELL_HEADER + key.size(); }
+};
+
+// read-only view over a leaf or internal page
+class Node {
+public:
+    explicit Node(const char* page) : page(page) {}
+
+    bool leaf() const { return pageType(page) == LEAF; }
+    size_t size() const { return pageCount(page); }
+    uint64_t next() const { return pageNext(page); }
+    uint64_t prev() const { return pagePrev(page); }
+    uint64_t leftmost() const { return pageNext(page); }
+
+    std::string_view key(size_t i) const {
+        const char* c = cell(i);
+        return {c + (leaf() ? LEAF_CELL_HEADER : INTERNAL_CELL_HEADER), load<uint16_t>(c)};
+    }
+
+    // leaf cells
+    bool overflow(size_t i) const { return cell(i)[2] & FLAG_OVERFLOW; }
+    uint32_t valueSize(size_t i) const { return load<uint32_t>(cell(i) + 3); }
+    // the inline value, or the 8B overflow page id
+    std::string_view value(size_t i) const {
+        const char* c = cell(i);
+        size_t keySize = load<uint16_t>(c);
+        return {c + LEAF_CELL_HEADER + keySize, overflow(i) ? sizeof(uint64_t) : valueSize(i)};
+    }
+    uint64_t overflowPage(size_t i) const { return load<uint64_t>(value(i).data()); }
+
+    // internal cells
+    uint64_t child(size_t i) const { return load<uint64_t>(cell(i) + 2); }
+
+    // first cell with key >= target
+    size_t lowerBound(std::string_view target) const {
+        size_t lo = 0, hi = size();
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (key(mid) < target) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo;
+    }
+
+    // internal: the child whose range holds target
+    uint64_t childFor(std::string_view target) const {
+        size_t lo = 0, hi = size(); // first cell with key > target
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (key(mid) <= target) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo == 0 ? leftmost() : child(lo - 1);
+    }
+
+    std::vector<LeafCell> leafCells() const {
+        std::vector<LeafCell> cells(size());
+        for (size_t i = 0; i < cells.size(); ++i) {
+            cells[i].key = key(i);
+            cells[i].value = value(i);
+            cells[i].overflow = overflow(i);
+            cells[i].valueSize = valueSize(i);
+        }
+        return cells;
+    }
+
+    std::vector<InternalCell> internalCells() const {
+        std::vector<InternalCell> cells(size());
+        for (size_t i = 0; i < cells.size(); ++i) cells[i] = {std::string(key(i)), child(i)};
+        return cells;
+    }
+
+private:
+    const char* page;
+
+    const char* cell(size_t i) const { return page + load<uint16_t>(page + HEADER_BYTES + i * SLOT_BYTES); }
+};
+
+template<typename Cell>
+bool fits(const std::vector<Cell>& cells, size_t pageSize) {
+    size_t used = HEADER_BYTES;
+    for (const auto& c : cells) used += c.bytes() + SLOT_BYTES;
+    return used <= pageSize;
+}
+
+// index at which an overfull node splits, balancing bytes. leaves keep
+// cells [0, split) left and [split, n) right; internal nodes push cell
+// split up and keep the cells on either side of it
+template<typename Cell>
+size_t splitPoint(const std::vector<Cell>& cells) {
+    size_t total = 0;
+    for (const auto& c : cells) total += c.bytes() + SLOT_BYTES;
+    size_t left = 0;
+    size_t i = 0;
+    while (i + 2 < cells.size() && left < total / 2) left += cells[i++].bytes() + SLOT_BYTES;
+    return std::max<size_t>(i, 1);
+}
+
+inline void writeLeaf(char* page, size_t pageSize, const std::vector<LeafCell>& cells,
+                      uint64_t prev, uint64_t next) {
+    initPage(page, pageSize, LEAF, static_cast<uint16_t>(cells.size()), next, prev);
+    size_t end = pageSize;
+    for (size_t i = 0; i < cells.size(); ++i) {
+        const auto& c = cells[i];
+        end -= c.bytes();
+        char* p = page + end;
+        store(p, static_cast<uint16_t>(c.key.size()));
+        p[2] = static_cast<char>(c.overflow ? FLAG_OVERFLOW : 0);
+        store(p + 3, c.valueSize);
+        std::memcpy(p + LEAF_CELL_HEADER, c.key.data(), c.key.size());
+        std::memcpy(p + LEAF_CELL_HEADER + c.key.size(), c.value.data(), c.value.size());
+        store(page + HEADER_BYTES + i * SLOT_BYTES, static_cast<uint16_t>(end));
+    }
+}
+
+inline void writeInternal(char* page, size_t pageSize, uint64_t leftmost, const std::vector<InternalCell>& cells) {
+    initPage(page, pageSize, INTERNAL, static_cast<uint16_t>(cells.size()), leftmost);
+    size_t end = pageSize;
+    for (size_t i = 0; i < cells.size(); ++i) {
+        const auto& c = cells[i];
+        end -= c.bytes();
+        char* p = page + end;
+        store(p, static_cast<uint16_t>(c.key.size()));
+        store(p + 2, c.child);
+        std::memcpy(p + INTERNAL_CELL_HEADER, c.key.data(), c.key.size());
+        store(page + HEADER_BYTES + i * SLOT_BYTES, static_cast<uint16_t>(end));
+    }
+}
+
+} // namespace btree
@@ -0,0 +1,222 @@
+#include "buffer_manager.hpp"
+#include "../../common/utils/logger.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+
+BufferManager::PageRef& BufferManager::PageRef::operator=(PageRef&& other) noexcept {
+    if (this != &other) {
+        release();
+        owner = other.owner;
+        frame = other.frame;
+        page = other.page;
+        buf = other.buf;
+        other.owner = nullptr;
+        other.buf = nullptr;
+    }
+    return *this;
+}
+
+void BufferManager::PageRef::markDirty() {
+    if (owner) owner->markDirty(frame);
+}
+
+void BufferManager::PageRef::release() {
+    if (!owner) return;
+    owner->unpin(frame);
+    owner = nullptr;
+    buf = nullptr;
+}
+
+BufferManager::BufferManager(Pager& pager, size_t frames, std::chrono::milliseconds writeBackInterval)
+    : pager(pager),
+      pageSize(pager.pageSize()),
+      memory(std::max(frames, MIN_FRAMES) * pager.pageSize()),
+      frames(std::max(frames, MIN_FRAMES)),
+      writeBackInterval(writeBackInterval) {
+    table.reserve(this->frames.size());
+    counters.frames = this->frames.size();
+    writeBackThread = std::thread([this]() { runWriteBack(); });
+}
+
+BufferManager::~BufferManager() {
+    {
+        std::lock_guard lock(mtx);
+        stopping = true;
+    }
+    writeBackCv.notify_one();
+    writeBackThread.join();
+}
+
+BufferManager::PageRef BufferManager::fetch(uint64_t page) { return pin(page, true); }
+
+BufferManager::PageRef BufferManager::create(uint64_t page) { return pin(page, false); }
+
+BufferManager::PageRef BufferManager::pin(uint64_t page, bool read) {
+    std::unique_lock lock(mtx);
+    while (true) {
+        auto it = table.find(page);
+        if (it != table.end()) {
+            Frame& f = frames[it->second];
+            if (f.busy) {
+                changed.wait(lock);
+                continue;
+            }
+            ++f.pins;
+            f.referenced = true;
+            ++counters.hits;
+            return PageRef(this, it->second, page, frameData(it->second));
+        }
+
+        size_t victim;
+        if (!findVictim(victim)) {
+            changed.wait(lock);
+            continue;
+        }
+        Frame& f = frames[victim];
+        if (f.dirty) {
+            writeBack(lock, {victim});
+            // someone may have pinned it again, or loaded page, meanwhile
+            continue;
+        }
+        if (f.page != NO_FRAME_PAGE) {
+            table.erase(f.page);
+            ++counters.evictions;
+        }
+        f.page = page;
+        f.busy = true;
+        table[page] = victim;
+
+        ++counters.misses;
+        if (read) {
+            lock.unlock();
+            try {
+                pager.read(page, frameData(victim));
+            } catch (...) {
+                lock.lock();
+                table.erase(page);
+                f.page = NO_FRAME_PAGE;
+                f.busy = false;
+                changed.notify_all();
+                throw;
+            }
+            lock.lock();
+        } else {
+            std::memset(frameData(victim), 0, pageSize);
+        }
+        f.busy = false;
+        f.pins = 1;
+        f.referenced = true;
+        changed.notify_all();
+        return PageRef(this, victim, page, frameData(victim));
+    }
+}
+
+bool BufferManager::findVictim(size_t& victim) {
+    // two turns: the first may only clear referenced bits
+    for (size_t step = 0; step < 2 * frames.size(); ++step) {
+        Frame& f = frames[hand];
+        size_t current = hand;
+        hand = (hand + 1) % frames.size();
+        if (f.pins > 0 || f.busy) continue;
+        if (f.referenced) {
+            f.referenced = false;
+            continue;
+        }
+        victim = current;
+        return true;
+    }
+    return false;
+}
+
+void BufferManager::writeBack(std::unique_lock<std::mutex>& lock, const std::vector<size_t>& batch) {
+    std::vector<uint64_t> pages;
+    for (size_t frame : batch) {
+        frames[frame].busy = true;
+        pages.push_back(frames[frame].page);
+    }
+    lock.unlock();
+    size_t written = 0;
+    std::exception_ptr error;
+    try {
+        pager.protect(pages);
+        for (; written < batch.size(); ++written) pager.write(pages[written], frameData(batch[written]));
+    } catch (...) {
+        error = std::current_exception();
+    }
+    lock.lock();
+    for (size_t i = 0; i < batch.size(); ++i) {
+        Frame& f = frames[batch[i]];
+        f.busy = false;
+        if (i < written) {
+            f.dirty = false;
+            --dirtyFrames;
+            ++counters.writes;
+        }
+    }
+    changed.notify_all();
+    if (error) std::rethrow_exception(error);
+}
+
+std::vector<size_t> BufferManager::dirtyUnpinned(size_t limit) {
+    std::vector<size_t> batch;
+    for (size_t i = 0; i < frames.size() && batch.size() < limit; ++i) {
+        const Frame& f = frames[i];
+        if (f.dirty && f.pins == 0 && !f.busy) batch.push_back(i);
+    }
+    // in file order, for mostly sequential writes
+    std::sort(batch.begin(), batch.end(), [this](size_t a, size_t b) { return frames[a].page < frames[b].page; });
+    return batch;
+}
+
+void BufferManager::flush() {
+    std::unique_lock lock(mtx);
+    while (dirtyFrames > 0) {
+        auto batch = dirtyUnpinned(frames.size());
+        if (batch.empty()) changed.wait(lock);
+        else writeBack(lock, batch);
+    }
+}
+
+BufferManager::Stats BufferManager::stats() {
+    std::lock_guard lock(mtx);
+    Stats s = counters;
+    s.dirty = dirtyFrames;
+    s.pinned = static_cast<size_t>(std::count_if(frames.begin(), frames.end(), [](const Frame& f) { return f.pins > 0; }));
+    return s;
+}
+
+void BufferManager::markDirty(size_t frame) {
+    std::lock_guard lock(mtx);
+    Frame& f = frames[frame];
+    if (f.dirty) return;
+    f.dirty = true;
+    if (++dirtyFrames == frames.size() / 4) writeBackCv.notify_one();
+}
+
+void BufferManager::unpin(size_t frame) {
+    std::lock_guard lock(mtx);
+    if (--frames[frame].pins == 0) changed.notify_all();
+}
+
+void BufferManager::runWriteBack() {
+    std::unique_lock lock(mtx);
+    while (!stopping) {
+        writeBackCv.wait_for(lock, writeBackInterval,
+                             [this]() { return stopping || dirtyFrames >= frames.size() / 4; });
+        if (stopping) break;
+        auto batch = dirtyUnpinned(frames.size() / 4);
+        if (batch.empty()) {
+            // everything dirty is pinned; wait for it to be let go
+            changed.wait_for(lock, writeBackInterval);
+            continue;
+        }
+        try {
+            writeBack(lock, batch);
+        } catch (const std::exception& e) {
+            // the frames stay dirty; a later round or flush() retries them
+            LOG_ERROR("[BTree] Write-back failed: " << e.what());
+        }
+    }
+}
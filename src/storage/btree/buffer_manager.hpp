@@ -0,0 +1,120 @@
+#pragma once
+#include "pager.hpp"
+#include "../../config.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * a fixed number of page frames in front of a Pager; nothing else of the
+ * page file is held in memory.
+ *
+ * 1. fetch() pins a page, reading it on a miss; the PageRef unpins it when
+ *    it goes away. a pinned frame is never evicted or written, so whoever
+ *    holds the pin may change the page and markDirty() it
+ * 2. a miss takes a frame by clock sweep: the hand passes over pinned
+ *    frames and clears the referenced bit of recently used ones, and takes
+ *    the first unpinned frame without it. a dirty victim is written back
+ *    first. when every frame is pinned the miss waits for an unpin
+ * 3. a background thread writes dirty unpinned frames every
+ *    writeBackInterval, or as soon as a quarter of the frames are dirty,
+ *    so misses rarely have to write a victim themselves. each round
+ *    journals its pages with one sync
+ *
+ * frames come from one buffer aligned for O_DIRECT.
+ */
+class BufferManager {
+public:
+    static constexpr size_t MIN_FRAMES = 16;
+
+    class PageRef {
+    public:
+        PageRef() = default;
+        PageRef(PageRef&& other) noexcept { *this = std::move(other); }
+        PageRef& operator=(PageRef&& other) noexcept;
+        ~PageRef() { release(); }
+
+        uint64_t id() const { return page; }
+        char* data() const { return buf; }
+        void markDirty();
+        void release();
+
+    private:
+        friend class BufferManager;
+        PageRef(BufferManager* owner, size_t frame, uint64_t page, char* buf)
+            : owner(owner), frame(frame), page(page), buf(buf) {}
+
+        BufferManager* owner = nullptr;
+        size_t frame = 0;
+        uint64_t page = 0;
+        char* buf = nullptr;
+    };
+
+    struct Stats {
+        size_t frames = 0;
+        size_t dirty = 0;
+        size_t pinned = 0;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        uint64_t writes = 0; // pages written back, by misses, the background thread or flush()
+    };
+
+    // frames is raised to MIN_FRAMES
+    BufferManager(Pager& pager, size_t frames,
+                  std::chrono::milliseconds writeBackInterval = std::chrono::milliseconds(BTREE_WRITEBACK_INTERVAL_MS));
+    ~BufferManager();
+
+    BufferManager(const BufferManager&) = delete;
+    BufferManager& operator=(const BufferManager&) = delete;
+
+    PageRef fetch(uint64_t page);
+    // pins a page that is about to be overwritten in full, without reading it
+    PageRef create(uint64_t page);
+    // writes every dirty frame. frames pinned by others are waited for
+    void flush();
+    Stats stats();
+
+private:
+    static constexpr uint64_t NO_FRAME_PAGE = UINT64_MAX;
+
+    struct Frame {
+        uint64_t page = NO_FRAME_PAGE;
+        int pins = 0;
+        bool dirty = false;
+        bool referenced = false;
+        bool busy = false; // being read or written; cannot be pinned until done
+    };
+
+    Pager& pager;
+    size_t pageSize;
+    AlignedBuffer memory;
+
+    // guarded by mtx
+    std::mutex mtx;
+    std::condition_variable changed; // a frame was unpinned or finished I/O
+    std::vector<Frame> frames;
+    std::unordered_map<uint64_t, size_t> table; // page -> frame
+    size_t hand = 0;
+    size_t dirtyFrames = 0;
+    Stats counters;
+
+    std::chrono::milliseconds writeBackInterval;
+    std::condition_variable writeBackCv;
+    bool stopping = false;
+    std::thread writeBackThread;
+
+    char* frameData(size_t frame) const { return memory.data() + frame * pageSize; }
+    PageRef pin(uint64_t page, bool read);
+    bool findVictim(size_t& victim); // caller holds mtx
+    // writes the given dirty frames and marks them clean; caller holds lock
+    void writeBack(std::unique_lock<std::mutex>& lock, const std::vector<size_t>& batch);
+    std::vector<size_t> dirtyUnpinned(size_t limit); // caller holds mtx
+    void markDirty(size_t frame);
+    void unpin(size_t frame);
+    void runWriteBack();
+};
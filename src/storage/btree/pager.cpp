@@ -0,0 +1,228 @@
+#include "pager.hpp"
+#include "../../common/utils/crc32c.hpp"
+#include "../../common/utils/logger.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// journal: [8B pages at the last commit], then per page
+// [8B page][4B crc32c of the contents][contents]
+constexpr size_t JOURNAL_HEADER_BYTES = 8;
+constexpr size_t JOURNAL_RECORD_HEADER_BYTES = 12;
+
+void writeFully(int fd, const char* buf, size_t size, off_t offset, const std::filesystem::path& path) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = ::pwrite(fd, buf + done, size - done, offset + static_cast<off_t>(done));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) throw std::runtime_error("Failed to write " + path.string() + ": " + std::strerror(errno));
+        done += static_cast<size_t>(n);
+    }
+}
+
+// false at the end of the file
+bool readFully(int fd, char* buf, size_t size, off_t offset) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = ::pread(fd, buf + done, size - done, offset + static_cast<off_t>(done));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+} // namespace
+
+AlignedBuffer::AlignedBuffer(size_t size) {
+    size_t rounded = (size + DIRECT_IO_ALIGNMENT - 1) / DIRECT_IO_ALIGNMENT * DIRECT_IO_ALIGNMENT;
+    buf = static_cast<char*>(std::aligned_alloc(DIRECT_IO_ALIGNMENT, std::max(rounded, DIRECT_IO_ALIGNMENT)));
+    if (!buf) throw std::bad_alloc();
+    std::memset(buf, 0, rounded);
+}
+
+AlignedBuffer::~AlignedBuffer() { std::free(buf); }
+
+Pager::Pager(std::filesystem::path path, uint32_t pageSize, bool direct)
+    : path(std::move(path)), size(pageSize), directIO(direct), scratch(pageSize) {
+    journalPath = this->path.string() + "-journal";
+    if (directIO && size % DIRECT_IO_ALIGNMENT != 0) {
+        throw std::runtime_error("O_DIRECT needs a page size that is a multiple of " +
+                                 std::to_string(DIRECT_IO_ALIGNMENT));
+    }
+    if (this->path.has_parent_path()) std::filesystem::create_directories(this->path.parent_path());
+    open();
+    try {
+        rollback();
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+    committedPages = pages.load();
+}
+
+Pager::~Pager() {
+    if (journalFd >= 0) ::close(journalFd);
+    if (fd >= 0) ::close(fd);
+}
+
+void Pager::open() {
+    int flags = O_RDWR | O_CREAT | O_CLOEXEC;
+    if (directIO) {
+        fd = ::open(path.c_str(), flags | O_DIRECT, 0644);
+        if (fd < 0 && errno == EINVAL) {
+            LOG_WARN("[BTree] O_DIRECT is not supported for " << path.string() << ", using buffered I/O");
+            directIO = false;
+        }
+    }
+    if (!directIO) fd = ::open(path.c_str(), flags, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open " + path.string() + ": " + std::strerror(errno));
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Failed to stat " + path.string());
+    }
+    // a page cut short by a crash counts as never written
+    pages.store(static_cast<uint64_t>(st.st_size) / size);
+}
+
+void Pager::rollback() {
+    int jfd = ::open(journalPath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (jfd < 0) return;
+
+    // a record cut short or failing its checksum was never synced, so the
+    // page it stands for was not overwritten yet
+    char header[JOURNAL_RECORD_HEADER_BYTES];
+    uint64_t committed = 0;
+    size_t restored = 0;
+    bool complete = readFully(jfd, header, JOURNAL_HEADER_BYTES, 0);
+    if (complete) {
+        std::memcpy(&committed, header, sizeof(committed));
+        off_t offset = JOURNAL_HEADER_BYTES;
+        while (readFully(jfd, header, JOURNAL_RECORD_HEADER_BYTES, offset) &&
+               readFully(jfd, scratch.data(), size, offset + static_cast<off_t>(JOURNAL_RECORD_HEADER_BYTES))) {
+            uint64_t page;
+            uint32_t crc;
+            std::memcpy(&page, header, sizeof(page));
+            std::memcpy(&crc, header + 8, sizeof(crc));
+            if (crc32c::value(scratch.data(), size) != crc || page >= committed) break;
+            writeRaw(page, scratch.data());
+            ++restored;
+            offset += static_cast<off_t>(JOURNAL_RECORD_HEADER_BYTES + size);
+        }
+    }
+    ::close(jfd);
+
+    if (complete) {
+        if (::ftruncate(fd, static_cast<off_t>(committed * size)) != 0) {
+            throw std::runtime_error("Failed to truncate " + path.string() + ": " + std::strerror(errno));
+        }
+        pages.store(committed);
+    }
+    if (::fdatasync(fd) != 0) {
+        throw std::runtime_error("Failed to sync " + path.string() + ": " + std::strerror(errno));
+    }
+    std::filesystem::remove(journalPath);
+    syncDirectory();
+    LOG_INFO("[BTree] Rolled back " << restored << " pages of " << path.string() << " from its journal");
+}
+
+void Pager::read(uint64_t page, char* buf) const {
+    if (!readFully(fd, buf, size, static_cast<off_t>(page * size))) {
+        throw std::runtime_error("Failed to read page " + std::to_string(page) + " of " + path.string());
+    }
+    uint32_t crc;
+    std::memcpy(&crc, buf, sizeof(crc));
+    if (crc32c::value(buf + 4, size - 4) != crc) {
+        throw std::runtime_error("Checksum mismatch in page " + std::to_string(page) + " of " + path.string());
+    }
+}
+
+void Pager::write(uint64_t page, char* buf) {
+    {
+        std::lock_guard lock(journalMtx);
+        journal({page});
+    }
+    uint32_t crc = crc32c::value(buf + 4, size - 4);
+    std::memcpy(buf, &crc, sizeof(crc));
+    writeRaw(page, buf);
+}
+
+void Pager::protect(const std::vector<uint64_t>& pages) {
+    std::lock_guard lock(journalMtx);
+    journal(pages);
+}
+
+void Pager::journal(const std::vector<uint64_t>& pages) {
+    bool added = false;
+    for (uint64_t page : pages) {
+        // pages allocated since the commit are cut off by a rollback anyway
+        if (page >= committedPages || journaled.count(page)) continue;
+        if (journalFd < 0) {
+            // O_APPEND: every write lands at the end, whatever offset it names
+            journalFd = ::open(journalPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+            if (journalFd < 0) {
+                throw std::runtime_error("Failed to open " + journalPath.string() + ": " + std::strerror(errno));
+            }
+            writeFully(journalFd, reinterpret_cast<const char*>(&committedPages), JOURNAL_HEADER_BYTES, 0, journalPath);
+            syncDirectory();
+        }
+        readRaw(page, scratch.data());
+        char header[JOURNAL_RECORD_HEADER_BYTES];
+        uint32_t crc = crc32c::value(scratch.data(), size);
+        std::memcpy(header, &page, sizeof(page));
+        std::memcpy(header + 8, &crc, sizeof(crc));
+        writeFully(journalFd, header, sizeof(header), 0, journalPath);
+        writeFully(journalFd, scratch.data(), size, 0, journalPath);
+        journaled.insert(page);
+        added = true;
+    }
+    if (added && ::fdatasync(journalFd) != 0) {
+        throw std::runtime_error("Failed to sync " + journalPath.string() + ": " + std::strerror(errno));
+    }
+}
+
+void Pager::commit() {
+    std::lock_guard lock(journalMtx);
+    if (::fdatasync(fd) != 0) {
+        throw std::runtime_error("Failed to sync " + path.string() + ": " + std::strerror(errno));
+    }
+    if (journalFd >= 0) {
+        ::close(journalFd);
+        journalFd = -1;
+        std::filesystem::remove(journalPath);
+        syncDirectory();
+    }
+    journaled.clear();
+    committedPages = pages.load();
+}
+
+void Pager::readRaw(uint64_t page, char* buf) const {
+    if (!readFully(fd, buf, size, static_cast<off_t>(page * size))) {
+        throw std::runtime_error("Failed to read page " + std::to_string(page) + " of " + path.string());
+    }
+}
+
+void Pager::writeRaw(uint64_t page, const char* buf) {
+    writeFully(fd, buf, size, static_cast<off_t>(page * size), path);
+}
+
+void Pager::syncDirectory() const {
+    auto dir = path.parent_path().empty() ? std::filesystem::path(".") : path.parent_path();
+    int dirFd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd < 0) return;
+    ::fsync(dirFd);
+    ::close(dirFd);
+}
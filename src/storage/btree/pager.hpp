@@ -0,0 +1,92 @@
+#pragma once
+#include "../../config.hpp"
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+// O_DIRECT buffers, file offsets and transfer sizes are multiples of this
+constexpr const size_t DIRECT_IO_ALIGNMENT = 4096;
+
+// zeroed heap memory aligned for O_DIRECT
+class AlignedBuffer {
+public:
+    explicit AlignedBuffer(size_t size);
+    ~AlignedBuffer();
+
+    AlignedBuffer(const AlignedBuffer&) = delete;
+    AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+
+    char* data() const { return buf; }
+
+private:
+    char* buf = nullptr;
+};
+
+/**
+ * fixed-size page I/O on a single file. page n lives at n * pageSize.
+ *
+ * 1. write() stamps a crc32c over the page into its first 4 bytes and
+ *    read() checks it, so a torn or damaged page throws instead of being
+ *    misread
+ * 2. pages are read and written with pread/pwrite, so any number of
+ *    threads may do I/O at once. with direct set the file is opened with
+ *    O_DIRECT and bypasses the kernel page cache; buffers must then be
+ *    aligned to DIRECT_IO_ALIGNMENT. file systems without O_DIRECT fall
+ *    back to buffered I/O
+ * 3. allocate() only hands out the next page number; the file grows when
+ *    that page is first written
+ * 4. the file as of the last commit() can always be restored. before a
+ *    page that existed at the last commit is first overwritten, its old
+ *    contents go to a rollback journal (<path>-journal) that is synced
+ *    first. opening a file with a journal left by a crash copies those
+ *    pages back and cuts off pages allocated since
+ */
+class Pager {
+public:
+    explicit Pager(std::filesystem::path path, uint32_t pageSize = BTREE_PAGE_SIZE, bool direct = false);
+    ~Pager();
+
+    Pager(const Pager&) = delete;
+    Pager& operator=(const Pager&) = delete;
+
+    uint32_t pageSize() const { return size; }
+    uint64_t pageCount() const { return pages.load(); }
+    bool direct() const { return directIO; }
+
+    // throws if the page is past the end of the file or fails its checksum
+    void read(uint64_t page, char* buf) const;
+    // fills in the checksum in buf's first 4 bytes
+    void write(uint64_t page, char* buf);
+    // journals the pages about to be written with one sync, rather than one
+    // per write()
+    void protect(const std::vector<uint64_t>& pages);
+    uint64_t allocate() { return pages.fetch_add(1); }
+    // syncs the file and drops the journal; the current contents become the
+    // state a crash rolls back to
+    void commit();
+
+private:
+    std::filesystem::path path;
+    std::filesystem::path journalPath;
+    uint32_t size;
+    bool directIO;
+    int fd = -1;
+    std::atomic<uint64_t> pages{0};
+
+    // guarded by journalMtx
+    std::mutex journalMtx;
+    int journalFd = -1;
+    uint64_t committedPages = 0;          // pages in the file at the last commit
+    std::unordered_set<uint64_t> journaled; // pages whose old contents are in the journal
+    AlignedBuffer scratch;
+
+    void open();
+    void rollback();
+    void journal(const std::vector<uint64_t>& pages); // caller holds journalMtx
+    void readRaw(uint64_t page, char* buf) const;
+    void writeRaw(uint64_t page, const char* buf);
+    void syncDirectory() const;
+};
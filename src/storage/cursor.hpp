@@ -0,0 +1,45 @@
+#pragma once
+#include "snapshot.hpp"
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+/**
+ * bounds and direction of a range scan.
+ *
+ * start is inclusive and end is exclusive, so [start, end) pages cleanly:
+ * the next page starts at the last key returned plus a '\0'. pass the same
+ * snapshot to every page to page through one consistent state.
+ */
+struct ScanOptions {
+    std::optional<std::string> start;
+    std::optional<std::string> end;
+    bool reverse = false;
+    // read as of this snapshot; without one the cursor reads the state at its creation
+    std::shared_ptr<const Snapshot> snapshot;
+};
+
+/**
+ * streaming range scan over live entries (deleted keys are never returned).
+ *
+ * a new cursor is positioned on the first entry in its direction: the
+ * smallest key >= start going forward, the largest key < end in reverse.
+ * entries are produced lazily, so a scan costs O(rows read) rather than
+ * O(database).
+ *
+ * key() and value() views stay valid until the cursor is moved or destroyed.
+ */
+class Cursor {
+public:
+    virtual ~Cursor() = default;
+
+    virtual bool valid() const = 0;
+    // forward: first key >= target. reverse: last key <= target. clamped to the bounds.
+    virtual void seek(const std::string& target) = 0;
+    // one entry further in the scan direction
+    virtual void next() = 0;
+
+    virtual std::string_view key() const = 0;
+    virtual std::string_view value() const = 0;
+};
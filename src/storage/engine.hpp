@@ -1,12 +1,40 @@
 #pragma once
+#include "cursor.hpp"
+#include "snapshot.hpp"
+#include "write_batch.hpp"
+#include <stdexcept>
 #include <string>
 #include <optional>
+#include <vector>
+#include <memory>
 
 class StorageEngine {
 public:
     virtual ~StorageEngine() = default;
     virtual void put(const std::string& key, const std::string& value) = 0;
     virtual std::optional<std::string> get(const std::string& key) = 0;
-    virtual std::vector<std::pair<std::string, std::string>> getRange(int limit = -1) = 0;
     virtual void remove(const std::string& key) = 0;
-};
\ No newline at end of file
+    // applies every operation in the batch, or after a crash none of them
+    virtual void write(const WriteBatch& batch) = 0;
+    virtual std::unique_ptr<Cursor> newCursor(const ScanOptions& options = {}) = 0;
+
+    // pins the current state for get(key, snapshot) and ScanOptions::snapshot.
+    // throws for engines that can't keep old versions
+    virtual std::shared_ptr<const Snapshot> snapshot() {
+        throw std::runtime_error("Snapshots are not supported by this engine");
+    }
+    // the key's value as of snapshot, which must come from this engine
+    virtual std::optional<std::string> get(const std::string& /*key*/, const Snapshot& /*snapshot*/) {
+        throw std::runtime_error("Snapshots are not supported by this engine");
+    }
+
+    // the first `limit` entries in key order, or all of them when limit is -1
+    std::vector<std::pair<std::string, std::string>> getRange(int limit = -1) {
+        std::vector<std::pair<std::string, std::string>> result;
+        for (auto cursor = newCursor(); cursor->valid(); cursor->next()) {
+            if (limit != -1 && result.size() >= static_cast<size_t>(limit)) break;
+            result.emplace_back(cursor->key(), cursor->value());
+        }
+        return result;
+    }
+};
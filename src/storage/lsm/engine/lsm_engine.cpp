@@ -1,123 +1,447 @@
 #include "lsm_engine.hpp"
 #include "../../../config.hpp"
 #include "../../../common/utils/file_utils.hpp"
-#include <iostream>
+#include "../../../common/utils/stats.hpp"
+#include "../iterator/merging_iterator.hpp"
+#include "../sstable/compression.hpp"
+#include "../../../common/utils/logger.hpp"
+#include <algorithm>
 #include <string>
-#include <map>
+
+namespace {
+
+struct EngineStats {
+    Counter& stalls = StatsRegistry::process().counter("lsm.write_stalls");
+    ConcurrentHistogram& stallNanos = StatsRegistry::process().histogram("lsm.write_stall_nanos");
+};
+
+EngineStats& stats() {
+    static EngineStats s;
+    return s;
+}
+
+// pause before a failed flush or compaction is tried again
+constexpr auto RETRY_DELAY = std::chrono::seconds(1);
+
+} // namespace
 
 LSMEngine::LSMEngine(std::optional<std::filesystem::path> walPath,
-                        const size_t threshold,
-                        const int compactionInterval,
-                        std::string sstableDir) : 
+                        const size_t memtableBytes,
+                        std::string sstableDir,
+                        const size_t blockCacheBytes,
+                        std::shared_ptr<MemoryBudget> memoryBudget,
+                        std::shared_ptr<ThreadPool> pool) : 
+                    MEMTABLE_BYTES(memtableBytes),
+                    memoryBudget(std::move(memoryBudget)),
+                    pool(std::move(pool)),
                     wal(std::move(walPath)), 
-                    FLUSH_THRESHOLD(threshold),
-                    COMPACTION_INTERVAL_MS(compactionInterval) {
+                    memTable(std::make_shared<Memtable>(this->memoryBudget)),
+                    segmentManager(blockCacheBytes > 0 ? std::make_shared<BlockCache>(blockCacheBytes, this->memoryBudget) : nullptr) {
     segmentManager.loadSegments(sstableDir);
-    wal.replay([this](const WalRecord& rec) {
+    // sealed logs replay before the active one, so the last write for a key
+    // wins. they are numbered again in log order, above everything flushed
+    SequenceNumber sequence = segmentManager.lastSequence();
+    wal.replay([this, &sequence](const WalRecord& rec) {
         switch (rec.opType)
         {
         case OpType::CREATE:
-            if (!memTable.get(rec.key).has_value()) {
-                memTable.put(rec.key, rec.value);
-                std::cout << "[WAL Replay]: Insert " << rec.key << ": " << rec.value << std::endl;
-            }
-            break;
-        
         case OpType::UPDATE:
-            if (memTable.get(rec.key).has_value()) {
-                memTable.put(rec.key, rec.value);
-                std::cout << "[WAL Replay]: Update " << rec.key << ": " << rec.value << std::endl;
-            }
+            memTable->put(rec.key, rec.value, ++sequence);
+            LOG_DEBUG("[WAL Replay]: Put " << rec.key << ": " << rec.value);
             break;
         
         case OpType::DELETE:
-            memTable.remove(rec.key);
-            std::cout << "[WAL Replay]: Delete " << rec.key << std::endl;
+            memTable->remove(rec.key, ++sequence);
+            LOG_DEBUG("[WAL Replay]: Delete " << rec.key);
             break;
 
         default:
-            break;
+            return;
         }
     });
-    startCompactionThread();
+    visibleSequence.store(sequence);
+    wal.setLastSequence(sequence);
+    // segments left over budget by an earlier run
+    maybeScheduleCompaction();
+    registerStats();
 
-    std::cout << "LSMEngine created\n";
+    LOG_INFO("LSMEngine created");
 }
 
 LSMEngine::~LSMEngine() {
-    stopCompaction.store(true);
-    if (compactionThread.joinable()) compactionThread.join();
-    std::cout << "LSMEngine destroyed\n";
+    StatsRegistry::process().removeCallbacks(this);
+    {
+        std::unique_lock lock(mtx);
+        stopping.store(true);
+    }
+    flushCv.notify_all();
+    {
+        // a queued flush still writes out the immutable memtable first
+        std::unique_lock lock(mtx);
+        flushCv.wait(lock, [this]() { return !flushing; });
+    }
+    {
+        // a queued compaction sees stopping and returns right away
+        std::unique_lock lock(compactionMtx);
+        compactionCv.notify_all();
+        compactionCv.wait(lock, [this]() { return !compacting; });
+    }
+    LOG_INFO("LSMEngine destroyed");
 }
 
 void LSMEngine::put(const std::string& key, const std::string& value) {
-    std::cout << "Put: " << key << " -> " << value << "\n";
-    wal.append(WalRecord{OpType::CREATE, key, value});
-    memTable.put(key, value);
-    ++entryCount;
-    maybeFlush();
+    LOG_DEBUG("Put: " << key << " -> " << value);
+    apply(OpType::CREATE, key, value);
 }
 
 std::optional<std::string> LSMEngine::get(const std::string& key) {
-    std::cout << "Get: " << key << "\n";
-    if (auto val = memTable.get(key)) {
-        if (val.has_value() && isTombstone(*val)) {
-            return std::nullopt;
-        }
-        return val;
+    LOG_DEBUG("Get: " << key);
+    // writes still being published are skipped. segments only ever hold
+    // published writes, so they are read at their newest: a compaction that
+    // runs meanwhile can't drop that version
+    return read(key, visibleSequence.load(), MAX_SEQUENCE);
+}
+
+std::optional<std::string> LSMEngine::get(const std::string& key, const Snapshot& snapshot) {
+    LOG_DEBUG("Get: " << key << " at " << snapshot.sequence());
+    return read(key, snapshot.sequence(), snapshot.sequence());
+}
+
+std::shared_ptr<const Snapshot> LSMEngine::snapshot() {
+    return snapshots->acquire(visibleSequence);
+}
+
+std::optional<std::string> LSMEngine::read(const std::string& key, SequenceNumber memtableSnapshot,
+                                           SequenceNumber segmentSnapshot) {
+    std::shared_ptr<const Memtable> mem, imm;
+    {
+        // only the pointer copies are locked; the memtables are safe to read concurrently
+        std::shared_lock lock(mtx);
+        mem = memTable;
+        imm = immTable;
     }
-    if (auto val = segmentManager.get(key)) {
-        if (val.has_value() && isTombstone(*val)) {
-            return std::nullopt;
+    // holding the pointers keeps both readable even if they are swapped or flushed meanwhile
+    for (const auto& table : {mem, imm}) {
+        if (!table) continue;
+        if (auto val = table->get(key, memtableSnapshot)) {
+            if (isTombstone(*val)) return std::nullopt;
+            return val;
         }
+    }
+    if (auto val = segmentManager.get(key, segmentSnapshot)) {
+        if (isTombstone(*val)) return std::nullopt;
         return val;
     }
     return std::nullopt;
 }
 
-std::vector<std::pair<std::string, std::string>> LSMEngine::getRange(int limit) {
-    auto mem = memTable.getRange(limit);
-    auto seg = segmentManager.getRange(limit);
+namespace {
+
+// bounded, tombstone-free view of the merged memtables and segments
+class LSMCursor : public Cursor {
+public:
+    LSMCursor(std::vector<std::shared_ptr<const Memtable>> memtables,
+              std::unique_ptr<KVIterator> merged, ScanOptions options)
+        : memtables(std::move(memtables)), it(std::move(merged)), options(std::move(options)) {
+        if (!this->options.reverse) {
+            if (this->options.start) it->seek(*this->options.start);
+            else it->seekToFirst();
+        } else if (this->options.end) {
+            seekBefore(*this->options.end);
+        } else {
+            it->seekToLast();
+        }
+        skipDeleted();
+    }
+
+    bool valid() const override {
+        if (!it->valid()) return false;
+        if (!options.reverse) return !options.end || it->key() < *options.end;
+        return !options.start || it->key() >= *options.start;
+    }
+
+    void seek(const std::string& target) override {
+        if (!options.reverse) {
+            it->seek(options.start && target < *options.start ? *options.start : target);
+        } else if (options.end && target >= *options.end) {
+            seekBefore(*options.end);
+        } else {
+            it->seekForPrev(target);
+        }
+        skipDeleted();
+    }
+
+    void next() override {
+        step();
+        skipDeleted();
+    }
+
+    std::string_view key() const override { return it->key(); }
+    std::string_view value() const override { return it->value(); }
+
+private:
+    std::vector<std::shared_ptr<const Memtable>> memtables; // keeps the memtable iterators' tables alive
+    std::unique_ptr<KVIterator> it;
+    ScanOptions options; // its snapshot keeps compaction from dropping what the scan reads
+
+    // last entry strictly before key
+    void seekBefore(const std::string& key) {
+        it->seekForPrev(key);
+        if (it->valid() && it->key() == key) it->prev();
+    }
 
-    // merge: latest entry wins (memtable should override segment)
-    std::map<std::string, std::string> merged;
-    for (const auto& [k, v] : seg) merged[k] = v;
-    for (const auto& [k, v] : mem) merged[k] = v;
+    void step() {
+        if (options.reverse) it->prev();
+        else it->next();
+    }
 
-    std::vector<std::pair<std::string, std::string>> result;
-    for (const auto& [k, v] : merged) {
-        if (isTombstone(v)) continue;
-        if (limit != -1 && result.size() >= static_cast<size_t>(limit)) break;
-        result.emplace_back(k, v);
+    void skipDeleted() {
+        while (valid() && isTombstone(it->value())) step();
     }
+};
+
+} // namespace
 
-    return result;
+std::unique_ptr<Cursor> LSMEngine::newCursor(const ScanOptions& options) {
+    // without a snapshot the cursor takes its own, so however long the scan
+    // runs it sees the state at its start
+    ScanOptions scan = options;
+    if (!scan.snapshot) scan.snapshot = snapshot();
+    SequenceNumber sequence = scan.snapshot->sequence();
+
+    // memtable is the newest source, then the immutable memtable, then
+    // segments newest to oldest. the memtables are captured before the
+    // segments, so a flush finishing in between only produces duplicates,
+    // which the merge drops.
+    std::vector<std::shared_ptr<const Memtable>> memtables;
+    {
+        std::shared_lock lock(mtx);
+        memtables.push_back(memTable);
+        if (immTable) memtables.push_back(immTable);
+    }
+    std::vector<std::unique_ptr<KVIterator>> children;
+    for (const auto& table : memtables) children.push_back(table->newIterator(sequence));
+    segmentManager.addIterators(children, sequence);
+
+    return std::make_unique<LSMCursor>(std::move(memtables),
+        std::make_unique<MergingIterator>(std::move(children)), std::move(scan));
 }
 
 void LSMEngine::remove(const std::string& key) {
-    std::cout << "Remove: " << key << "\n";
-    wal.append(WalRecord{OpType::DELETE, key, ""});
-    memTable.remove(key);
-    ++entryCount;
+    LOG_DEBUG("Remove: " << key);
+    apply(OpType::DELETE, key, "");
+}
+
+void LSMEngine::write(const WriteBatch& batch) {
+    if (batch.empty()) return;
+    LOG_DEBUG("Write batch: " << batch.size() << " ops");
+    {
+        // one WAL record for the whole batch; the memtable swap can't split it
+        // because that needs mtx exclusively. its ops are numbered in order
+        // and published together, so readers see all of the batch or none of it
+        std::shared_lock lock(mtx);
+        SequenceNumber sequence = 0;
+        try {
+            wal.append(WalRecord{OpType::BATCH, "", batch.encode()}, batch.size(), sequence);
+            SequenceNumber next = sequence;
+            for (const auto& op : batch.ops()) {
+                if (op.type == OpType::DELETE) memTable->remove(op.key, next++);
+                else memTable->put(op.key, op.value, next++);
+            }
+        } catch (...) {
+            publish(sequence, batch.size());
+            throw;
+        }
+        publish(sequence, batch.size());
+    }
     maybeFlush();
 }
 
-void LSMEngine::maybeFlush() {
-    auto data = memTable.getRange();
-    if (data.empty()) return;
-    if (entryCount >= FLUSH_THRESHOLD) {
-        segmentManager.flush(data);
-        entryCount = 0;
-        wal.clear();
-        memTable.clear();
+void LSMEngine::apply(OpType op, const std::string& key, const std::string& value) {
+    {
+        std::shared_lock lock(mtx);
+        SequenceNumber sequence = 0;
+        try {
+            // concurrent writers meet in the WAL's group commit, which numbers them
+            wal.append(WalRecord{op, key, value}, 1, sequence);
+            if (op == OpType::DELETE) memTable->remove(key, sequence);
+            else memTable->put(key, value, sequence);
+        } catch (...) {
+            // a failed write still gives up its number, or later ones would wait forever
+            publish(sequence, 1);
+            throw;
+        }
+        publish(sequence, 1);
     }
+    maybeFlush();
 }
 
-void LSMEngine::startCompactionThread() {
-    compactionThread = std::thread([this]() {
-        while (!stopCompaction.load()) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(COMPACTION_INTERVAL_MS));
-            segmentManager.compact();
+void LSMEngine::publish(SequenceNumber first, uint64_t count) {
+    if (first == 0) return; // failed before the WAL numbered it
+    // inserts finish in any order, but become visible in log order. the
+    // writers before this one hold mtx shared too, so a memtable swap waits
+    // until everything in the old memtable is visible
+    std::unique_lock lock(publishMtx);
+    publishCv.wait(lock, [&]() { return visibleSequence.load() == first - 1; });
+    visibleSequence.store(first + count - 1);
+    publishCv.notify_all();
+}
+
+bool LSMEngine::memtableFull() const {
+    // both checks are single atomic loads, so this is cheap enough for every write
+    size_t bytes = memTable->dataSize();
+    if (bytes >= MEMTABLE_BYTES) return true;
+    // the shared budget is over: give memory back by flushing early, unless
+    // there is next to nothing to flush
+    return memoryBudget && memoryBudget->exceeded() &&
+           bytes >= std::min(MEMTABLE_BYTES, memoryBudget->limit()) / 16;
+}
+
+void LSMEngine::maybeFlush() {
+    {
+        std::shared_lock lock(mtx);
+        if (!memtableFull() && !flushRetryDue()) return;
+    }
+
+    std::unique_lock lock(mtx);
+    if (flushRetryDue()) scheduleFlush();
+    if (!memtableFull()) return; // another writer swapped it already
+
+    // the previous memtable is still being flushed: writers stall until it's
+    // on disk, otherwise memory would grow without bound. a stalled writer
+    // runs queued flushes itself, so a pool busy with writers can't deadlock.
+    std::optional<ScopedTimer> stall;
+    if (immTable && !stopping.load()) {
+        stats().stalls.add();
+        stall.emplace(stats().stallNanos);
+    }
+    while (immTable && !stopping.load()) {
+        if (!flushing) {
+            // the last flush failed: wait out its pause here, on the writer
+            // that needs the room, then try again
+            if (!flushRetryDue()) {
+                flushCv.wait_until(lock, flushRetryAt, [this]() { return stopping.load(); });
+                continue;
+            }
+            scheduleFlush();
         }
+        lock.unlock();
+        bool ran = pool->runPendingTask(ThreadPool::Priority::HIGH);
+        lock.lock();
+        // nothing queued: the flush is running elsewhere and signals when done
+        if (!ran) flushCv.wait(lock, [this]() { return !immTable || !flushing || stopping.load(); });
+    }
+    if (stopping.load() || !memtableFull()) return;
+
+    // swap in an empty memtable and seal the WAL that covers the full one;
+    // writes continue into the new memtable and log right away
+    immLogNumber = wal.rotate();
+    immTable = std::move(memTable);
+    memTable = std::make_shared<Memtable>(memoryBudget);
+    scheduleFlush();
+    flushCv.notify_all();
+}
+
+bool LSMEngine::flushRetryDue() const {
+    return immTable && !flushing && std::chrono::steady_clock::now() >= flushRetryAt;
+}
+
+void LSMEngine::scheduleFlush() {
+    flushing = true;
+    pool->submit(ThreadPool::Priority::HIGH, [this]() { flushImmutable(); });
+}
+
+void LSMEngine::flushImmutable() {
+    std::unique_lock lock(mtx);
+    auto imm = immTable;
+    uint64_t logNumber = immLogNumber;
+    lock.unlock();
+
+    bool flushed = false;
+    try {
+        auto it = imm->newIterator();
+        segmentManager.flush(*it, snapshots->sequences(visibleSequence));
+        wal.removeSealed(logNumber);
+        flushed = true;
+    } catch (const std::exception& e) {
+        LOG_ERROR("[Flush] " << e.what());
+    }
+
+    if (flushed) maybeScheduleCompaction();
+
+    lock.lock();
+    if (flushed) immTable.reset();
+    // otherwise keep the immutable memtable and its log; the next write
+    // after the pause retries, and the worker goes back to the pool
+    else flushRetryAt = std::chrono::steady_clock::now() + RETRY_DELAY;
+    // the destructor may go ahead once flushing is false, so this is the last use of the engine
+    flushing = false;
+    flushCv.notify_all();
+}
+
+void LSMEngine::registerStats() {
+    auto& registry = StatsRegistry::process();
+    registry.callback("lsm.memtable_bytes", this, [this]() {
+        std::shared_lock lock(mtx);
+        return static_cast<uint64_t>(memTable->dataSize());
+    });
+    registry.callback("lsm.immutable_memtable_bytes", this, [this]() {
+        std::shared_lock lock(mtx);
+        return static_cast<uint64_t>(immTable ? immTable->dataSize() : 0);
+    });
+    registry.callback("lsm.snapshots", this, [this]() { return static_cast<uint64_t>(snapshots->size()); });
+    registry.callback("lsm.segments", this, [this]() {
+        uint64_t total = 0;
+        for (size_t count : segmentManager.levelFileCounts()) total += count;
+        return total;
+    });
+    for (int level = 0; level < LSM_NUM_LEVELS; ++level) {
+        registry.callback("lsm.level" + std::to_string(level) + ".segments", this, [this, level]() {
+            return static_cast<uint64_t>(segmentManager.levelFileCounts()[static_cast<size_t>(level)]);
+        });
+    }
+    registry.callback("lsm.block_cache.hits", this, [this]() { return blockCacheStats().hits; });
+    registry.callback("lsm.block_cache.misses", this, [this]() { return blockCacheStats().misses; });
+    registry.callback("lsm.block_cache.usage_bytes", this, [this]() {
+        return static_cast<uint64_t>(blockCacheStats().usage);
     });
+    registry.callback("lsm.memory_budget.usage_bytes", this, [this]() {
+        return static_cast<uint64_t>(memoryBudget ? memoryBudget->usage() : 0);
+    });
+    compression::registerStats();
+}
+
+BlockCache::Stats LSMEngine::blockCacheStats() const {
+    if (auto& cache = segmentManager.cache()) return cache->stats();
+    return {};
+}
+
+void LSMEngine::maybeScheduleCompaction() {
+    // one compaction at a time, each its own task, so queued flushes get a
+    // worker between two compactions
+    std::lock_guard lock(compactionMtx);
+    scheduleCompaction();
+}
+
+void LSMEngine::scheduleCompaction() {
+    if (compacting || stopping.load() || std::chrono::steady_clock::now() < compactionRetryAt) return;
+    if (!segmentManager.needsCompaction()) return;
+    compacting = true;
+    pool->submit(ThreadPool::Priority::LOW, [this]() { compactOnce(); });
+}
+
+void LSMEngine::compactOnce() {
+    bool compacted = !stopping.load() && segmentManager.compact(snapshots->sequences(visibleSequence));
+    {
+        std::unique_lock lock(compactionMtx);
+        if (!compacted && !stopping.load()) {
+            // the compaction failed; back off instead of retrying in a tight
+            // loop. the first flush after the pause schedules the next one
+            compactionRetryAt = std::chrono::steady_clock::now() + RETRY_DELAY;
+        }
+        compacting = false;
+        // again until every level is back under budget
+        scheduleCompaction();
+        compactionCv.notify_all();
+    }
 }
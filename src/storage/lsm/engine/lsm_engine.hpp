@@ -4,35 +4,93 @@
 #include "../memtable/memtable.hpp"
 #include "../sstable/segment_manager.hpp"
 #include "../../../config.hpp"
-#include <thread>
+#include "../../../common/utils/memory_budget.hpp"
+#include "../../../common/utils/thread_pool.hpp"
 #include <atomic>
 #include <chrono>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <condition_variable>
 
 class LSMEngine : public StorageEngine {
 public:
     LSMEngine(std::optional<std::filesystem::path> walPath = std::nullopt, 
-                const size_t threshold = LSM_FLUSH_THRESHOLD,
-                const int compactionInterval = LSM_COMPACTION_INTERVAL_MS,
-                const std::string ssTableDir = SSTABLE_DIR);
+                const size_t memtableBytes = LSM_MEMTABLE_BYTES,
+                const std::string ssTableDir = SSTABLE_DIR,
+                const size_t blockCacheBytes = LSM_BLOCK_CACHE_BYTES,
+                std::shared_ptr<MemoryBudget> memoryBudget = MemoryBudget::process(),
+                std::shared_ptr<ThreadPool> pool = ThreadPool::process());
     ~LSMEngine();
 
     void put(const std::string& key, const std::string& value) override;
     std::optional<std::string> get(const std::string& key) override;
-    std::vector<std::pair<std::string, std::string>> getRange(int limit = -1) override;
+    std::optional<std::string> get(const std::string& key, const Snapshot& snapshot) override;
+    std::unique_ptr<Cursor> newCursor(const ScanOptions& options = {}) override;
     void remove(const std::string& key) override;
-    void startCompactionThread();
+    void write(const WriteBatch& batch) override;
+    std::shared_ptr<const Snapshot> snapshot() override;
+    size_t liveSnapshots() const { return snapshots->size(); }
+    BlockCache::Stats blockCacheStats() const;
 
 private:
-    size_t FLUSH_THRESHOLD;
-    size_t entryCount = 0;
-    int COMPACTION_INTERVAL_MS;
+    size_t MEMTABLE_BYTES;
+    std::shared_ptr<MemoryBudget> memoryBudget; // charged by the memtables and the block cache
+    std::shared_ptr<ThreadPool> pool;           // runs flushes (HIGH) and compactions (LOW)
 
     WAL wal;
-    Memtable memTable;
-    SegmentManager segmentManager;
-    std::thread compactionThread;
-    std::atomic<bool> stopCompaction{false};
+    // writes go to memTable. once it is full it becomes immTable, a read-only
+    // memtable that a flush task writes to L0 while reads still see it.
+    std::shared_ptr<Memtable> memTable;
+    std::shared_ptr<const Memtable> immTable;
+    uint64_t immLogNumber = 0; // sealed WAL holding immTable's records
+    // writers hold it shared around WAL append + memtable insert, so they can
+    // group-commit together. swapping memtables (and rotating the WAL) takes
+    // it exclusively, so every record lands in the log of its own memtable.
+    std::shared_mutex mtx;
+    std::condition_variable_any flushCv; // signalled when immTable is set or cleared, and when flushing ends
+    bool flushing = false;               // a flush task is queued or running; guarded by mtx
+    // a failed flush keeps immTable and is retried by the first write after
+    // this, so no pool worker sleeps through the pause; guarded by mtx
+    std::chrono::steady_clock::time_point flushRetryAt;
+
+    /**
+     * every write is numbered by the WAL in log order, so a later write to a
+     * key always has the higher sequence number, after a restart too.
+     *
+     * 1. writers insert with their numbers, then publish them in order:
+     *    visibleSequence moves past a write only once it and every write
+     *    before it are in the memtable, so a batch shows up all at once
+     * 2. reads see what is visible when they start, or their snapshot's state
+     * 3. flush and compaction keep the versions the live snapshots can read
+     */
+    std::atomic<SequenceNumber> visibleSequence{0};
+    std::mutex publishMtx;
+    std::condition_variable publishCv; // signalled when visibleSequence moves
+    std::shared_ptr<SnapshotList> snapshots = std::make_shared<SnapshotList>();
 
+    SegmentManager segmentManager;
+    std::atomic<bool> stopping{false};
+    std::mutex compactionMtx;
+    std::condition_variable compactionCv; // signalled when compacting ends, and on shutdown
+    bool compacting = false;              // a compaction task is queued or running; guarded by compactionMtx
+    // after a failed compaction none is scheduled before this; guarded by compactionMtx
+    std::chrono::steady_clock::time_point compactionRetryAt;
 
+    void apply(OpType op, const std::string& key, const std::string& value);
+    // makes count writes from first on visible, after every earlier one
+    void publish(SequenceNumber first, uint64_t count);
+    std::optional<std::string> read(const std::string& key, SequenceNumber memtableSnapshot,
+                                    SequenceNumber segmentSnapshot);
+    bool memtableFull() const; // caller holds mtx
     void maybeFlush();
-};
\ No newline at end of file
+    bool flushRetryDue() const; // caller holds mtx
+    void scheduleFlush();       // caller holds mtx exclusively
+    void flushImmutable();
+    void maybeScheduleCompaction();
+    void scheduleCompaction(); // caller holds compactionMtx
+    void compactOnce();
+    // reports memtable, segment and cache figures to StatsRegistry::process()
+    void registerStats();
+};
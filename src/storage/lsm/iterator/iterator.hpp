@@ -0,0 +1,44 @@
+#pragma once
+#include "../../snapshot.hpp"
+#include <string>
+#include <string_view>
+#include <vector>
+
+// one value of a key and the write that produced it
+struct ValueVersion {
+    SequenceNumber sequence = 0;
+    std::string_view value;
+};
+
+/**
+ * bidirectional cursor over sorted key-value entries. implemented by the
+ * memtable, by segments, and by MergingIterator which combines them.
+ *
+ * each key is returned once, with its newest value visible at the snapshot
+ * the iterator was opened at; keys with no such value are skipped.
+ *
+ * key() and value() views stay valid until the iterator is moved or destroyed.
+ */
+class KVIterator {
+public:
+    virtual ~KVIterator() = default;
+
+    virtual bool valid() const = 0;
+    virtual void seekToFirst() = 0;
+    // position at the first entry with key >= target
+    virtual void seek(const std::string& target) = 0;
+    virtual void next() = 0;
+
+    virtual void seekToLast() = 0;
+    // position at the last entry with key <= target
+    virtual void seekForPrev(const std::string& target) = 0;
+    virtual void prev() = 0;
+
+    virtual std::string_view key() const = 0;
+    virtual std::string_view value() const = 0;
+    // the sequence number value() was written with
+    virtual SequenceNumber sequence() const = 0;
+    // appends every version of key() this iterator holds, newest first,
+    // including those newer than its snapshot. for flush and compaction
+    virtual void versions(std::vector<ValueVersion>& out) const = 0;
+};
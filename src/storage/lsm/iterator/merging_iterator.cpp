@@ -0,0 +1,105 @@
+#include "merging_iterator.hpp"
+#include <algorithm>
+
+MergingIterator::MergingIterator(std::vector<std::unique_ptr<KVIterator>> children)
+    : children(std::move(children)) {
+    heap.reserve(this->children.size());
+    rebuildHeap(true);
+}
+
+bool MergingIterator::after(size_t a, size_t b) const {
+    int cmp = children[a]->key().compare(children[b]->key());
+    if (cmp != 0) return forward ? cmp > 0 : cmp < 0;
+    return a > b; // same key: newer (lower index) child wins in both directions
+}
+
+void MergingIterator::rebuildHeap(bool forward) {
+    this->forward = forward;
+    heap.clear();
+    for (size_t i = 0; i < children.size(); ++i) {
+        if (children[i]->valid()) heap.push_back(i);
+    }
+    std::make_heap(heap.begin(), heap.end(), [this](size_t a, size_t b) { return after(a, b); });
+}
+
+void MergingIterator::seekToFirst() {
+    for (auto& child : children) child->seekToFirst();
+    rebuildHeap(true);
+}
+
+void MergingIterator::seek(const std::string& target) {
+    for (auto& child : children) child->seek(target);
+    rebuildHeap(true);
+}
+
+void MergingIterator::seekToLast() {
+    for (auto& child : children) child->seekToLast();
+    rebuildHeap(false);
+}
+
+void MergingIterator::seekForPrev(const std::string& target) {
+    for (auto& child : children) child->seekForPrev(target);
+    rebuildHeap(false);
+}
+
+void MergingIterator::next() {
+    const std::string current(key());
+    if (!forward) {
+        // every child is at or before current: move them all past it
+        for (auto& child : children) {
+            child->seek(current);
+            if (child->valid() && child->key() == current) child->next();
+        }
+        rebuildHeap(true);
+        return;
+    }
+
+    auto cmp = [this](size_t a, size_t b) { return after(a, b); };
+    // advance every child positioned on the current key, which also drops
+    // the older versions shadowed by the entry just returned
+    while (!heap.empty() && children[heap.front()]->key() == current) {
+        std::pop_heap(heap.begin(), heap.end(), cmp);
+        size_t child = heap.back();
+        heap.pop_back();
+
+        children[child]->next();
+        if (children[child]->valid()) {
+            heap.push_back(child);
+            std::push_heap(heap.begin(), heap.end(), cmp);
+        }
+    }
+}
+
+void MergingIterator::prev() {
+    const std::string current(key());
+    if (forward) {
+        // every child is at or after current: move them all before it
+        for (auto& child : children) {
+            child->seekForPrev(current);
+            if (child->valid() && child->key() == current) child->prev();
+        }
+        rebuildHeap(false);
+        return;
+    }
+
+    auto cmp = [this](size_t a, size_t b) { return after(a, b); };
+    while (!heap.empty() && children[heap.front()]->key() == current) {
+        std::pop_heap(heap.begin(), heap.end(), cmp);
+        size_t child = heap.back();
+        heap.pop_back();
+
+        children[child]->prev();
+        if (children[child]->valid()) {
+            heap.push_back(child);
+            std::push_heap(heap.begin(), heap.end(), cmp);
+        }
+    }
+}
+
+void MergingIterator::versions(std::vector<ValueVersion>& out) const {
+    // a newer child only holds newer versions of a key than an older one
+    std::string_view current = key();
+    for (const auto& child : children) {
+        if (child->valid() && child->key() == current) child->versions(out);
+    }
+}
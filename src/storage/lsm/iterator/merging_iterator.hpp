@@ -0,0 +1,45 @@
+#pragma once
+#include "iterator.hpp"
+#include <memory>
+#include <vector>
+
+/**
+ * k-way merge over sorted child iterators using a heap, so memory is
+ * O(number of children) regardless of how many entries they hold.
+ *
+ * children are ordered newest first: when several children hold the same
+ * key, only the entry from the lowest-indexed child is returned and the
+ * older duplicates are skipped. versions() gathers the key's versions from
+ * all of them, still newest first. tombstones are returned like any other
+ * value; callers decide whether to hide or keep them.
+ *
+ * going forward the heap is a min-heap over the children's keys; going
+ * backward it is a max-heap. changing direction repositions every child
+ * on the other side of the current key.
+ */
+class MergingIterator : public KVIterator {
+public:
+    explicit MergingIterator(std::vector<std::unique_ptr<KVIterator>> children);
+
+    bool valid() const override { return !heap.empty(); }
+    void seekToFirst() override;
+    void seek(const std::string& target) override;
+    void next() override;
+    void seekToLast() override;
+    void seekForPrev(const std::string& target) override;
+    void prev() override;
+
+    std::string_view key() const override { return children[heap.front()]->key(); }
+    std::string_view value() const override { return children[heap.front()]->value(); }
+    SequenceNumber sequence() const override { return children[heap.front()]->sequence(); }
+    void versions(std::vector<ValueVersion>& out) const override;
+
+private:
+    std::vector<std::unique_ptr<KVIterator>> children;
+    std::vector<size_t> heap; // indices of valid children, next entry in `direction` on top
+    bool forward = true;
+
+    // true if child a's entry comes after child b's in the current direction
+    bool after(size_t a, size_t b) const;
+    void rebuildHeap(bool forward);
+};
@@ -2,30 +2,81 @@
 #include "../../../config.hpp"
 #include "../../../common/utils/file_utils.hpp"
 
-void Memtable::put(const std::string& key, const std::string& value) {
-    kv.insert(key, value);
+Memtable::Memtable(std::shared_ptr<MemoryBudget> budget) : kv(std::move(budget)) {}
+
+void Memtable::put(const std::string& key, const std::string& value, SequenceNumber sequence) {
+    kv.insert(key, value, sequence);
 }
 
-void Memtable::remove(const std::string& key) {
-    kv.insert(key, TOMBSTONE_MARKER);
+void Memtable::remove(const std::string& key, SequenceNumber sequence) {
+    kv.insert(key, TOMBSTONE_MARKER, sequence);
 }
 
-std::optional<std::string> Memtable::get(const std::string& key) const {
-    return kv.get(key);
+std::optional<std::string> Memtable::get(const std::string& key, SequenceNumber snapshot) const {
+    if (auto value = kv.get(key, snapshot)) return std::string(*value);
+    return std::nullopt;
 }
 
 std::vector<std::pair<std::string, std::string>> Memtable::getRange(int limit) const {
     std::vector<std::pair<std::string, std::string>> result;
-    for (const auto& [key, loc] : kv.entries()) {
+    ArenaSkipList::Iterator it(kv);
+    for (it.seekToFirst(); it.valid(); it.next()) {
         if (limit != -1 && result.size() >= static_cast<size_t>(limit)) break;
-
-        if (auto val = get(key)) {
-            result.emplace_back(key, *val);
-        }
+        result.emplace_back(it.key(), it.value());
     }
     return result;
 }
 
+namespace {
+
+class MemtableIterator : public KVIterator {
+public:
+    MemtableIterator(const ArenaSkipList& kv, SequenceNumber snapshot) : it(kv), snapshot(snapshot) {}
+
+    bool valid() const override { return it.valid(); }
+    void seekToFirst() override { it.seekToFirst(); skipForward(); }
+    void seek(const std::string& target) override { it.seek(target); skipForward(); }
+    void next() override { it.next(); skipForward(); }
+    void seekToLast() override { it.seekToLast(); skipBackward(); }
+    void seekForPrev(const std::string& target) override { it.seekForPrev(target); skipBackward(); }
+    void prev() override { it.prev(); skipBackward(); }
+    std::string_view key() const override { return it.key(); }
+    std::string_view value() const override { return version->value(); }
+    SequenceNumber sequence() const override { return version->sequence; }
+
+    void versions(std::vector<ValueVersion>& out) const override {
+        for (auto* v = it.version(); v; v = v->older()) out.push_back({v->sequence, v->value()});
+    }
+
+private:
+    ArenaSkipList::Iterator it;
+    SequenceNumber snapshot;
+    const ArenaSkipList::Version* version = nullptr; // the entry's value at snapshot
+
+    // keys written only after the snapshot are passed over
+    void skipForward() {
+        while (it.valid() && !(version = it.version(snapshot))) it.next();
+    }
+
+    void skipBackward() {
+        while (it.valid() && !(version = it.version(snapshot))) it.prev();
+    }
+};
+
+} // namespace
+
+std::unique_ptr<KVIterator> Memtable::newIterator(SequenceNumber snapshot) const {
+    return std::make_unique<MemtableIterator>(kv, snapshot);
+}
+
+size_t Memtable::memoryUsage() const {
+    return kv.memoryUsage();
+}
+
+size_t Memtable::dataSize() const {
+    return kv.dataSize();
+}
+
 void Memtable::clear() {
     kv.clear();
 }
\ No newline at end of file
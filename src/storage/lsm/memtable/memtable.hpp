@@ -1,16 +1,33 @@
 #pragma once
 #include <string>
 #include <optional>
-#include "../../../common/containers/skiplist.hpp"
+#include "../../../common/containers/arena_skiplist.hpp"
+#include "../iterator/iterator.hpp"
+#include <memory>
+#include <vector>
 
+// put, remove, get and iterators are safe to use from many threads at once
 class Memtable {
 public:
-    void put(const std::string& key, const std::string& value);
-    void remove(const std::string& key);
-    std::optional<std::string> get(const std::string& key) const;
+    // the arena's blocks are charged to budget while the memtable lives
+    explicit Memtable(std::shared_ptr<MemoryBudget> budget = nullptr);
+
+    // every write adds a version; the one with the highest sequence wins,
+    // or the later one between equal sequences
+    void put(const std::string& key, const std::string& value, SequenceNumber sequence = 0);
+    void remove(const std::string& key, SequenceNumber sequence = 0);
+    // newest value with sequence <= snapshot, tombstones included
+    std::optional<std::string> get(const std::string& key, SequenceNumber snapshot = MAX_SEQUENCE) const;
     std::vector<std::pair<std::string, std::string>> getRange(int limit = -1) const;
+    // entries visible at snapshot in key order, tombstones included
+    std::unique_ptr<KVIterator> newIterator(SequenceNumber snapshot = MAX_SEQUENCE) const;
+    // exact bytes reserved from the heap for keys, values and skiplist nodes
+    size_t memoryUsage() const;
+    // bytes taken by the entries themselves, grows with every put; O(1)
+    size_t dataSize() const;
+    // invalidates outstanding iterators; must not run concurrently with anything else
     void clear();
 
 private:
-    SkipList<std::string, std::string> kv;
+    ArenaSkipList kv;
 };
\ No newline at end of file
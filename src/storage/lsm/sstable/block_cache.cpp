@@ -0,0 +1,72 @@
+#include "block_cache.hpp"
+
+BlockCache::BlockCache(size_t capacityBytes, std::shared_ptr<MemoryBudget> budget)
+    : capacityBytes(capacityBytes), shardCapacity(capacityBytes / NUM_SHARDS), budget(std::move(budget)) {}
+
+BlockCache::~BlockCache() {
+    if (!budget) return;
+    for (auto& shard : shards) budget->release(shard.usage);
+}
+
+BlockCache::Block BlockCache::lookup(uint64_t segmentId, uint64_t offset) {
+    Key key{segmentId, offset};
+    Shard& shard = shardFor(key);
+
+    std::lock_guard lock(shard.mtx);
+    auto it = shard.map.find(key);
+    if (it == shard.map.end()) {
+        misses.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    // move to front
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    hits.fetch_add(1, std::memory_order_relaxed);
+    return it->second->second;
+}
+
+void BlockCache::insert(uint64_t segmentId, uint64_t offset, Block block) {
+    size_t bytes = charge(block);
+    if (bytes > shardCapacity) return; // would evict the whole shard
+
+    Key key{segmentId, offset};
+    Shard& shard = shardFor(key);
+
+    std::lock_guard lock(shard.mtx);
+    if (auto it = shard.map.find(key); it != shard.map.end()) {
+        // another reader filled it first
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        return;
+    }
+
+    shard.lru.emplace_front(key, std::move(block));
+    shard.map[key] = shard.lru.begin();
+    shard.usage += bytes;
+    if (budget) budget->reserve(bytes);
+
+    // evict least recently used until back under this cache's capacity and,
+    // short of dropping the block just added, under the shared budget
+    while (!shard.lru.empty() &&
+           (shard.usage > shardCapacity || (budget && budget->exceeded() && shard.lru.size() > 1))) {
+        auto& [oldKey, oldBlock] = shard.lru.back();
+        size_t oldBytes = charge(oldBlock);
+        shard.usage -= oldBytes;
+        if (budget) budget->release(oldBytes);
+        shard.map.erase(oldKey);
+        shard.lru.pop_back();
+        evictions.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+BlockCache::Stats BlockCache::stats() const {
+    Stats s;
+    s.hits = hits.load(std::memory_order_relaxed);
+    s.misses = misses.load(std::memory_order_relaxed);
+    s.evictions = evictions.load(std::memory_order_relaxed);
+    s.capacity = capacityBytes;
+    for (auto& shard : shards) {
+        std::lock_guard lock(shard.mtx);
+        s.usage += shard.usage;
+    }
+    return s;
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "../../../common/utils/memory_budget.hpp"
+
+/**
+ * LRU cache of segment data blocks keyed by (segment id, block offset).
+ *
+ * the byte budget is split evenly across NUM_SHARDS independent shards, each
+ * with its own mutex, so concurrent lookups of different blocks rarely
+ * contend. blocks are handed out as shared_ptr, so an entry can be evicted
+ * while a reader is still decoding it.
+ *
+ * cached bytes are also charged to an optional shared MemoryBudget. while
+ * that budget is exceeded, every insert evicts extra blocks, so the cache
+ * shrinks to make room for memtables.
+ */
+class BlockCache {
+public:
+    using Block = std::shared_ptr<const std::string>;
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        size_t usage = 0;    // bytes currently held
+        size_t capacity = 0; // byte budget
+    };
+
+    explicit BlockCache(size_t capacityBytes, std::shared_ptr<MemoryBudget> budget = nullptr);
+    ~BlockCache();
+
+    Block lookup(uint64_t segmentId, uint64_t offset);
+    void insert(uint64_t segmentId, uint64_t offset, Block block);
+
+    Stats stats() const;
+    size_t capacity() const { return capacityBytes; }
+
+private:
+    static constexpr size_t NUM_SHARDS = 16;
+
+    struct Key {
+        uint64_t segmentId;
+        uint64_t offset;
+        bool operator==(const Key& other) const {
+            return segmentId == other.segmentId && offset == other.offset;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& k) const {
+            uint64_t h = k.segmentId * 0x9E3779B97F4A7C15ULL ^ k.offset;
+            h ^= h >> 29;
+            h *= 0xBF58476D1CE4E5B9ULL;
+            return static_cast<size_t>(h ^ (h >> 32));
+        }
+    };
+
+    struct Shard {
+        mutable std::mutex mtx;
+        // front = most recently used
+        std::list<std::pair<Key, Block>> lru;
+        std::unordered_map<Key, std::list<std::pair<Key, Block>>::iterator, KeyHash> map;
+        size_t usage = 0;
+    };
+
+    size_t capacityBytes;
+    size_t shardCapacity;
+    std::shared_ptr<MemoryBudget> budget;
+    std::array<Shard, NUM_SHARDS> shards;
+
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+    std::atomic<uint64_t> evictions{0};
+
+    Shard& shardFor(const Key& key) { return shards[KeyHash{}(key) % NUM_SHARDS]; }
+    static size_t charge(const Block& block) { return block->size() + sizeof(Key) + 64; }
+};
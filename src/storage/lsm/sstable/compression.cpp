@@ -0,0 +1,276 @@
+#include "compression.hpp"
+#include "../../../common/utils/stats.hpp"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <vector>
+
+#ifdef KVDB_HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef KVDB_HAVE_LZ4
+#include <lz4.h>
+#endif
+
+namespace {
+
+void putVarint(std::string& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<char>(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+}
+
+bool getVarint(std::string_view& in, uint64_t& v) {
+    v = 0;
+    for (int shift = 0; shift < 64 && !in.empty(); shift += 7) {
+        uint8_t b = static_cast<uint8_t>(in.front());
+        in.remove_prefix(1);
+        v |= static_cast<uint64_t>(b & 0x7F) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+// segment blocks carry no checksum, so the raw size in a damaged header can
+// be anything. in the LZ and LZ4 formats every payload byte stands for at
+// most 255 output bytes; a larger size is corruption and must be rejected
+// before it reaches an allocation
+bool plausibleRawSize(uint64_t rawSize, size_t payloadBytes) {
+    return rawSize <= (static_cast<uint64_t>(payloadBytes) + 1) * 255;
+}
+
+/**
+ * LZ77 in the spirit of LZ4's block format:
+ *
+ * [varint raw size] then sequences of
+ *   [token: 4 bits literal length | 4 bits match length - 4]
+ *   [extra literal length bytes, if the nibble is 15: 255, 255, ..., < 255]
+ *   [literals]
+ *   [2B match offset][extra match length bytes]
+ * the last sequence has literals only and ends the payload.
+ */
+class LZCodec : public Codec {
+public:
+    CompressionType type() const override { return CompressionType::LZ; }
+    const char* name() const override { return "lz"; }
+
+    void compress(std::string_view in, std::string& out) const override {
+        out.clear();
+        out.reserve(in.size() / 2 + 16);
+        putVarint(out, in.size());
+
+        const auto* src = reinterpret_cast<const uint8_t*>(in.data());
+        const size_t n = in.size();
+        std::vector<uint32_t> table(HASH_SIZE, EMPTY);
+
+        size_t anchor = 0;
+        size_t i = 0;
+        while (i + MIN_MATCH <= n) {
+            uint32_t seq = load32(src + i);
+            uint32_t& slot = table[hash(seq)];
+            size_t cand = slot;
+            slot = static_cast<uint32_t>(i);
+
+            if (cand != EMPTY && i - cand <= MAX_OFFSET && load32(src + cand) == seq) {
+                size_t len = MIN_MATCH;
+                while (i + len < n && src[cand + len] == src[i + len]) ++len;
+                emit(out, src + anchor, i - anchor, i - cand, len);
+                i += len;
+                anchor = i;
+                continue;
+            }
+            ++i;
+        }
+        emit(out, src + anchor, n - anchor, 0, 0);
+    }
+
+    bool decompress(std::string_view in, std::string& out) const override {
+        uint64_t rawSize;
+        if (!getVarint(in, rawSize) || !plausibleRawSize(rawSize, in.size())) return false;
+        out.clear();
+        out.reserve(rawSize);
+
+        while (true) {
+            if (in.empty()) return false;
+            uint8_t token = static_cast<uint8_t>(in.front());
+            in.remove_prefix(1);
+
+            size_t literals = token >> 4;
+            if (literals == 15 && !readLength(in, literals)) return false;
+            if (in.size() < literals || out.size() + literals > rawSize) return false;
+            out.append(in.data(), literals);
+            in.remove_prefix(literals);
+
+            if (in.empty()) return out.size() == rawSize; // literal-only last sequence
+
+            if (in.size() < 2) return false;
+            size_t offset = static_cast<uint8_t>(in[0]) | (static_cast<size_t>(static_cast<uint8_t>(in[1])) << 8);
+            in.remove_prefix(2);
+            size_t len = token & 0x0F;
+            if (len == 15 && !readLength(in, len)) return false;
+            len += MIN_MATCH;
+            if (offset == 0 || offset > out.size() || out.size() + len > rawSize) return false;
+
+            // byte by byte: a match may overlap the bytes it is producing
+            size_t from = out.size() - offset;
+            for (size_t k = 0; k < len; ++k) out.push_back(out[from + k]);
+        }
+    }
+
+private:
+    static constexpr size_t MIN_MATCH = 4;
+    static constexpr size_t MAX_OFFSET = 0xFFFF;
+    static constexpr int HASH_BITS = 12;
+    static constexpr size_t HASH_SIZE = size_t{1} << HASH_BITS;
+    static constexpr uint32_t EMPTY = UINT32_MAX;
+
+    static uint32_t load32(const uint8_t* p) {
+        uint32_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    static uint32_t hash(uint32_t seq) { return (seq * 2654435761u) >> (32 - HASH_BITS); }
+
+    static void putLength(std::string& out, size_t len) {
+        while (len >= 255) {
+            out.push_back(static_cast<char>(255));
+            len -= 255;
+        }
+        out.push_back(static_cast<char>(len));
+    }
+
+    static bool readLength(std::string_view& in, size_t& len) {
+        while (true) {
+            if (in.empty()) return false;
+            uint8_t b = static_cast<uint8_t>(in.front());
+            in.remove_prefix(1);
+            len += b;
+            if (b != 255) return true;
+        }
+    }
+
+    // matchLen == 0 marks the final, literal-only sequence
+    static void emit(std::string& out, const uint8_t* literals, size_t litLen, size_t offset, size_t matchLen) {
+        size_t m = matchLen ? matchLen - MIN_MATCH : 0;
+        out.push_back(static_cast<char>((std::min<size_t>(litLen, 15) << 4) | std::min<size_t>(m, 15)));
+        if (litLen >= 15) putLength(out, litLen - 15);
+        out.append(reinterpret_cast<const char*>(literals), litLen);
+        if (!matchLen) return;
+        out.push_back(static_cast<char>(offset & 0xFF));
+        out.push_back(static_cast<char>(offset >> 8));
+        if (m >= 15) putLength(out, m - 15);
+    }
+};
+
+#ifdef KVDB_HAVE_ZSTD
+class ZstdCodec : public Codec {
+public:
+    CompressionType type() const override { return CompressionType::ZSTD; }
+    const char* name() const override { return "zstd"; }
+
+    void compress(std::string_view in, std::string& out) const override {
+        out.resize(ZSTD_compressBound(in.size()));
+        size_t n = ZSTD_compress(out.data(), out.size(), in.data(), in.size(), 3);
+        out.resize(ZSTD_isError(n) ? 0 : n);
+    }
+
+    bool decompress(std::string_view in, std::string& out) const override {
+        unsigned long long size = ZSTD_getFrameContentSize(in.data(), in.size());
+        if (size == ZSTD_CONTENTSIZE_ERROR || size == ZSTD_CONTENTSIZE_UNKNOWN) return false;
+        // every zstd block decodes to at most 128 KiB and takes at least a
+        // 3 byte header, so a larger content size is a damaged frame header
+        if (size > (in.size() / 3 + 1) * (uint64_t{128} * 1024)) return false;
+        out.resize(size);
+        size_t n = ZSTD_decompress(out.data(), out.size(), in.data(), in.size());
+        return !ZSTD_isError(n) && n == size;
+    }
+};
+#endif
+
+#ifdef KVDB_HAVE_LZ4
+// [varint raw size][lz4 block]
+class LZ4Codec : public Codec {
+public:
+    CompressionType type() const override { return CompressionType::LZ4; }
+    const char* name() const override { return "lz4"; }
+
+    void compress(std::string_view in, std::string& out) const override {
+        out.clear();
+        putVarint(out, in.size());
+        size_t header = out.size();
+        out.resize(header + LZ4_compressBound(static_cast<int>(in.size())));
+        int n = LZ4_compress_default(in.data(), out.data() + header, static_cast<int>(in.size()),
+                                     static_cast<int>(out.size() - header));
+        out.resize(n > 0 ? header + n : 0);
+    }
+
+    bool decompress(std::string_view in, std::string& out) const override {
+        uint64_t rawSize;
+        if (!getVarint(in, rawSize) || !plausibleRawSize(rawSize, in.size())) return false;
+        if (rawSize > static_cast<uint64_t>(INT_MAX) || in.size() > static_cast<size_t>(INT_MAX)) return false;
+        out.resize(rawSize);
+        int n = LZ4_decompress_safe(in.data(), out.data(), static_cast<int>(in.size()), static_cast<int>(rawSize));
+        return n >= 0 && static_cast<uint64_t>(n) == rawSize;
+    }
+};
+#endif
+
+struct CompressionStats {
+    StatsRegistry& registry = StatsRegistry::process();
+    Counter& rawBytes = registry.counter("lsm.compression.raw_bytes");
+    Counter& storedBytes = registry.counter("lsm.compression.stored_bytes");
+    ConcurrentHistogram& decodeNanos = registry.histogram("lsm.compression.decode_nanos");
+};
+
+CompressionStats& stats() {
+    static CompressionStats s;
+    return s;
+}
+
+} // namespace
+
+const Codec* codecFor(CompressionType type) {
+    static const LZCodec lz;
+#ifdef KVDB_HAVE_ZSTD
+    static const ZstdCodec zstd;
+#endif
+#ifdef KVDB_HAVE_LZ4
+    static const LZ4Codec lz4;
+#endif
+    switch (type) {
+    case CompressionType::LZ: return &lz;
+#ifdef KVDB_HAVE_ZSTD
+    case CompressionType::ZSTD: return &zstd;
+#endif
+#ifdef KVDB_HAVE_LZ4
+    case CompressionType::LZ4: return &lz4;
+#endif
+    default: return nullptr;
+    }
+}
+
+CompressionType compressionForLevel(uint32_t level) {
+    CompressionType type = LSM_LEVEL_COMPRESSION[std::min<uint32_t>(level, LSM_NUM_LEVELS - 1)];
+    if (type == CompressionType::NONE || codecFor(type)) return type;
+    return CompressionType::LZ;
+}
+
+namespace compression {
+
+void registerStats() {
+    stats();
+}
+
+void recordWrite(size_t raw, size_t stored) {
+    stats().rawBytes.add(raw);
+    stats().storedBytes.add(stored);
+}
+
+void recordDecode(uint64_t nanos) {
+    stats().decodeNanos.add(nanos);
+}
+
+} // namespace compression
@@ -0,0 +1,41 @@
+#pragma once
+#include "../../../config.hpp"
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/**
+ * block codecs for segment files.
+ *
+ * 1. every codec compresses a whole data block into a self-describing payload
+ * 2. LZ is built in (byte-oriented LZ77, no entropy coding, fast to decode)
+ * 3. ZSTD and LZ4 exist only when the library was found at build time
+ * 4. decompress returns false on a corrupt payload instead of reading out of bounds
+ */
+class Codec {
+public:
+    virtual ~Codec() = default;
+    virtual CompressionType type() const = 0;
+    virtual const char* name() const = 0;
+    virtual void compress(std::string_view in, std::string& out) const = 0;
+    virtual bool decompress(std::string_view in, std::string& out) const = 0;
+};
+
+// the codec for type, or nullptr if it was not compiled in (or is NONE)
+const Codec* codecFor(CompressionType type);
+
+// the codec configured for a level, falling back to LZ when unavailable
+CompressionType compressionForLevel(uint32_t level);
+
+// process-wide metrics in StatsRegistry, updated by the segment builder and
+// reader: lsm.compression.raw_bytes and stored_bytes (data blocks before and
+// after compression, trailers included) and the lsm.compression.decode_nanos
+// histogram. their ratio is the compression ratio
+namespace compression {
+
+// creates the metrics, so they are dumped before the first block is written
+void registerStats();
+void recordWrite(size_t rawBytes, size_t storedBytes);
+void recordDecode(uint64_t nanos);
+
+} // namespace compression
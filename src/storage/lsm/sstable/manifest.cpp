@@ -0,0 +1,305 @@
+#include "manifest.hpp"
+#include "../../../common/utils/coding.hpp"
+#include "../../../common/utils/crc32c.hpp"
+#include "../../../common/utils/logger.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+enum EditTag : uint8_t { ADDED = 1, REMOVED = 2, NEXT_FILE_NUMBER = 3, LAST_SEQUENCE = 4 };
+
+constexpr size_t EDIT_HEADER_BYTES = 8; // [4B crc32c][4B size]
+
+void writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = ::write(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error("Failed to write manifest: " + std::string(std::strerror(errno)));
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+}
+
+std::string frame(const std::string& payload) {
+    std::string out(EDIT_HEADER_BYTES, '\0');
+    uint32_t size = static_cast<uint32_t>(payload.size());
+    std::memcpy(out.data() + 4, &size, sizeof(size));
+    out += payload;
+    uint32_t crc = crc32c::value(out.data() + 4, out.size() - 4);
+    std::memcpy(out.data(), &crc, sizeof(crc));
+    return out;
+}
+
+} // namespace
+
+std::string VersionEdit::encode() const {
+    std::string out;
+    for (const auto& segment : added) {
+        out.push_back(static_cast<char>(ADDED));
+        coding::putU64(out, segment.number);
+        coding::putU32(out, segment.metadata.level);
+        coding::putU64(out, segment.metadata.fileSize);
+        coding::putU64(out, segment.metadata.entryCount);
+        coding::putBytes(out, segment.metadata.smallestKey);
+        coding::putBytes(out, segment.metadata.largestKey);
+    }
+    for (uint64_t number : removed) {
+        out.push_back(static_cast<char>(REMOVED));
+        coding::putU64(out, number);
+    }
+    if (nextFileNumber != 0) {
+        out.push_back(static_cast<char>(NEXT_FILE_NUMBER));
+        coding::putU64(out, nextFileNumber);
+    }
+    if (lastSequence != 0) {
+        out.push_back(static_cast<char>(LAST_SEQUENCE));
+        coding::putU64(out, lastSequence);
+    }
+    return out;
+}
+
+std::optional<VersionEdit> VersionEdit::decode(std::string_view payload) {
+    VersionEdit edit;
+    while (!payload.empty()) {
+        auto tag = static_cast<uint8_t>(payload.front());
+        coding::Reader in(payload.substr(1));
+        switch (tag) {
+        case ADDED: {
+            auto number = in.u64();
+            auto level = in.u32();
+            auto fileSize = in.u64();
+            auto entryCount = in.u64();
+            auto smallest = in.bytes();
+            auto largest = in.bytes();
+            if (!largest || !smallest || !entryCount || !fileSize || !level || !number) return std::nullopt;
+            edit.added.push_back({*number, {*level, *fileSize, *entryCount,
+                                            std::string(*smallest), std::string(*largest)}});
+            break;
+        }
+        case REMOVED: {
+            auto number = in.u64();
+            if (!number) return std::nullopt;
+            edit.removed.push_back(*number);
+            break;
+        }
+        case NEXT_FILE_NUMBER: {
+            auto number = in.u64();
+            if (!number) return std::nullopt;
+            edit.nextFileNumber = *number;
+            break;
+        }
+        case LAST_SEQUENCE: {
+            auto sequence = in.u64();
+            if (!sequence) return std::nullopt;
+            edit.lastSequence = *sequence;
+            break;
+        }
+        default:
+            return std::nullopt;
+        }
+        payload = payload.substr(payload.size() - in.remaining());
+    }
+    return edit;
+}
+
+Manifest::Manifest(fs::path dir, uint64_t maxBytes)
+    : dir(std::move(dir)), filepath(this->dir / "MANIFEST"), maxBytes(maxBytes) {
+    fs::create_directories(this->dir);
+    std::lock_guard lock(mtx);
+    recover();
+    openForAppend();
+}
+
+Manifest::~Manifest() {
+    std::lock_guard lock(mtx);
+    if (fd >= 0) ::close(fd);
+}
+
+void Manifest::recover() {
+    // an interrupted rewrite leaves a temp file behind; the old log is still intact
+    std::error_code ec;
+    fs::remove(filepath.string() + ".tmp", ec);
+
+    std::ifstream in(filepath, std::ios::binary);
+    if (!in) return;
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+
+    size_t pos = 0;
+    size_t edits = 0;
+    bool torn = false;
+    while (pos < data.size()) {
+        if (data.size() - pos < EDIT_HEADER_BYTES) {
+            torn = true;
+            break;
+        }
+        uint32_t crc, size;
+        std::memcpy(&crc, data.data() + pos, sizeof(crc));
+        std::memcpy(&size, data.data() + pos + 4, sizeof(size));
+        if (size > data.size() - pos - EDIT_HEADER_BYTES) {
+            torn = true;
+            break;
+        }
+        size_t end = pos + EDIT_HEADER_BYTES + size;
+        if (crc32c::value(data.data() + pos + 4, 4 + size) != crc) {
+            // every edit is synced before the next is written, so only the last one can be torn
+            if (end != data.size()) {
+                throw std::runtime_error("Manifest corruption in " + filepath.string() +
+                                         " at offset " + std::to_string(pos));
+            }
+            torn = true;
+            break;
+        }
+        auto edit = VersionEdit::decode(std::string_view(data).substr(pos + EDIT_HEADER_BYTES, size));
+        if (!edit) {
+            throw std::runtime_error("Manifest corruption in " + filepath.string() +
+                                     " at offset " + std::to_string(pos));
+        }
+        applyToLive(*edit);
+        ++edits;
+        pos = end;
+    }
+
+    if (torn) {
+        LOG_WARN("[Manifest] Truncating torn edit at offset " << pos);
+        fs::resize_file(filepath, pos);
+    }
+    fileSize = pos;
+    // every apply() writes an edit, so an empty log was created by an open
+    // that never committed its first scan
+    found = edits > 0;
+    LOG_INFO("[Manifest] Replayed " << edits << " edits, " << live.size() << " live segments");
+}
+
+void Manifest::applyToLive(const VersionEdit& edit) {
+    for (uint64_t number : edit.removed) live.erase(number);
+    for (const auto& segment : edit.added) {
+        live[segment.number] = segment.metadata;
+        reserveFileNumbers(segment.number + 1);
+    }
+    if (edit.nextFileNumber != 0) reserveFileNumbers(edit.nextFileNumber);
+    lastSequenceNumber = std::max(lastSequenceNumber, edit.lastSequence);
+}
+
+void Manifest::reserveFileNumbers(uint64_t n) {
+    uint64_t current = nextFileNumber.load();
+    while (current < n && !nextFileNumber.compare_exchange_weak(current, n)) {}
+}
+
+std::map<uint64_t, SSTableReader::Metadata> Manifest::segments() const {
+    std::lock_guard lock(mtx);
+    return live;
+}
+
+uint64_t Manifest::lastSequence() const {
+    std::lock_guard lock(mtx);
+    return lastSequenceNumber;
+}
+
+fs::path Manifest::segmentPath(uint64_t number) const {
+    return dir / ("segment_" + std::to_string(number) + ".dat");
+}
+
+std::optional<uint64_t> Manifest::segmentNumber(const fs::path& path) {
+    // older databases named segments after their creation time in milliseconds,
+    // which reads back as a file number just the same
+    auto stem = path.stem().string();
+    if (path.extension() != ".dat" || stem.rfind("segment_", 0) != 0) return std::nullopt;
+    auto digits = stem.substr(8);
+    if (digits.empty() || digits.find_first_not_of("0123456789") != std::string::npos) return std::nullopt;
+    return std::stoull(digits);
+}
+
+void Manifest::apply(VersionEdit edit) {
+    std::lock_guard lock(mtx);
+    if (broken) throw std::runtime_error("Manifest " + filepath.string() + " is unusable after a failed write");
+    edit.nextFileNumber = nextFileNumber.load();
+    append(edit.encode());
+    applyToLive(edit);
+    found = true;
+
+    if (fileSize > maxBytes) {
+        // the edit is already committed, so a failed rewrite must not fail
+        // the caller; appends carry on in the old log
+        try {
+            rewrite();
+        } catch (const std::exception& e) {
+            LOG_WARN("[Manifest] Rewrite failed: " << e.what());
+        }
+    }
+}
+
+void Manifest::append(const std::string& payload) {
+    auto record = frame(payload);
+    try {
+        writeAll(fd, record.data(), record.size());
+        if (::fdatasync(fd) != 0) {
+            throw std::runtime_error("Failed to sync manifest: " + std::string(std::strerror(errno)));
+        }
+    } catch (...) {
+        // cut the partial edit off so later edits don't land behind garbage
+        // that the next open would take for corruption
+        if (::ftruncate(fd, static_cast<off_t>(fileSize)) != 0 || ::fdatasync(fd) != 0) {
+            broken = true;
+            LOG_ERROR("[Manifest] Failed to truncate " << filepath << " after a failed write; refusing further edits");
+        }
+        throw;
+    }
+    fileSize += record.size();
+}
+
+void Manifest::rewrite() {
+    VersionEdit snapshot;
+    for (const auto& [number, metadata] : live) snapshot.added.push_back({number, metadata});
+    snapshot.nextFileNumber = nextFileNumber.load();
+    snapshot.lastSequence = lastSequenceNumber;
+    auto record = frame(snapshot.encode());
+
+    // 1. the snapshot goes to a temp file, synced
+    fs::path tmp = filepath.string() + ".tmp";
+    int tmpFd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (tmpFd < 0) throw std::runtime_error("Failed to create " + tmp.string());
+    try {
+        writeAll(tmpFd, record.data(), record.size());
+        if (::fsync(tmpFd) != 0) throw std::runtime_error("Failed to sync " + tmp.string());
+    } catch (...) {
+        ::close(tmpFd);
+        throw;
+    }
+    ::close(tmpFd);
+
+    // 2. rename replaces the old log atomically; new edits go to the new file
+    fs::rename(tmp, filepath);
+    syncDirectory();
+    ::close(fd);
+    fd = -1;
+    openForAppend();
+    fileSize = record.size();
+    LOG_INFO("[Manifest] Rewrote manifest with " << live.size() << " live segments");
+}
+
+void Manifest::openForAppend() {
+    bool created = !fs::exists(filepath);
+    fd = ::open(filepath.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) throw std::runtime_error("Failed to open manifest: " + filepath.string());
+    if (created) syncDirectory();
+}
+
+void Manifest::syncDirectory() const {
+    int dirFd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd < 0) return;
+    ::fsync(dirFd);
+    ::close(dirFd);
+}
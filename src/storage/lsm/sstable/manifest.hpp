@@ -0,0 +1,102 @@
+#pragma once
+#include "sstable_reader.hpp"
+#include "../../../config.hpp"
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// one atomic change to the set of live segments
+struct VersionEdit {
+    struct NewSegment {
+        uint64_t number;
+        SSTableReader::Metadata metadata;
+    };
+
+    std::vector<NewSegment> added;
+    std::vector<uint64_t> removed;
+    uint64_t nextFileNumber = 0; // 0 leaves it unchanged
+    uint64_t lastSequence = 0;   // highest sequence number in a segment; 0 leaves it unchanged
+
+    /**
+     * [1B tag][fields] repeated:
+     * tag 1 added:   [8B number][4B level][8B file size][8B entry count]
+     *                [4B size][smallest key][4B size][largest key]
+     * tag 2 removed: [8B number]
+     * tag 3 next file number: [8B number]
+     * tag 4 last sequence: [8B sequence]
+     */
+    std::string encode() const;
+    static std::optional<VersionEdit> decode(std::string_view payload);
+};
+
+/**
+ * append-only log of VersionEdits, kept as <segment dir>/MANIFEST.
+ *
+ * 1. flush and compaction write and sync their segment files and the
+ *    directory first, then apply() one edit; the synced edit is the commit
+ *    point. files written by an edit that never made it are orphans and
+ *    are deleted on the next open
+ * 2. each edit is framed as [4B crc32c][4B size][edit], the crc covering
+ *    the size and the edit. a damaged final edit is a torn write and is cut
+ *    off; damage anywhere else throws
+ * 3. past maxBytes the log is rewritten as a single edit holding the live
+ *    set, and renamed over the old one
+ *
+ * opening a database reads the manifest instead of every segment file.
+ */
+class Manifest {
+public:
+    // opens and replays the manifest in dir, if there is one
+    explicit Manifest(std::filesystem::path dir, uint64_t maxBytes = LSM_MANIFEST_MAX_BYTES);
+    ~Manifest();
+
+    Manifest(const Manifest&) = delete;
+    Manifest& operator=(const Manifest&) = delete;
+
+    // false for a directory written before manifests existed, a new one, or
+    // one whose first scan never committed
+    bool existed() const { return found; }
+    // live segments by file number. file numbers only grow, so this is
+    // also oldest to newest
+    std::map<uint64_t, SSTableReader::Metadata> segments() const;
+
+    uint64_t newFileNumber() { return nextFileNumber.fetch_add(1); }
+    // file numbers below n won't be handed out
+    void reserveFileNumbers(uint64_t n);
+    std::filesystem::path segmentPath(uint64_t number) const;
+    // the highest sequence number any edit recorded, so numbering resumes above it
+    uint64_t lastSequence() const;
+    // nullopt unless path is named like a segment
+    static std::optional<uint64_t> segmentNumber(const std::filesystem::path& path);
+
+    // durably appends edit; throws if it can't
+    void apply(VersionEdit edit);
+    // makes files created or renamed in the segment directory durable
+    void syncDirectory() const;
+
+private:
+    std::filesystem::path dir;
+    std::filesystem::path filepath;
+    uint64_t maxBytes;
+    bool found = false;
+    std::atomic<uint64_t> nextFileNumber{1};
+
+    mutable std::mutex mtx; // guards everything below
+    int fd = -1;
+    uint64_t fileSize = 0;
+    bool broken = false; // a failed append couldn't be cut off; apply() throws
+    std::map<uint64_t, SSTableReader::Metadata> live;
+    uint64_t lastSequenceNumber = 0;
+
+    void recover();
+    void applyToLive(const VersionEdit& edit);
+    void append(const std::string& payload); // caller holds mtx
+    void rewrite();                          // caller holds mtx
+    void openForAppend();                    // caller holds mtx
+};
@@ -0,0 +1,51 @@
+#include "segment_file.hpp"
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+std::unique_ptr<SegmentFile> SegmentFile::open(const std::filesystem::path& path, bool useMmap) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return nullptr;
+
+    auto file = std::unique_ptr<SegmentFile>(new SegmentFile());
+    file->fd = fd;
+
+    struct stat st {};
+    if (fstat(fd, &st) != 0) return nullptr;
+    file->fileSize = static_cast<uint64_t>(st.st_size);
+
+    if (useMmap && file->fileSize > 0) {
+        void* addr = mmap(nullptr, file->fileSize, PROT_READ, MAP_SHARED, fd, 0);
+        if (addr != MAP_FAILED) {
+            // point lookups jump around the file; don't let the kernel read ahead
+            madvise(addr, file->fileSize, MADV_RANDOM);
+            file->mapped = static_cast<const char*>(addr);
+        }
+        // on failure fall back to pread
+    }
+
+    return file;
+}
+
+SegmentFile::~SegmentFile() {
+    if (mapped) munmap(const_cast<char*>(mapped), fileSize);
+    if (fd >= 0) ::close(fd);
+}
+
+std::optional<std::string_view> SegmentFile::read(uint64_t offset, size_t size, std::string& scratch) const {
+    if (offset > fileSize || size > fileSize - offset) return std::nullopt;
+
+    if (mapped) return std::string_view(mapped + offset, size);
+
+    scratch.resize(size);
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = ::pread(fd, scratch.data() + done, size - done, static_cast<off_t>(offset + done));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return std::nullopt;
+        done += static_cast<size_t>(n);
+    }
+    return std::string_view(scratch.data(), size);
+}
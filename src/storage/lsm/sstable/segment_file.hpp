@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+/**
+ * read-only handle on an immutable segment file that stays open for the
+ * lifetime of the segment.
+ *
+ * - mmap mode maps the whole file once; a read is a plain memory access and
+ *   returns a view straight into the mapping.
+ * - pread mode issues a single positioned read into the caller's scratch
+ *   buffer; no seek, no stream state, safe to call from many threads.
+ */
+class SegmentFile {
+public:
+    static std::unique_ptr<SegmentFile> open(const std::filesystem::path& path, bool useMmap);
+    ~SegmentFile();
+
+    SegmentFile(const SegmentFile&) = delete;
+    SegmentFile& operator=(const SegmentFile&) = delete;
+
+    // returns a view of [offset, offset + size); the view is backed either by
+    // the mapping or by scratch, and is valid while both are alive
+    std::optional<std::string_view> read(uint64_t offset, size_t size, std::string& scratch) const;
+
+    uint64_t size() const { return fileSize; }
+    bool isMapped() const { return mapped != nullptr; }
+
+private:
+    SegmentFile() = default;
+
+    int fd = -1;
+    uint64_t fileSize = 0;
+    const char* mapped = nullptr;
+};
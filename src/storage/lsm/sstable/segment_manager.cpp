@@ -1,166 +1,631 @@
 #include "segment_manager.hpp"
-#include "../../../config.hpp"
+#include "sstable_builder.hpp"
+#include "../iterator/merging_iterator.hpp"
+#include "../../../common/utils/coding.hpp"
 #include "../../../common/utils/file_utils.hpp"
+#include "../../../common/utils/stats.hpp"
+#include "../../../common/utils/logger.hpp"
 
-#include <fstream>
-#include <iostream>
+#include <algorithm>
 #include <chrono>
-#include <sstream>
+#include <cmath>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
 #include <string>
-#include <map>
 
-std::string SegmentManager::generateSegmentFilename() const {
-    auto now = std::chrono::system_clock::now().time_since_epoch();
-    return "segment_" + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(now).count()) + ".dat";
+namespace {
+
+// write amplification is (flush + compaction + WAL bytes) over db.bytes_written
+struct SegmentStats {
+    StatsRegistry& registry = StatsRegistry::process();
+    Counter& flushes = registry.counter("lsm.flushes");
+    Counter& flushBytes = registry.counter("lsm.flush_bytes_written");
+    Counter& compactions = registry.counter("lsm.compactions");
+    Counter& compactionBytesRead = registry.counter("lsm.compaction_bytes_read");
+    Counter& compactionBytesWritten = registry.counter("lsm.compaction_bytes_written");
+    ConcurrentHistogram& compactionNanos = registry.histogram("lsm.compaction_nanos");
+};
+
+SegmentStats& stats() {
+    static SegmentStats s;
+    return s;
 }
 
-void SegmentManager::flush(const std::vector<std::pair<std::string, std::string>>& data) {
-    std::filesystem::create_directories(segmentDir);
-    std::string filename = generateSegmentFilename();
-    auto filepath = segmentDir / filename;
+/**
+ * drops the versions of one key, given newest first, that no read can reach.
+ *
+ * 1. the newest version is always kept
+ * 2. an older one is kept while a snapshot falls between it and the next
+ *    newer version: that snapshot reads it
+ * 3. one newer than the last snapshot is kept too; a snapshot taken later
+ *    may land just above it
+ * 4. with nothing below, tombstones at the old end hide nothing and go
+ */
+void retainVersions(std::vector<ValueVersion>& versions, const std::vector<SequenceNumber>& snapshots,
+                    bool bottommost) {
+    size_t kept = versions.empty() ? 0 : 1;
+    for (size_t i = 1; i < versions.size(); ++i) {
+        SequenceNumber sequence = versions[i].sequence;
+        auto s = std::lower_bound(snapshots.begin(), snapshots.end(), sequence);
+        bool read = s != snapshots.end() && *s < versions[i - 1].sequence;
+        bool unpublished = !snapshots.empty() && sequence > snapshots.back();
+        if (read || unpublished) versions[kept++] = versions[i];
+    }
+    versions.resize(kept);
+    while (bottommost && !versions.empty() && isTombstone(versions.back().value)) versions.pop_back();
+}
 
-    std::ofstream out(filepath, std::ios::binary);
-    if (!out) {
-        std::cerr << "Failed to open segment file for writing.\n";
-        return;
+// reads a segment written before the block format: [4B key size][key]
+// [4B value size][value] records back to back, with no header or footer.
+// nullopt unless the whole file parses that way
+std::optional<std::vector<std::pair<std::string, std::string>>> readFlatSegment(const std::filesystem::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return std::nullopt;
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    std::vector<std::pair<std::string, std::string>> records;
+    coding::Reader reader(data);
+    while (!reader.done()) {
+        auto key = reader.bytes();
+        auto value = reader.bytes();
+        if (!key || !value) return std::nullopt;
+        records.emplace_back(*key, *value);
     }
+    return records;
+}
 
-    // write each kv pair to the file and record its byte offset
-    for (const auto& [key, value] : data) {
-        std::streampos offset = out.tellp();
+template<typename List>
+void sortByKeyRange(List& list) {
+    std::sort(list.begin(), list.end(), [](const auto& a, const auto& b) {
+        return a->smallestKey() < b->smallestKey();
+    });
+}
 
-        uint32_t kSize = key.size();
-        uint32_t vSize = value.size();
+template<typename Segment>
+bool overlaps(const Segment& segment, const std::string& smallest, const std::string& largest) {
+    return !(segment->largestKey() < smallest || segment->smallestKey() > largest);
+}
 
-        out.write(reinterpret_cast<const char*>(&kSize), sizeof(kSize));
-        out.write(key.data(), kSize);
-        out.write(reinterpret_cast<const char*>(&vSize), sizeof(vSize));
-        out.write(value.data(), vSize);
+// concatenates the segments of one L1+ level. they don't overlap and are
+// sorted by key range, so only one segment iterator is open at a time
+class LevelIterator : public KVIterator {
+public:
+    LevelIterator(std::vector<std::shared_ptr<SSTableReader>> segments, SequenceNumber snapshot)
+        : segments(std::move(segments)), snapshot(snapshot) {}
 
-        indexMap[key] = { filepath.string(), offset };
-    }
+    bool valid() const override { return current && current->valid(); }
 
-    out.close();
-    std::cout << "[Flush] Wrote " << data.size() << " entries to " << filepath << "\n";
-}
+    void seekToFirst() override {
+        open(0);
+        if (current) current->seekToFirst();
+        skipExhausted();
+    }
 
-void SegmentManager::loadSegments(const std::filesystem::path& dir) {
-    segmentDir = dir;
-    // rebuild the in-memory index map
-    indexMap.clear();
+    void seek(const std::string& target) override {
+        auto it = std::lower_bound(segments.begin(), segments.end(), target,
+            [](const auto& segment, const std::string& k) { return segment->largestKey() < k; });
+        open(static_cast<size_t>(it - segments.begin()));
+        if (current) current->seek(target);
+        skipExhausted();
+    }
 
-    std::filesystem::create_directories(dir);
+    void next() override {
+        current->next();
+        skipExhausted();
+    }
 
-    for (const auto& entry : std::filesystem::directory_iterator(dir)) {
-        if (!entry.is_regular_file() || entry.path().extension() != ".dat") continue;
+    void seekToLast() override {
+        open(segments.size() - 1);
+        if (current) current->seekToLast();
+        skipExhaustedBackward();
+    }
 
-        std::ifstream in(entry.path(), std::ios::binary);
-        if (!in) continue;
+    void seekForPrev(const std::string& target) override {
+        // the last segment starting at or before target is the only candidate
+        auto it = std::upper_bound(segments.begin(), segments.end(), target,
+            [](const std::string& k, const auto& segment) { return k < segment->smallestKey(); });
+        if (it == segments.begin()) {
+            current = nullptr;
+            return;
+        }
+        open(static_cast<size_t>(it - segments.begin()) - 1);
+        current->seekForPrev(target);
+        skipExhaustedBackward();
+    }
 
-        while (in.peek() != EOF) {
-            std::streampos offset = in.tellg();
+    void prev() override {
+        current->prev();
+        skipExhaustedBackward();
+    }
 
-            uint32_t kSize, vSize;
-            in.read(reinterpret_cast<char*>(&kSize), sizeof(kSize));
-            if (in.eof()) break;
+    std::string_view key() const override { return current->key(); }
+    std::string_view value() const override { return current->value(); }
+    SequenceNumber sequence() const override { return current->sequence(); }
+    void versions(std::vector<ValueVersion>& out) const override { current->versions(out); }
 
-            std::string key(kSize, '\0');
-            in.read(&key[0], kSize);
+private:
+    std::vector<std::shared_ptr<SSTableReader>> segments;
+    SequenceNumber snapshot;
+    size_t idx = 0;
+    std::unique_ptr<KVIterator> current;
 
-            in.read(reinterpret_cast<char*>(&vSize), sizeof(vSize));
-            std::string value(vSize, '\0');
-            in.read(&value[0], vSize);
+    void open(size_t i) {
+        idx = i;
+        current = i < segments.size() ? segments[i]->newIterator(snapshot) : nullptr;
+    }
 
-            indexMap[key] = { entry.path().string(), offset };
+    void skipExhausted() {
+        while (current && !current->valid()) {
+            open(idx + 1);
+            if (current) current->seekToFirst();
         }
+    }
 
-        in.close();
+    void skipExhaustedBackward() {
+        while (current && !current->valid()) {
+            if (idx == 0) {
+                current = nullptr;
+                return;
+            }
+            open(idx - 1);
+            current->seekToLast();
+        }
     }
+};
 
-    std::cout << "[Startup] Loaded " << indexMap.size() << " entries from segments.\n";
-}
+} // namespace
 
-std::optional<std::string> SegmentManager::get(const std::string& key) const {
-    auto it = indexMap.find(key);
-    if (it == indexMap.end()) return std::nullopt;
+SegmentManager::SegmentManager(std::shared_ptr<BlockCache> blockCache)
+    : blockCache(std::move(blockCache)) {}
 
-    const auto& [filepath, offset] = it->second;
+std::filesystem::path SegmentManager::newSegmentPath() {
+    if (!manifest) throw std::runtime_error("Segments written before loadSegments()");
+    return manifest->segmentPath(manifest->newFileNumber());
+}
 
-    std::ifstream in(filepath, std::ios::binary);
-    if (!in) return std::nullopt;
+VersionEdit::NewSegment SegmentManager::describe(const SSTableReader& segment) {
+    return {Manifest::segmentNumber(segment.path()).value(), segment.metadata()};
+}
 
-    // seek to stored offset for the key inside the filepath
-    in.seekg(offset);
-    uint32_t kSize, vSize;
+std::shared_ptr<const SegmentManager::Version> SegmentManager::currentVersion() const {
+    std::lock_guard lock(mtx);
+    return current;
+}
 
-    in.read(reinterpret_cast<char*>(&kSize), sizeof(kSize));
-    in.ignore(kSize);
-    in.read(reinterpret_cast<char*>(&vSize), sizeof(vSize));
+template<typename Edit>
+void SegmentManager::editVersion(Edit&& edit) {
+    std::lock_guard lock(mtx);
+    auto next = std::make_shared<Version>(*current);
+    edit(*next);
+    current = std::move(next);
+}
 
-    std::string value(vSize, '\0');
-    in.read(&value[0], vSize);
+uint64_t SegmentManager::levelMaxBytes(int level) {
+    return static_cast<uint64_t>(LSM_LEVEL1_MAX_BYTES * std::pow(LSM_LEVEL_SIZE_RATIO, level - 1));
+}
 
-    return value;
+double SegmentManager::levelScore(const Version& v, int level) {
+    const auto& segments = v.levels[level];
+    if (level == 0) {
+        // L0 is scored by count: every L0 segment is checked on every read
+        return static_cast<double>(segments.size()) / LSM_L0_COMPACTION_TRIGGER;
+    }
+    uint64_t bytes = 0;
+    for (const auto& segment : segments) bytes += segment->fileSize();
+    return static_cast<double>(bytes) / levelMaxBytes(level);
 }
 
-std::vector<std::pair<std::string, std::string>> SegmentManager::getRange(int limit) const {
-    std::vector<std::pair<std::string, std::string>> result;
-    for (const auto& [key, loc] : indexMap) {
-        if (limit != -1 && result.size() >= static_cast<size_t>(limit)) break;
-        if (auto val = get(key)) result.emplace_back(key, *val);
+bool SegmentManager::needsCompaction() const {
+    auto v = currentVersion();
+    for (int level = 0; level + 1 < LSM_NUM_LEVELS; ++level) {
+        if (levelScore(*v, level) >= 1.0) return true;
     }
-    return result;
+    return false;
 }
 
-void SegmentManager::compact() {
-    std::cout << "[Compaction] Starting compaction...\n";
+std::optional<SegmentManager::Compaction> SegmentManager::pickCompaction(const Version& v) const {
+    // 1. level with the highest score, ignoring the last level which has nowhere to go
+    int level = -1;
+    double best = 1.0;
+    for (int l = 0; l + 1 < LSM_NUM_LEVELS; ++l) {
+        double score = levelScore(v, l);
+        if (score >= best) {
+            best = score;
+            level = l;
+        }
+    }
+    if (level < 0) return std::nullopt;
+
+    Compaction c;
+    c.level = level;
+
+    // 2. inputs from the level itself
+    const auto& segments = v.levels[level];
+    if (level == 0) {
+        // L0 segments overlap each other, so they all move down together
+        c.inputs[0] = segments;
+    } else {
+        // round robin through the key space so every segment is eventually compacted
+        auto it = std::find_if(segments.begin(), segments.end(), [&](const auto& segment) {
+            return segment->smallestKey() > compactPointer[level];
+        });
+        c.inputs[0].push_back(it != segments.end() ? *it : segments.front());
+    }
+
+    std::string smallest = c.inputs[0].front()->smallestKey();
+    std::string largest = c.inputs[0].front()->largestKey();
+    for (const auto& segment : c.inputs[0]) {
+        smallest = std::min(smallest, segment->smallestKey());
+        largest = std::max(largest, segment->largestKey());
+    }
+
+    // 3. only the segments of the next level whose key range overlaps
+    for (const auto& segment : v.levels[level + 1]) {
+        if (overlaps(segment, smallest, largest)) c.inputs[1].push_back(segment);
+    }
+    return c;
+}
 
-    // 1. read all entries from indexMap
-    auto allEntries = getRange();
+void SegmentManager::flush(const std::vector<std::pair<std::string, std::string>>& data) {
+    auto byKey = [](const auto& a, const auto& b) { return a.first < b.first; };
 
-    // 2. deduplicate keys (latest wins), but skip tombstones
-    std::map<std::string, std::string> latest;
-    for (const auto& [key, value] : allEntries) {
-        if (!isTombstone(value)) {
-            latest[key] = value;
+    std::filesystem::create_directories(segmentDir);
+    auto filepath = newSegmentPath();
+    {
+        SSTableBuilder builder(filepath, 0);
+        if (std::is_sorted(data.begin(), data.end(), byKey)) {
+            for (const auto& [key, value] : data) builder.add(key, value); // memtable output is already sorted
+        } else {
+            // the block format requires keys in sorted order
+            auto sorted = data;
+            std::stable_sort(sorted.begin(), sorted.end(), byKey);
+            for (const auto& [key, value] : sorted) builder.add(key, value);
         }
+        builder.finish();
     }
 
-    // 3. write to new compacted segment
-    std::string compactedFilename = generateSegmentFilename();
-    auto compactedPath = segmentDir / compactedFilename;
+    installFlushed(filepath, data.size());
+}
 
-    std::ofstream out(compactedPath, std::ios::binary);
-    if (!out) {
-        std::cerr << "[Compaction] Failed to open compacted segment file" << compactedFilename << "\n";
-        return;
+void SegmentManager::flush(KVIterator& it, const std::vector<SequenceNumber>& snapshots) {
+    std::filesystem::create_directories(segmentDir);
+    auto filepath = newSegmentPath();
+    uint64_t count = 0;
+    SequenceNumber lastSequence = 0;
+    {
+        SSTableBuilder builder(filepath, 0);
+        std::vector<ValueVersion> versions;
+        for (it.seekToFirst(); it.valid(); it.next()) {
+            versions.clear();
+            it.versions(versions);
+            lastSequence = std::max(lastSequence, versions.front().sequence);
+            retainVersions(versions, snapshots, false);
+            for (const auto& v : versions) builder.add(it.key(), v.value, v.sequence);
+        }
+        builder.finish();
+        count = builder.entryCount();
     }
+    installFlushed(filepath, count, lastSequence);
+}
 
-    // 4. rebuild index map with only non-deleted entries
-    indexMap.clear();
-    for (const auto& [key, value] : latest) {
-        std::streampos offset = out.tellp();
+void SegmentManager::installFlushed(const std::filesystem::path& filepath, size_t entries,
+                                    SequenceNumber lastSequence) {
+    auto reader = SSTableReader::open(filepath, blockCache);
+    if (!reader) {
+        throw std::runtime_error("Failed to reopen flushed segment: " + filepath.string());
+    }
+    // the builder synced the file's contents; its directory entry must be
+    // durable too before the manifest refers to it
+    manifest->syncDirectory();
+    VersionEdit edit;
+    edit.added.push_back(describe(*reader));
+    edit.lastSequence = lastSequence;
+    try {
+        manifest->apply(std::move(edit));
+    } catch (...) {
+        reader->markObsolete(); // never committed, so nothing refers to the file
+        throw;
+    }
+    uint64_t bytes = reader->fileSize();
+    editVersion([&](Version& next) { next.levels[0].push_back(std::move(reader)); });
+    stats().flushes.add();
+    stats().flushBytes.add(bytes);
 
-        uint32_t kSize = key.size();
-        uint32_t vSize = value.size();
+    LOG_INFO("[Flush] Wrote " << entries << " entries to " << filepath);
+}
 
-        out.write(reinterpret_cast<const char*>(&kSize), sizeof(kSize));
-        out.write(key.data(), kSize);
-        out.write(reinterpret_cast<const char*>(&vSize), sizeof(vSize));
-        out.write(value.data(), vSize);
+void SegmentManager::loadSegments(const std::filesystem::path& dir) {
+    segmentDir = dir;
+    std::filesystem::create_directories(dir);
+    manifest = std::make_unique<Manifest>(dir);
+
+    auto v = std::make_shared<Version>();
+    if (!manifest->existed()) {
+        scanSegments(*v);
+    } else {
+        // the manifest has everything needed to place each segment; files
+        // are only opened once something reads them
+        auto live = manifest->segments();
+        uint64_t entries = 0;
+        for (auto& [number, metadata] : live) {
+            entries += metadata.entryCount;
+            int level = std::min<int>(metadata.level, LSM_NUM_LEVELS - 1);
+            v->levels[level].push_back(SSTableReader::open(manifest->segmentPath(number), metadata, blockCache));
+        }
 
-        indexMap[key] = { compactedPath.string(), offset };
+        // leftovers of a flush or compaction that crashed before committing,
+        // or inputs a committed compaction had not deleted yet
+        for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+            auto number = Manifest::segmentNumber(entry.path());
+            if (!number || live.count(*number)) continue;
+            std::error_code ec;
+            std::filesystem::remove(entry.path(), ec);
+            LOG_INFO("[Startup] Removed orphaned segment " << entry.path());
+        }
+        LOG_INFO("[Startup] Opened " << live.size() << " segments with " << entries << " entries.");
+    }
+    for (int level = 1; level < LSM_NUM_LEVELS; ++level) {
+        sortByKeyRange(v->levels[level]);
     }
 
-    out.close();
+    std::lock_guard lock(mtx);
+    current = std::move(v);
+}
 
-    // 5. delete all old segment files except new compacted one
+void SegmentManager::scanSegments(Version& v) {
+    std::vector<std::pair<uint64_t, std::filesystem::path>> paths;
     for (const auto& entry : std::filesystem::directory_iterator(segmentDir)) {
-        if (entry.path() != compactedPath && entry.path().extension() == ".dat") {
+        if (!entry.is_regular_file()) continue;
+        if (entry.path().extension() == ".tmp") {
+            // a migration that crashed before its rename
             std::filesystem::remove(entry.path());
+            continue;
+        }
+        if (auto number = Manifest::segmentNumber(entry.path())) paths.emplace_back(*number, entry.path());
+    }
+    // segment numbers grow over time, so this sorts oldest to newest
+    std::sort(paths.begin(), paths.end());
+
+    VersionEdit edit;
+    uint64_t entries = 0;
+    for (const auto& [number, path] : paths) {
+        auto reader = SSTableReader::open(path, blockCache);
+        if (!reader) reader = migrateFlatSegment(path);
+        entries += reader->entryCount();
+        edit.added.push_back({number, reader->metadata()});
+        int level = std::min<int>(reader->level(), LSM_NUM_LEVELS - 1);
+        v.levels[level].push_back(std::move(reader));
+    }
+    if (!paths.empty()) manifest->reserveFileNumbers(paths.back().first + 1);
+
+    // from now on the manifest is the source of truth
+    manifest->apply(std::move(edit));
+    LOG_INFO("[Startup] No manifest; scanned " << paths.size() << " segments with "
+            << entries << " entries.");
+}
+
+std::shared_ptr<SSTableReader> SegmentManager::migrateFlatSegment(const std::filesystem::path& path) {
+    auto records = readFlatSegment(path);
+    if (!records) {
+        throw std::runtime_error("Unreadable segment " + path.string()
+                                 + "; move it out of the directory to open the database without it");
+    }
+
+    // the writer sorted by key; if a key repeats, the later record is newer
+    std::stable_sort(records->begin(), records->end(),
+                     [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    // written next to the original and renamed over it, so the file keeps
+    // its number and its place among the other segments. a crash before the
+    // rename leaves the original untouched
+    std::filesystem::path tmp = path;
+    tmp += ".tmp";
+    size_t entries = 0;
+    {
+        SSTableBuilder builder(tmp, 0);
+        for (size_t i = 0; i < records->size(); ++i) {
+            if (i + 1 < records->size() && (*records)[i + 1].first == (*records)[i].first) continue;
+            builder.add((*records)[i].first, (*records)[i].second);
+            ++entries;
+        }
+        builder.finish();
+    }
+    std::filesystem::rename(tmp, path);
+    manifest->syncDirectory();
+
+    auto reader = SSTableReader::open(path, blockCache);
+    if (!reader) throw std::runtime_error("Failed to migrate segment " + path.string());
+    LOG_INFO("[Startup] Migrated " << entries << " entries of legacy segment " << path);
+    return reader;
+}
+
+SequenceNumber SegmentManager::lastSequence() const {
+    return manifest ? manifest->lastSequence() : 0;
+}
+
+std::optional<std::string> SegmentManager::get(const std::string& key, SequenceNumber snapshot) const {
+    // the snapshot keeps every segment alive even if compaction retires it mid-read
+    auto v = currentVersion();
+
+    // L0: newest segment first
+    const auto& l0 = v->levels[0];
+    for (auto it = l0.rbegin(); it != l0.rend(); ++it) {
+        if (auto val = (*it)->get(key, snapshot)) return val;
+    }
+
+    // L1+: at most one candidate segment per level
+    for (int level = 1; level < LSM_NUM_LEVELS; ++level) {
+        const auto& segments = v->levels[level];
+        auto it = std::lower_bound(segments.begin(), segments.end(), key,
+            [](const auto& segment, const std::string& k) { return segment->largestKey() < k; });
+        if (it == segments.end()) continue;
+        if (auto val = (*it)->get(key, snapshot)) return val;
+    }
+    return std::nullopt;
+}
+
+std::vector<size_t> SegmentManager::levelFileCounts() const {
+    auto v = currentVersion();
+    std::vector<size_t> counts;
+    for (const auto& segments : v->levels) counts.push_back(segments.size());
+    return counts;
+}
+
+void SegmentManager::addIterators(std::vector<std::unique_ptr<KVIterator>>& out, SequenceNumber snapshot) const {
+    auto v = currentVersion();
+    const auto& l0 = v->levels[0];
+    for (auto it = l0.rbegin(); it != l0.rend(); ++it) {
+        out.push_back((*it)->newIterator(snapshot));
+    }
+    for (int level = 1; level < LSM_NUM_LEVELS; ++level) {
+        if (!v->levels[level].empty()) {
+            out.push_back(std::make_unique<LevelIterator>(v->levels[level], snapshot));
+        }
+    }
+}
+
+std::vector<std::pair<std::string, std::string>> SegmentManager::getRange(int limit) const {
+    std::vector<std::unique_ptr<KVIterator>> children;
+    addIterators(children);
+    MergingIterator it(std::move(children));
+
+    std::vector<std::pair<std::string, std::string>> result;
+    for (it.seekToFirst(); it.valid(); it.next()) {
+        if (limit != -1 && result.size() >= static_cast<size_t>(limit)) break;
+        result.emplace_back(it.key(), it.value());
+    }
+    return result;
+}
+
+bool SegmentManager::compact(const std::vector<SequenceNumber>& snapshots) {
+    std::lock_guard compactionLock(compactionMtx);
+    auto v = currentVersion();
+    auto c = pickCompaction(*v);
+    if (!c) return false;
+
+    const int outputLevel = c->level + 1;
+    auto started = std::chrono::steady_clock::now();
+    LOG_INFO("[Compaction] L" << c->level << " -> L" << outputLevel << ": merging "
+            << c->inputs[0].size() << " + " << c->inputs[1].size() << " segments");
+
+    // 1. stream the inputs through a k-way merge that gathers each key's
+    //    versions. L0 inputs are ordered oldest to newest, and next-level
+    //    segments hold the oldest data
+    std::vector<std::unique_ptr<KVIterator>> children;
+    for (auto it = c->inputs[0].rbegin(); it != c->inputs[0].rend(); ++it) {
+        children.push_back((*it)->newIterator());
+    }
+    if (!c->inputs[1].empty()) children.push_back(std::make_unique<LevelIterator>(c->inputs[1], MAX_SEQUENCE));
+    MergingIterator merged(std::move(children));
+
+    // 2. tombstones can only be dropped if no deeper level may still hold the key
+    std::string smallest = c->inputs[0].front()->smallestKey();
+    std::string largest = c->inputs[0].front()->largestKey();
+    for (const auto& inputs : c->inputs) {
+        for (const auto& segment : inputs) {
+            smallest = std::min(smallest, segment->smallestKey());
+            largest = std::max(largest, segment->largestKey());
         }
     }
+    bool bottommost = true;
+    for (int level = outputLevel + 1; level < LSM_NUM_LEVELS && bottommost; ++level) {
+        for (const auto& segment : v->levels[level]) {
+            if (overlaps(segment, smallest, largest)) {
+                bottommost = false;
+                break;
+            }
+        }
+    }
+
+    // 3. write the versions snapshots still need, cut into segments of about
+    //    LSM_TARGET_SEGMENT_BYTES. a key's versions never straddle two segments
+    SegmentList outputs;
+    std::unique_ptr<SSTableBuilder> builder;
+    std::filesystem::path outputPath;
+    uint64_t written = 0;
+
+    auto finishOutput = [&]() {
+        builder->finish();
+        builder.reset();
+        auto reader = SSTableReader::open(outputPath, blockCache);
+        if (!reader) throw std::runtime_error("Failed to reopen compacted segment " + outputPath.string());
+        outputs.push_back(std::move(reader));
+    };
+
+    try {
+        std::vector<ValueVersion> versions;
+        for (merged.seekToFirst(); merged.valid(); merged.next()) {
+            versions.clear();
+            merged.versions(versions);
+            retainVersions(versions, snapshots, bottommost);
+            if (versions.empty()) continue;
+            if (!builder) {
+                outputPath = newSegmentPath();
+                builder = std::make_unique<SSTableBuilder>(outputPath, outputLevel);
+            }
+            for (const auto& v : versions) builder->add(merged.key(), v.value, v.sequence);
+            ++written;
+            if (builder->fileSize() >= LSM_TARGET_SEGMENT_BYTES) finishOutput();
+        }
+        if (builder) finishOutput();
+    } catch (const std::exception& e) {
+        LOG_ERROR("[Compaction] " << e.what());
+        if (builder) {
+            builder.reset();
+            std::filesystem::remove(outputPath);
+        }
+        for (const auto& segment : outputs) segment->markObsolete();
+        return false;
+    }
+
+    // 4. commit the swap to the manifest, then publish it. flushes may have
+    //    added L0 segments meanwhile; those are newer than anything compacted
+    //    here and stay where they are. one directory sync makes every
+    //    output's name durable before the edit refers to them
+    manifest->syncDirectory();
+    VersionEdit edit;
+    for (const auto& segment : outputs) edit.added.push_back(describe(*segment));
+    for (const auto& inputs : c->inputs) {
+        for (const auto& segment : inputs) edit.removed.push_back(describe(*segment).number);
+    }
+    try {
+        manifest->apply(std::move(edit));
+    } catch (const std::exception& e) {
+        LOG_ERROR("[Compaction] " << e.what());
+        for (const auto& segment : outputs) segment->markObsolete();
+        return false;
+    }
+
+    auto isInput = [&](const std::shared_ptr<SSTableReader>& segment) {
+        for (const auto& inputs : c->inputs) {
+            if (std::find(inputs.begin(), inputs.end(), segment) != inputs.end()) return true;
+        }
+        return false;
+    };
+    editVersion([&](Version& next) {
+        std::erase_if(next.levels[c->level], isInput);
+        std::erase_if(next.levels[outputLevel], isInput);
+        next.levels[outputLevel].insert(next.levels[outputLevel].end(), outputs.begin(), outputs.end());
+        sortByKeyRange(next.levels[outputLevel]);
+    });
+
+    // 5. retire the inputs; each file is deleted once in-flight reads release it
+    for (const auto& inputs : c->inputs) {
+        for (const auto& segment : inputs) segment->markObsolete();
+    }
+    compactPointer[c->level] = c->inputs[0].back()->largestKey();
+
+    auto& s = stats();
+    s.compactions.add();
+    for (const auto& inputs : c->inputs) {
+        for (const auto& segment : inputs) s.compactionBytesRead.add(segment->fileSize());
+    }
+    for (const auto& segment : outputs) s.compactionBytesWritten.add(segment->fileSize());
+    s.compactionNanos.add(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - started).count()));
 
-    std::cout << "[Compaction] Finished. Compacted into " << compactedPath
-              << " with " << latest.size() << " live entries.\n";
+    LOG_INFO("[Compaction] Finished. Wrote " << outputs.size() << " segments to L" << outputLevel
+            << " with " << written << " entries.");
+    return true;
 }
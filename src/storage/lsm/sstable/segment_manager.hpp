@@ -1,23 +1,107 @@
 #pragma once
 
+#include "sstable_reader.hpp"
+#include "manifest.hpp"
+#include "../iterator/iterator.hpp"
+#include "../../../config.hpp"
+
 #include <string>
-#include <unordered_map>
 #include <vector>
 #include <utility>
 #include <filesystem>
 #include <optional>
+#include <memory>
+#include <mutex>
 
+/**
+ * owns the on-disk segments, organised into levels:
+ *
+ * - L0 holds segments flushed from the memtable. their key ranges may
+ *   overlap, so they are ordered oldest to newest and all of them are checked.
+ * - L1..Ln hold non-overlapping segments ordered by key range; at most one
+ *   segment per level can contain a given key. each level may hold
+ *   LSM_LEVEL_SIZE_RATIO times the bytes of the level above it.
+ *
+ * newer data always lives in a lower level than older data for the same key.
+ * compaction picks the level with the highest score (L0: segment count over
+ * LSM_L0_COMPACTION_TRIGGER, Li: bytes over the level's budget) and merges
+ * the chosen input with only the overlapping segments of the next level.
+ *
+ * the live set is recorded in the directory's MANIFEST: every flush and
+ * compaction commits one edit there before the new version is published.
+ */
 class SegmentManager {
 public:
+    explicit SegmentManager(std::shared_ptr<BlockCache> blockCache = nullptr);
+
+    // opens the segments listed in dir's manifest, deleting files that no
+    // committed edit refers to. a directory without a manifest is scanned
+    // and gets one.
     void loadSegments(const std::filesystem::path& dir);
     void flush(const std::vector<std::pair<std::string, std::string>>& data);
-    std::optional<std::string> get(const std::string& key) const;
+    /**
+     * writes a sorted source (e.g. an immutable memtable) straight to L0,
+     * with every version of each key that a read may still ask for.
+     *
+     * snapshots lists the sequence numbers reads may still be pinned at, in
+     * ascending order, the last one being the newest visible write; versions
+     * newer than that are all kept. empty keeps only each key's newest version.
+     * compact() takes the same list.
+     */
+    void flush(KVIterator& it, const std::vector<SequenceNumber>& snapshots = {});
+    // the key's newest value with sequence <= snapshot, tombstones included
+    std::optional<std::string> get(const std::string& key, SequenceNumber snapshot = MAX_SEQUENCE) const;
     std::vector<std::pair<std::string, std::string>> getRange(int limit = -1) const;
-    void compact();
+
+    // appends iterators over every live segment in the newest-first order
+    // MergingIterator expects: one per L0 segment, then one per deeper level.
+    // the iterators keep their segments alive across compactions.
+    void addIterators(std::vector<std::unique_ptr<KVIterator>>& out,
+                      SequenceNumber snapshot = MAX_SEQUENCE) const;
+
+    // runs a single compaction if any level is over budget.
+    // returns false when there was nothing to do.
+    bool compact(const std::vector<SequenceNumber>& snapshots = {});
+    bool needsCompaction() const;
+    // highest sequence number written to a segment; 0 before loadSegments
+    SequenceNumber lastSequence() const;
+
+    std::vector<size_t> levelFileCounts() const;
+    const std::shared_ptr<BlockCache>& cache() const { return blockCache; }
 
 
 private:
-    std::unordered_map<std::string, std::pair<std::string, std::streampos>> indexMap;
+    using SegmentList = std::vector<std::shared_ptr<SSTableReader>>;
+
+    // immutable snapshot of the live segments. flush and compaction publish a
+    // new version, so a reader only holds mtx long enough to copy the pointer.
+    struct Version {
+        std::vector<SegmentList> levels = std::vector<SegmentList>(LSM_NUM_LEVELS);
+    };
+
+    struct Compaction {
+        int level; // inputs[0] come from this level, output goes to level + 1
+        SegmentList inputs[2];
+    };
+
+    std::shared_ptr<const Version> current = std::make_shared<Version>();
     std::filesystem::path segmentDir;
-    std::string generateSegmentFilename() const;
+    std::unique_ptr<Manifest> manifest; // set by loadSegments
+    std::shared_ptr<BlockCache> blockCache;
+    mutable std::mutex mtx;   // guards current
+    std::mutex compactionMtx; // one compaction at a time
+    std::vector<std::string> compactPointer = std::vector<std::string>(LSM_NUM_LEVELS);
+
+    std::shared_ptr<const Version> currentVersion() const;
+    template<typename Edit> void editVersion(Edit&& edit);
+
+    std::optional<Compaction> pickCompaction(const Version& v) const;
+    static double levelScore(const Version& v, int level);
+    static uint64_t levelMaxBytes(int level);
+
+    std::filesystem::path newSegmentPath();
+    static VersionEdit::NewSegment describe(const SSTableReader& segment);
+    void scanSegments(Version& v);
+    std::shared_ptr<SSTableReader> migrateFlatSegment(const std::filesystem::path& path);
+    void installFlushed(const std::filesystem::path& filepath, size_t entries, SequenceNumber lastSequence = 0);
 };
@@ -0,0 +1,115 @@
+#include "sstable_builder.hpp"
+#include "../../../common/containers/bloom_filter.hpp"
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+SSTableBuilder::SSTableBuilder(const std::filesystem::path& path, uint32_t level, int bloomBitsPerKey,
+                               std::optional<CompressionType> compression)
+    : path(path), out(path, std::ios::binary | std::ios::trunc), level(level), bloomBitsPerKey(bloomBitsPerKey),
+      codec(codecFor(compression.value_or(compressionForLevel(level)))) {
+    if (!out) {
+        throw std::runtime_error("Failed to open segment file for writing: " + path.string());
+    }
+}
+
+void SSTableBuilder::add(std::string_view key, std::string_view value, SequenceNumber sequence) {
+    if (recordCount == 0 || key != recordKey) {
+        finishRecord();
+        if (block.size() >= LSM_BLOCK_SIZE) flushBlock();
+
+        if (numEntries == 0) smallestKey = key;
+        recordKey = key;
+        ++numEntries;
+        if (bloomBitsPerKey > 0) keyHashes.push_back(BloomFilter::hash(key));
+    }
+    coding::putU64(recordVersions, sequence);
+    coding::putBytes(recordVersions, value);
+    ++recordCount;
+}
+
+void SSTableBuilder::finishRecord() {
+    if (recordCount == 0) return;
+    coding::putBytes(block, recordKey);
+    coding::putU32(block, recordCount);
+    block += recordVersions;
+    lastKey = recordKey;
+    recordVersions.clear();
+    recordCount = 0;
+}
+
+void SSTableBuilder::flushBlock() {
+    if (block.empty()) return;
+    size_t rawSize = block.size();
+
+    // keep the compressed form only if it saves at least 1/8 of the block
+    std::string* payload = &block;
+    CompressionType type = CompressionType::NONE;
+    if (codec) {
+        codec->compress(block, compressed);
+        if (!compressed.empty() && compressed.size() < rawSize - rawSize / 8) {
+            payload = &compressed;
+            type = codec->type();
+        }
+    }
+    payload->push_back(static_cast<char>(type));
+
+    index.emplace_back(lastKey, BlockHandle{offset, static_cast<uint32_t>(payload->size())});
+    write(*payload);
+    compression::recordWrite(rawSize, payload->size());
+    block.clear();
+}
+
+void SSTableBuilder::write(const std::string& bytes) {
+    out.write(bytes.data(), bytes.size());
+    if (!out) {
+        throw std::runtime_error("Failed to write segment file: " + path.string());
+    }
+    offset += bytes.size();
+}
+
+uint64_t SSTableBuilder::finish() {
+    if (finished) return offset;
+    finishRecord();
+    flushBlock();
+
+    std::string filterBlock;
+    if (bloomBitsPerKey > 0) {
+        BloomFilter filter(keyHashes.size(), bloomBitsPerKey);
+        for (uint64_t h : keyHashes) filter.addHash(h);
+        filterBlock = filter.serialize();
+    }
+
+    std::string indexBlock;
+    coding::putBytes(indexBlock, smallestKey);
+    coding::putU32(indexBlock, static_cast<uint32_t>(index.size()));
+    for (const auto& [key, handle] : index) {
+        coding::putBytes(indexBlock, key);
+        coding::putU64(indexBlock, handle.offset);
+        coding::putU32(indexBlock, handle.size);
+    }
+
+    Footer footer;
+    footer.filter = {offset, static_cast<uint32_t>(filterBlock.size())};
+    footer.index = {offset + filterBlock.size(), static_cast<uint32_t>(indexBlock.size())};
+    footer.entryCount = numEntries;
+    footer.level = level;
+
+    write(filterBlock);
+    write(indexBlock);
+    write(footer.encode());
+    out.close();
+    if (!out) {
+        throw std::runtime_error("Failed to write segment file: " + path.string());
+    }
+
+    // the manifest will refer to this file, so its contents must be durable first
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0 || ::fdatasync(fd) != 0) {
+        if (fd >= 0) ::close(fd);
+        throw std::runtime_error("Failed to sync segment file: " + path.string());
+    }
+    ::close(fd);
+    finished = true;
+    return offset;
+}
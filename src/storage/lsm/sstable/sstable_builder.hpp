@@ -0,0 +1,59 @@
+#pragma once
+#include "sstable_format.hpp"
+#include "compression.hpp"
+#include "../../../config.hpp"
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <optional>
+
+/**
+ * writes a single segment file in the block format described in
+ * sstable_format.hpp. keys must be added in increasing order; adding the
+ * same key again right after adds an older version of it, so the versions
+ * of a key come newest first and always end up in one record.
+ */
+class SSTableBuilder {
+public:
+    // compression defaults to the codec configured for the level
+    explicit SSTableBuilder(const std::filesystem::path& path,
+                            uint32_t level = 0,
+                            int bloomBitsPerKey = LSM_BLOOM_BITS_PER_KEY,
+                            std::optional<CompressionType> compression = std::nullopt);
+
+    void add(std::string_view key, std::string_view value, SequenceNumber sequence = 0);
+
+    // writes the last data block, the filter block, the index block and the
+    // footer, and syncs the file. returns the total file size in bytes.
+    uint64_t finish();
+
+    // keys added, however many versions each
+    uint64_t entryCount() const { return numEntries; }
+    // an estimate until finish(): the open block is counted uncompressed
+    uint64_t fileSize() const { return offset + block.size() + recordVersions.size(); }
+
+private:
+    std::filesystem::path path;
+    std::ofstream out;
+
+    std::string block;        // data block being filled
+    std::string compressed;   // scratch for the compressed block
+    std::string lastKey;      // last key added to the current block
+    std::string recordKey;    // the key whose versions are being collected
+    std::string recordVersions;
+    uint32_t recordCount = 0; // versions in recordVersions
+    std::string smallestKey;
+    std::vector<std::pair<std::string, BlockHandle>> index;
+    std::vector<uint64_t> keyHashes; // filter is sized once the key count is known
+    uint32_t level;
+    int bloomBitsPerKey;
+    const Codec* codec;       // nullptr stores blocks raw
+    uint64_t offset = 0;      // bytes written to the file so far
+    uint64_t numEntries = 0;
+    bool finished = false;
+
+    void finishRecord(); // moves the collected versions into the block
+    void flushBlock();
+    void write(const std::string& bytes);
+};
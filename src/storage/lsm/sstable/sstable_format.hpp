@@ -0,0 +1,132 @@
+#pragma once
+#include "../iterator/iterator.hpp"
+#include "../../../common/utils/coding.hpp"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <optional>
+#include <vector>
+
+/**
+ * On-disk layout of a segment file:
+ *
+ * [data block 0]
+ * ...
+ * [data block N-1]
+ * [filter block]
+ * [index block]
+ * [footer]
+ *
+ * data block: [payload][1B CompressionType]. the payload, once decompressed,
+ *             holds one record per key in sorted order:
+ *               [4B key size][key][4B version count]
+ *               per version, newest first: [8B sequence][4B value size][value]
+ *             a block is cut once it reaches LSM_BLOCK_SIZE bytes uncompressed,
+ *             and stored raw (type NONE) when compression doesn't pay off.
+ *             version 3 files have no type byte and are always raw; version
+ *             3 and 4 records are [4B key size][key][4B value size][value],
+ *             a single version numbered 0.
+ * index block: [4B smallest key size][smallest key][4B block count]
+ *              followed by one entry per data block:
+ *              [4B last key size][last key][8B block offset][4B block size]
+ * filter block: serialized BloomFilter over every key in the segment,
+ *               empty when bloom filters are disabled.
+ * footer: fixed size, see Footer below.
+ *
+ * opening a segment only reads the footer, the filter and the index block;
+ * a point lookup checks the filter, binary searches the index and reads
+ * exactly one data block.
+ */
+
+constexpr const uint64_t SSTABLE_MAGIC = 0x315453534244564BULL; // "KVDBSST1"
+constexpr const uint32_t SSTABLE_FORMAT_VERSION = 5;
+constexpr const uint32_t SSTABLE_MIN_FORMAT_VERSION = 3; // oldest version still readable
+
+namespace sstable {
+
+// reads the next record of a data block written in formatVersion, appending
+// its versions to out. false if the block is truncated or corrupt
+inline bool readRecord(coding::Reader& in, uint32_t formatVersion, std::string_view& key,
+                       std::vector<ValueVersion>& out) {
+    auto k = in.bytes();
+    if (!k) return false;
+    key = *k;
+    if (formatVersion < 5) {
+        auto value = in.bytes();
+        if (!value) return false;
+        out.push_back({0, *value});
+        return true;
+    }
+    auto count = in.u32();
+    if (!count || *count == 0) return false;
+    for (uint32_t i = 0; i < *count; ++i) {
+        auto sequence = in.u64();
+        auto value = in.bytes();
+        if (!sequence || !value) return false;
+        out.push_back({*sequence, *value});
+    }
+    return true;
+}
+
+} // namespace sstable
+
+struct BlockHandle {
+    uint64_t offset = 0;
+    uint32_t size = 0;
+};
+
+struct Footer {
+    /**
+     * [8B filter offset]
+     * [4B filter size]
+     * [8B index offset]
+     * [4B index size]
+     * [8B entry count]
+     * [4B level]
+     * [4B format version]
+     * [8B magic]
+     */
+    static constexpr size_t SIZE = 48;
+
+    BlockHandle filter;
+    BlockHandle index;
+    uint64_t entryCount = 0;
+    uint32_t level = 0; // level the segment was written to
+    uint32_t version = SSTABLE_FORMAT_VERSION;
+
+    std::string encode() const {
+        std::string out;
+        coding::putU64(out, filter.offset);
+        coding::putU32(out, filter.size);
+        coding::putU64(out, index.offset);
+        coding::putU32(out, index.size);
+        coding::putU64(out, entryCount);
+        coding::putU32(out, level);
+        coding::putU32(out, version);
+        coding::putU64(out, SSTABLE_MAGIC);
+        return out;
+    }
+
+    static std::optional<Footer> decode(std::string_view buf) {
+        coding::Reader in(buf);
+        Footer f;
+        auto filterOffset = in.u64();
+        auto filterSize = in.u32();
+        auto offset = in.u64();
+        auto size = in.u32();
+        auto count = in.u64();
+        auto level = in.u32();
+        auto version = in.u32();
+        auto magic = in.u64();
+        if (!magic || *magic != SSTABLE_MAGIC
+            || *version < SSTABLE_MIN_FORMAT_VERSION || *version > SSTABLE_FORMAT_VERSION) {
+            return std::nullopt;
+        }
+        f.filter = {*filterOffset, *filterSize};
+        f.index = {*offset, *size};
+        f.entryCount = *count;
+        f.level = *level;
+        f.version = *version;
+        return f;
+    }
+};
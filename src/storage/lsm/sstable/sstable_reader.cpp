@@ -0,0 +1,368 @@
+#include "sstable_reader.hpp"
+#include "compression.hpp"
+#include "../../../common/utils/stats.hpp"
+#include "../../../common/utils/logger.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <system_error>
+
+namespace {
+std::atomic<uint64_t> nextSegmentId{1};
+
+// reads that reached the segment file, i.e. missed the block cache
+Counter& blockReads() {
+    static Counter& c = StatsRegistry::process().counter("lsm.block_reads");
+    return c;
+}
+
+Counter& blockReadBytes() {
+    static Counter& c = StatsRegistry::process().counter("lsm.block_read_bytes");
+    return c;
+}
+}
+
+std::unique_ptr<SSTableReader::Contents> SSTableReader::load(const std::filesystem::path& path, bool useMmap,
+                                                           std::string& smallestKey) {
+    auto file = SegmentFile::open(path, useMmap);
+    if (!file) return nullptr;
+
+    uint64_t fileSize = file->size();
+    if (fileSize < Footer::SIZE) return nullptr;
+
+    // 1. footer
+    std::string scratch;
+    auto buf = file->read(fileSize - Footer::SIZE, Footer::SIZE, scratch);
+    auto footer = buf ? Footer::decode(*buf) : std::nullopt;
+    if (!footer
+        || footer->filter.offset + footer->filter.size != footer->index.offset
+        || footer->index.offset + footer->index.size + Footer::SIZE > fileSize) {
+        return nullptr;
+    }
+
+    // 2. filter and index blocks are adjacent, so fetch both with one read
+    buf = file->read(footer->filter.offset, footer->filter.size + footer->index.size, scratch);
+    if (!buf) return nullptr;
+
+    auto contents = std::make_unique<Contents>();
+    contents->footer = *footer;
+
+    if (footer->filter.size > 0) {
+        contents->filter = BloomFilter::deserialize(buf->substr(0, footer->filter.size));
+    }
+
+    coding::Reader idx(buf->substr(footer->filter.size));
+    auto smallest = idx.bytes();
+    auto count = idx.u32();
+    if (!smallest || !count) return nullptr;
+    smallestKey = std::string(*smallest);
+    contents->index.reserve(std::min<size_t>(*count, idx.remaining() / 16));
+
+    for (uint32_t i = 0; i < *count; ++i) {
+        auto key = idx.bytes();
+        auto offset = idx.u64();
+        auto size = idx.u32();
+        if (!key || !offset || !size) return nullptr;
+        contents->index.push_back({std::string(*key), BlockHandle{*offset, *size}});
+    }
+
+    contents->file = std::move(file);
+    return contents;
+}
+
+std::shared_ptr<SSTableReader> SSTableReader::open(const std::filesystem::path& path,
+                                                   std::shared_ptr<BlockCache> cache,
+                                                   bool useMmap) {
+    std::string smallest;
+    auto contents = load(path, useMmap, smallest);
+    if (!contents) return nullptr;
+
+    auto reader = std::shared_ptr<SSTableReader>(new SSTableReader());
+    reader->filepath = path;
+    reader->meta.level = contents->footer.level;
+    reader->meta.fileSize = contents->file->size();
+    reader->meta.entryCount = contents->footer.entryCount;
+    reader->meta.smallestKey = std::move(smallest);
+    if (!contents->index.empty()) reader->meta.largestKey = contents->index.back().lastKey;
+    reader->useMmap = useMmap;
+    reader->loaded = std::move(contents);
+    std::call_once(reader->loadOnce, []() {}); // already loaded
+    reader->cache = std::move(cache);
+    reader->segmentId = nextSegmentId.fetch_add(1);
+    return reader;
+}
+
+std::shared_ptr<SSTableReader> SSTableReader::open(const std::filesystem::path& path,
+                                                   Metadata metadata,
+                                                   std::shared_ptr<BlockCache> cache,
+                                                   bool useMmap) {
+    auto reader = std::shared_ptr<SSTableReader>(new SSTableReader());
+    reader->filepath = path;
+    reader->meta = std::move(metadata);
+    reader->useMmap = useMmap;
+    reader->cache = std::move(cache);
+    reader->segmentId = nextSegmentId.fetch_add(1);
+    return reader;
+}
+
+const SSTableReader::Contents& SSTableReader::contents() const {
+    // a failed load throws out of call_once, so the next read tries again
+    std::call_once(loadOnce, [this]() {
+        std::string smallest;
+        auto contents = load(filepath, useMmap, smallest);
+        if (!contents) throw std::runtime_error("Unreadable segment " + filepath.string());
+        loaded = std::move(contents);
+    });
+    return *loaded;
+}
+
+SSTableReader::~SSTableReader() {
+    if (!obsolete.load()) return;
+    // last reference to a retired segment: nobody can read it any more
+    loaded.reset();
+    std::error_code ec;
+    std::filesystem::remove(filepath, ec);
+    if (ec) LOG_ERROR("[Segment] Failed to remove " << filepath << ": " << ec.message());
+}
+
+std::optional<std::string_view> SSTableReader::readBlock(const BlockHandle& handle, std::string& scratch) const {
+    const Contents& c = contents();
+    auto block = c.file->read(handle.offset, handle.size, scratch);
+    if (!block) {
+        LOG_ERROR("[Segment] Short read from " << filepath);
+        return std::nullopt;
+    }
+    blockReads().add();
+    blockReadBytes().add(handle.size);
+    if (c.footer.version < 4) return block; // no compression trailer
+
+    if (block->empty()) return std::nullopt;
+    auto type = static_cast<CompressionType>(block->back());
+    block->remove_suffix(1);
+    if (type == CompressionType::NONE) return block;
+
+    const Codec* codec = codecFor(type);
+    std::string raw;
+    auto start = std::chrono::steady_clock::now();
+    if (!codec || !codec->decompress(*block, raw)) {
+        LOG_ERROR("[Segment] Undecodable block at offset " << handle.offset << " in " << filepath);
+        return std::nullopt;
+    }
+    compression::recordDecode(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count());
+
+    // callers own scratch until their next read, so the block can live there
+    scratch = std::move(raw);
+    return std::string_view(scratch);
+}
+
+std::optional<std::string_view> SSTableReader::readCachedBlock(const BlockHandle& handle, std::string& scratch,
+                                                              BlockCache::Block& pinned) const {
+    if (!cache) return readBlock(handle, scratch);
+
+    if ((pinned = cache->lookup(segmentId, handle.offset))) return std::string_view(*pinned);
+
+    auto block = readBlock(handle, scratch);
+    if (!block) return std::nullopt;
+    // the block lives in scratch (pread or decompressed), so hand its buffer
+    // to the cache instead of copying; the view may exclude a trailer byte
+    if (block->data() == scratch.data()) {
+        scratch.resize(block->size());
+        pinned = std::make_shared<const std::string>(std::move(scratch));
+    } else {
+        pinned = std::make_shared<const std::string>(*block);
+    }
+    cache->insert(segmentId, handle.offset, pinned);
+    return std::string_view(*pinned);
+}
+
+bool SSTableReader::mayContain(const std::string& key) const {
+    // the key range is known without opening the file
+    if (meta.entryCount == 0 || key < meta.smallestKey || key > meta.largestKey) return false;
+    const auto& filter = contents().filter;
+    return !filter || filter->mayContain(key);
+}
+
+std::optional<std::string> SSTableReader::get(const std::string& key, SequenceNumber snapshot) const {
+    if (!mayContain(key)) return std::nullopt;
+
+    // first block whose last key is >= key is the only one that can hold it
+    const auto& index = contents().index;
+    auto it = std::lower_bound(index.begin(), index.end(), key,
+        [](const IndexEntry& e, const std::string& k) { return e.lastKey < k; });
+    if (it == index.end()) return std::nullopt;
+
+    std::string scratch;
+    BlockCache::Block pinned;
+    auto block = readCachedBlock(it->handle, scratch, pinned);
+    if (!block) return std::nullopt;
+
+    coding::Reader in(*block);
+    uint32_t version = contents().footer.version;
+    std::string_view k;
+    std::vector<ValueVersion> versions;
+    while (!in.done()) {
+        versions.clear();
+        if (!sstable::readRecord(in, version, k, versions)) break;
+        if (k > key) break; // records are sorted
+        if (k != key) continue;
+        for (const auto& v : versions) {
+            if (v.sequence <= snapshot) return std::string(v.value);
+        }
+        return std::nullopt;
+    }
+    return std::nullopt;
+}
+
+class SSTableIterator : public KVIterator {
+public:
+    SSTableIterator(std::shared_ptr<const SSTableReader> reader, SequenceNumber snapshot)
+        : reader(std::move(reader)), index(this->reader->contents().index),
+          formatVersion(this->reader->contents().footer.version), snapshot(snapshot) {}
+
+    bool valid() const override { return blockIdx < index.size(); }
+
+    void seekToFirst() override {
+        loadBlock(0);
+        pos = 0;
+        skipEmptyForward();
+    }
+
+    void seek(const std::string& target) override {
+        // only the first block whose last key is >= target can hold it
+        auto it = std::lower_bound(index.begin(), index.end(), target,
+            [](const SSTableReader::IndexEntry& e, const std::string& k) { return e.lastKey < k; });
+        loadBlock(static_cast<size_t>(it - index.begin()));
+        if (!valid()) return;
+        pos = static_cast<size_t>(std::lower_bound(entries.begin(), entries.end(), target,
+            [](const Entry& e, const std::string& k) { return e.key < k; }) - entries.begin());
+        skipEmptyForward();
+    }
+
+    void next() override {
+        ++pos;
+        skipEmptyForward();
+    }
+
+    void seekToLast() override {
+        loadBlock(index.size() - 1);
+        pos = entries.size();
+        skipEmptyBackward();
+    }
+
+    void seekForPrev(const std::string& target) override {
+        // the last key <= target is in the first block whose last key is >= target,
+        // or it is the last key of the block before that
+        auto it = std::lower_bound(index.begin(), index.end(), target,
+            [](const SSTableReader::IndexEntry& e, const std::string& k) { return e.lastKey < k; });
+        if (it == index.end()) {
+            seekToLast();
+            return;
+        }
+        loadBlock(static_cast<size_t>(it - index.begin()));
+        if (!valid()) return;
+        pos = static_cast<size_t>(std::upper_bound(entries.begin(), entries.end(), target,
+            [](const std::string& k, const Entry& e) { return k < e.key; }) - entries.begin());
+        skipEmptyBackward();
+    }
+
+    void prev() override { skipEmptyBackward(); }
+
+    std::string_view key() const override { return entries[pos].key; }
+    std::string_view value() const override { return blockVersions[entries[pos].visible].value; }
+    SequenceNumber sequence() const override { return blockVersions[entries[pos].visible].sequence; }
+
+    void versions(std::vector<ValueVersion>& out) const override {
+        const Entry& e = entries[pos];
+        out.insert(out.end(), blockVersions.begin() + e.first, blockVersions.begin() + e.end);
+    }
+
+private:
+    // a key of the current block and its versions' range in blockVersions
+    struct Entry {
+        std::string_view key;
+        size_t first;
+        size_t end;
+        size_t visible; // the newest version the snapshot sees
+    };
+
+    std::shared_ptr<const SSTableReader> reader;
+    const std::vector<SSTableReader::IndexEntry>& index; // owned by reader
+    uint32_t formatVersion;
+    SequenceNumber snapshot;
+    size_t blockIdx = SIZE_MAX;
+    std::string scratch;
+    // the current block, decoded once so seeks can binary search. keys with
+    // nothing visible at the snapshot are left out
+    std::vector<Entry> entries;
+    std::vector<ValueVersion> blockVersions;
+    size_t pos = 0;
+
+    void invalidate() { blockIdx = index.size(); }
+
+    // moves to the next block while pos is past the end of the current one
+    void skipEmptyForward() {
+        while (valid() && pos >= entries.size()) {
+            loadBlock(blockIdx + 1);
+            pos = 0;
+        }
+    }
+
+    // steps pos back one entry, moving to earlier blocks as needed
+    void skipEmptyBackward() {
+        while (valid() && pos == 0) {
+            if (blockIdx == 0) {
+                invalidate();
+                return;
+            }
+            loadBlock(blockIdx - 1);
+            pos = entries.size();
+        }
+        if (valid()) --pos;
+    }
+
+    void loadBlock(size_t i) {
+        blockIdx = i;
+        entries.clear();
+        blockVersions.clear();
+        if (!valid()) return;
+
+        auto data = reader->readBlock(index[i].handle, scratch);
+        if (!data) {
+            invalidate(); // unreadable block ends the scan
+            return;
+        }
+        coding::Reader block(*data);
+        while (!block.done()) {
+            Entry e{{}, blockVersions.size(), 0, 0};
+            if (!sstable::readRecord(block, formatVersion, e.key, blockVersions)) {
+                invalidate();
+                return;
+            }
+            e.end = blockVersions.size();
+            e.visible = e.first;
+            while (e.visible < e.end && blockVersions[e.visible].sequence > snapshot) ++e.visible;
+            if (e.visible < e.end) {
+                entries.push_back(e);
+            } else {
+                blockVersions.resize(e.first); // written after the snapshot
+            }
+        }
+    }
+};
+
+std::unique_ptr<KVIterator> SSTableReader::newIterator(SequenceNumber snapshot) const {
+    return std::make_unique<SSTableIterator>(shared_from_this(), snapshot);
+}
+
+std::vector<std::pair<std::string, std::string>> SSTableReader::entries() const {
+    std::vector<std::pair<std::string, std::string>> result;
+    result.reserve(meta.entryCount);
+
+    auto it = newIterator();
+    for (it->seekToFirst(); it->valid(); it->next()) {
+        result.emplace_back(it->key(), it->value());
+    }
+    return result;
+}
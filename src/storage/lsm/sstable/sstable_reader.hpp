@@ -0,0 +1,112 @@
+#pragma once
+#include "sstable_format.hpp"
+#include "segment_file.hpp"
+#include "block_cache.hpp"
+#include "../../../common/containers/bloom_filter.hpp"
+#include "../iterator/iterator.hpp"
+#include "../../../config.hpp"
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+/**
+ * read side of a segment file. only the footer, the bloom filter and the
+ * sparse index are kept in memory; data blocks are read on demand through a
+ * file handle that stays open for the reader's lifetime.
+ *
+ * a reader built from manifest metadata knows the segment's key range, size
+ * and level up front and only opens the file on its first read.
+ *
+ * readers are shared via shared_ptr: compaction marks a replaced segment
+ * obsolete and drops its reference, and the file is deleted once the last
+ * in-flight read releases it.
+ */
+class SSTableReader : public std::enable_shared_from_this<SSTableReader> {
+public:
+    struct IndexEntry {
+        std::string lastKey; // last key stored in the block
+        BlockHandle handle;
+    };
+
+    // what the manifest records about a segment
+    struct Metadata {
+        uint32_t level = 0;
+        uint64_t fileSize = 0;
+        uint64_t entryCount = 0;
+        std::string smallestKey;
+        std::string largestKey;
+    };
+
+    // returns nullptr if the file is not a readable segment
+    static std::shared_ptr<SSTableReader> open(const std::filesystem::path& path,
+                                               std::shared_ptr<BlockCache> cache = nullptr,
+                                               bool useMmap = LSM_USE_MMAP_READS);
+    // trusts metadata and defers opening the file to the first read, which
+    // throws if the file turns out to be unreadable
+    static std::shared_ptr<SSTableReader> open(const std::filesystem::path& path,
+                                               Metadata metadata,
+                                               std::shared_ptr<BlockCache> cache = nullptr,
+                                               bool useMmap = LSM_USE_MMAP_READS);
+    ~SSTableReader();
+
+    // the key's newest value with sequence <= snapshot
+    std::optional<std::string> get(const std::string& key, SequenceNumber snapshot = MAX_SEQUENCE) const;
+
+    // streams the segment one block at a time; keeps the reader alive.
+    // bypasses the block cache so full scans don't evict hot blocks
+    std::unique_ptr<KVIterator> newIterator(SequenceNumber snapshot = MAX_SEQUENCE) const;
+
+    // all entries of the segment in key order, newest versions only
+    std::vector<std::pair<std::string, std::string>> entries() const;
+
+    const std::filesystem::path& path() const { return filepath; }
+    uint64_t id() const { return segmentId; }
+    const Metadata& metadata() const { return meta; }
+    uint64_t entryCount() const { return meta.entryCount; }
+    uint64_t fileSize() const { return meta.fileSize; }
+    uint32_t level() const { return meta.level; }
+    size_t blockCount() const { return contents().index.size(); }
+    const std::string& smallestKey() const { return meta.smallestKey; }
+    const std::string& largestKey() const { return meta.largestKey; }
+
+    // false only if the key is definitely not in this segment; never touches disk
+    bool mayContain(const std::string& key) const;
+
+    // delete the file once the last reference to this reader is dropped
+    void markObsolete() { obsolete.store(true); }
+
+private:
+    friend class SSTableIterator;
+
+    // everything that needs the file
+    struct Contents {
+        Footer footer;
+        std::vector<IndexEntry> index;
+        std::optional<BloomFilter> filter;
+        std::unique_ptr<SegmentFile> file;
+    };
+
+    std::filesystem::path filepath;
+    Metadata meta;
+    bool useMmap = LSM_USE_MMAP_READS;
+    mutable std::once_flag loadOnce;
+    mutable std::unique_ptr<Contents> loaded;
+    std::shared_ptr<BlockCache> cache;
+    uint64_t segmentId = 0; // unique per opened reader, used as the cache key
+    std::atomic<bool> obsolete{false};
+
+    SSTableReader() = default;
+    // nullptr if the file is not a readable segment; smallestKey is filled in
+    static std::unique_ptr<Contents> load(const std::filesystem::path& path, bool useMmap,
+                                          std::string& smallestKey);
+    const Contents& contents() const;
+    std::optional<std::string_view> readBlock(const BlockHandle& handle, std::string& scratch) const;
+    // like readBlock, but served from and filled into the block cache;
+    // pinned keeps a cached block alive while the returned view is in use
+    std::optional<std::string_view> readCachedBlock(const BlockHandle& handle, std::string& scratch,
+                                                    BlockCache::Block& pinned) const;
+};
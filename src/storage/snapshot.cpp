@@ -0,0 +1,38 @@
+#include "snapshot.hpp"
+
+class SnapshotList::Entry : public Snapshot {
+public:
+    Entry(std::shared_ptr<SnapshotList> list, SequenceNumber sequence)
+        : list(std::move(list)), seq(sequence) {}
+    ~Entry() override { list->release(seq); }
+
+    SequenceNumber sequence() const override { return seq; }
+
+private:
+    std::shared_ptr<SnapshotList> list;
+    SequenceNumber seq;
+};
+
+std::shared_ptr<const Snapshot> SnapshotList::acquire(const std::atomic<SequenceNumber>& visible) {
+    std::lock_guard lock(mtx);
+    SequenceNumber sequence = visible.load();
+    live.insert(sequence);
+    return std::make_shared<const Entry>(shared_from_this(), sequence);
+}
+
+std::vector<SequenceNumber> SnapshotList::sequences(const std::atomic<SequenceNumber>& visible) const {
+    std::lock_guard lock(mtx);
+    std::vector<SequenceNumber> out(live.begin(), live.end());
+    out.push_back(visible.load());
+    return out;
+}
+
+size_t SnapshotList::size() const {
+    std::lock_guard lock(mtx);
+    return live.size();
+}
+
+void SnapshotList::release(SequenceNumber sequence) {
+    std::lock_guard lock(mtx);
+    live.erase(live.find(sequence));
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+
+// every write is numbered in log order, starting at 1. data written before
+// sequence numbers existed reads back as 0, older than everything else.
+using SequenceNumber = uint64_t;
+constexpr const SequenceNumber MAX_SEQUENCE = UINT64_MAX;
+
+/**
+ * a read view pinned at one point in the write history: reads through it see
+ * every write numbered up to sequence() and none after, whatever is written,
+ * flushed or compacted meanwhile. taking one copies a number; holding one
+ * keeps compaction from dropping the versions it can see.
+ */
+class Snapshot {
+public:
+    virtual ~Snapshot() = default;
+    virtual SequenceNumber sequence() const = 0;
+};
+
+/**
+ * the live snapshots of one engine. a snapshot keeps the list alive, so it
+ * may outlive the engine that handed it out.
+ */
+class SnapshotList : public std::enable_shared_from_this<SnapshotList> {
+public:
+    // a snapshot at the current value of visible, live until its last copy is released
+    std::shared_ptr<const Snapshot> acquire(const std::atomic<SequenceNumber>& visible);
+
+    // the live snapshots' sequences in ascending order, followed by the
+    // current value of visible. visible is read under the same lock as
+    // acquire(), so a snapshot missing from the list is at least that new.
+    std::vector<SequenceNumber> sequences(const std::atomic<SequenceNumber>& visible) const;
+
+    size_t size() const;
+
+private:
+    class Entry;
+
+    mutable std::mutex mtx;
+    std::multiset<SequenceNumber> live;
+
+    void release(SequenceNumber sequence);
+};
@@ -3,49 +3,318 @@
 #include <cstring>
 #include <filesystem>
 #include <fstream>
-#include <iostream>
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "../../config.hpp"
+#include "../../common/utils/crc32c.hpp"
+#include "../../common/utils/stats.hpp"
+#include "../write_batch.hpp"
+#include "../../common/utils/logger.hpp"
 
 namespace fs = std::filesystem;
 
-WAL::WAL(std::optional<fs::path> pathOverride) : filepath(pathOverride.value_or(WAL_PATH)) {
+namespace {
+
+// [4B crc32c][4B payload size][8B segment id]
+constexpr size_t RECORD_HEADER_BYTES = 16;
+
+template <typename T>
+T load(const char* p) {
+    T v;
+    std::memcpy(&v, p, sizeof(T));
+    return v;
+}
+
+struct WalStats {
+    Counter& bytesWritten = StatsRegistry::process().counter("wal.bytes_written");
+    Counter& syncs = StatsRegistry::process().counter("wal.syncs");
+};
+
+WalStats& stats() {
+    static WalStats s;
+    return s;
+}
+
+int syncData(int fd) {
+    stats().syncs.add();
+    return ::fdatasync(fd);
+}
+
+} // namespace
+
+struct WAL::ReadSegment {
+    std::filesystem::path path;
+    std::string data;
+    std::vector<std::pair<size_t, size_t>> payloads; // offset and size in data
+    size_t validBytes = 0; // length of the intact prefix
+    bool bad = false;      // a damaged record follows the intact prefix
+};
+
+WAL::WAL(std::optional<fs::path> pathOverride, WalSyncMode syncMode,
+         std::chrono::milliseconds syncInterval, size_t segmentBytes)
+    : filepath(pathOverride.value_or(WAL_PATH)), syncMode(syncMode),
+      syncInterval(syncInterval), segmentBytes(segmentBytes) {
     // ensure path exists
     fs::create_directories(filepath.parent_path());
-    
-    // open the file in append mode
-    fp = std::fopen(filepath.string().c_str(), "ab");
-    if (!fp) {
-        throw std::runtime_error("Failed to open WAL file: " + filepath.string());
+
+    // pick up the segments of earlier runs; new ones continue after the highest id
+    uint64_t lastSegment = 0;
+    const auto prefix = filepath.filename().string() + "-";
+    auto dir = filepath.parent_path().empty() ? fs::path(".") : filepath.parent_path();
+    for (const auto& entry : fs::directory_iterator(dir)) {
+        auto name = entry.path().filename().string();
+        if (name.rfind(prefix, 0) != 0) continue;
+        auto suffix = name.substr(prefix.size());
+        bool recycled = suffix.size() > 5 && suffix.compare(suffix.size() - 5, 5, ".free") == 0;
+        if (recycled) suffix.resize(suffix.size() - 5);
+        if (suffix.empty() || suffix.find_first_not_of("0123456789") != std::string::npos) continue;
+
+        uint64_t id = std::stoull(suffix);
+        lastSegment = std::max(lastSegment, id);
+        if (recycled) freeSegments.push_back(entry.path());
+        else liveSegments.push_back(id);
     }
+    std::sort(liveSegments.begin(), liveSegments.end());
+
+    {
+        std::lock_guard lock(fdMtx);
+        activeSegment = lastSegment;
+        openSegment();
+        firstActiveSegment = activeSegment;
+    }
+
+    if (syncMode == WalSyncMode::PERIODIC) {
+        syncThread = std::thread([this]() {
+            std::unique_lock lock(fdMtx);
+            while (!stopSync) {
+                syncCv.wait_for(lock, this->syncInterval, [this]() { return stopSync; });
+                if (!dirty || fd < 0) continue;
 
+                // the fdatasync runs without fdMtx so writers don't queue up
+                // behind it. the duplicate keeps the file open if the segment
+                // rolls over meanwhile; closing the old one syncs it anyway
+                int syncFd = ::dup(fd);
+                dirty = false; // writes from here on mark it again
+                lock.unlock();
+                int rc = syncFd >= 0 ? syncData(syncFd) : -1;
+                std::string error = rc != 0 ? std::strerror(errno) : "";
+                if (syncFd >= 0) ::close(syncFd);
+                lock.lock();
+                if (rc != 0) {
+                    dirty = true;
+                    LOG_ERROR("[WAL] Periodic sync failed: " << error);
+                }
+            }
+        });
+    }
 };
 
 WAL::~WAL() {
-    if (fp) {
-        std::fclose(fp);
-        fp = nullptr;
+    {
+        std::lock_guard lock(fdMtx);
+        stopSync = true;
     }
-};
+    syncCv.notify_one();
+    if (syncThread.joinable()) syncThread.join();
 
-WAL::WAL(WAL&& other) noexcept : filepath(WAL_PATH), fp(other.fp) {
-    other.fp = nullptr;
+    std::lock_guard lock(fdMtx);
+    closeActive();
 };
 
-WAL& WAL::operator=(WAL&& other) noexcept {
-    if (this != &other) {
-        if (fp) std::fclose(fp);
-        filepath = std::move(other.filepath);
-        fp = other.fp;
-        other.fp = nullptr;
+fs::path WAL::segmentPath(uint64_t segment) const {
+    char id[24];
+    std::snprintf(id, sizeof(id), "%06llu", static_cast<unsigned long long>(segment));
+    return filepath.string() + "-" + id;
+}
+
+void WAL::openSegment() {
+    ++activeSegment;
+    auto path = segmentPath(activeSegment);
+    if (!freeSegments.empty()) {
+        // overwrite an obsolete segment in place: its blocks are already
+        // allocated, so syncing the new records doesn't touch file metadata
+        fs::rename(freeSegments.back(), path);
+        freeSegments.pop_back();
+        fd = ::open(path.c_str(), O_WRONLY | O_CLOEXEC);
+    } else {
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    }
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open WAL segment: " + path.string());
     }
+    activeOffset = 0;
+    dirty = false;
+    liveSegments.push_back(activeSegment);
+    // the segment's name has to survive a crash together with its records
+    if (syncMode != WalSyncMode::NONE) syncDirectory();
+}
 
-    return *this;
-};
+void WAL::closeActive() {
+    if (fd < 0) return;
+    // a recycled file still holds its previous life past the last record.
+    // cut it off, so a sealed segment ends in zeroes or at end of file and
+    // leftovers that start mid-record can't read as damage
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && static_cast<uint64_t>(st.st_size) > activeOffset) {
+        if (::ftruncate(fd, static_cast<off_t>(activeOffset)) == 0) dirty = true;
+        else LOG_ERROR("[WAL] Failed to trim segment " << activeSegment << ": " << std::strerror(errno));
+    }
+    // a segment is only sealed or dropped once its contents are durable
+    if (syncMode != WalSyncMode::NONE && dirty) syncData(fd);
+    ::close(fd);
+    fd = -1;
+    dirty = false;
+}
+
+void WAL::recycle(uint64_t segment) {
+    auto path = segmentPath(segment);
+    std::error_code ec;
+    if (freeSegments.size() < WAL_RECYCLED_SEGMENTS) {
+        fs::path freePath = path.string() + ".free";
+        fs::rename(path, freePath, ec);
+        if (!ec) freeSegments.push_back(std::move(freePath));
+    } else {
+        fs::remove(path, ec);
+    }
+    if (ec) LOG_ERROR("[WAL] Failed to recycle segment " << path << ": " << ec.message());
+}
+
+void WAL::syncDirectory() const {
+    auto dir = filepath.parent_path().empty() ? fs::path(".") : filepath.parent_path();
+    int dirFd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd < 0) return;
+    ::fsync(dirFd);
+    ::close(dirFd);
+}
+
+void WAL::writeAll(const uint8_t* data, size_t size) {
+    const size_t start = activeOffset;
+    while (size > 0) {
+        ssize_t n = ::pwrite(fd, data, size, static_cast<off_t>(activeOffset));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            std::string error = std::strerror(errno);
+            // drop the partial write so the next group starts on a record boundary
+            activeOffset = start;
+            int rc = ::ftruncate(fd, static_cast<off_t>(start));
+            (void)rc;
+            throw std::runtime_error("Failed to write WAL: " + error);
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+        activeOffset += static_cast<size_t>(n);
+    }
+    stats().bytesWritten.add(activeOffset - start);
+    dirty = true;
+}
+
+void WAL::writeGroup(const std::vector<size_t>& recordOffsets) {
+    size_t begin = 0; // first byte of batchBuffer not yet written
+    for (size_t i = 0; i < recordOffsets.size(); ++i) {
+        size_t start = recordOffsets[i];
+        size_t end = i + 1 < recordOffsets.size() ? recordOffsets[i + 1] : batchBuffer.size();
+        size_t pending = activeOffset + (start - begin);
+        if (pending > 0 && pending + (end - start) > segmentBytes) {
+            // segment full: write what fits and continue in a fresh one
+            writeAll(batchBuffer.data() + begin, start - begin);
+            begin = start;
+            closeActive();
+            openSegment();
+        }
+
+        uint8_t* header = batchBuffer.data() + start;
+        std::memcpy(header + 8, &activeSegment, sizeof(activeSegment));
+        uint32_t crc = crc32c::value(header + 4, end - start - 4);
+        std::memcpy(header, &crc, sizeof(crc));
+    }
+    writeAll(batchBuffer.data() + begin, batchBuffer.size() - begin);
+}
 
 void WAL::append(WalRecord&& record) {
-    auto data = record.serialize();
-    std::fwrite(data.data(), 1, data.size(), fp);
-    std::fflush(fp);
+    uint64_t unused;
+    append(std::move(record), 0, unused);
+}
+
+void WAL::setLastSequence(uint64_t sequence) {
+    std::lock_guard lock(queueMtx);
+    lastSequence = sequence;
+}
+
+void WAL::append(WalRecord&& record, uint64_t sequences, uint64_t& firstSequence) {
+    Writer w;
+    w.record = &record;
+
+    std::unique_lock lock(queueMtx);
+    // the queue order is the order records reach the log
+    firstSequence = lastSequence + 1;
+    lastSequence += sequences;
+    writers.push_back(&w);
+    w.cv.wait(lock, [&]() { return w.done || writers.front() == &w; });
+    if (w.done) {
+        if (w.failed) throw std::runtime_error("Failed to write WAL: group commit failed");
+        return;
+    }
+
+    // this thread leads: take every queued record, including ones that
+    // arrive while the previous group was being written
+    std::vector<Writer*> group(writers.begin(), writers.end());
+    lock.unlock();
+
+    // the group's writers are blocked until we finish, so their records stay put.
+    // the segment id and crc are filled in once we know which segment each
+    // record lands in.
+    batchBuffer.clear();
+    std::vector<size_t> recordOffsets;
+    recordOffsets.reserve(group.size());
+    for (Writer* writer : group) {
+        auto data = writer->record->serialize();
+        uint32_t size = static_cast<uint32_t>(data.size());
+        recordOffsets.push_back(batchBuffer.size());
+        batchBuffer.resize(batchBuffer.size() + RECORD_HEADER_BYTES);
+        std::memcpy(batchBuffer.data() + recordOffsets.back() + 4, &size, sizeof(size));
+        batchBuffer.insert(batchBuffer.end(), data.begin(), data.end());
+    }
+
+    bool ok = true;
+    {
+        std::lock_guard fdLock(fdMtx);
+        try {
+            writeGroup(recordOffsets);
+            if (syncMode == WalSyncMode::BATCH) {
+                if (syncData(fd) != 0) ok = false;
+                dirty = false;
+            }
+        } catch (const std::exception& e) {
+            LOG_ERROR("[WAL] " << e.what());
+            ok = false;
+        }
+    }
+
+    lock.lock();
+    for (size_t i = 0; i < group.size(); ++i) {
+        Writer* done = writers.front();
+        writers.pop_front();
+        if (done == &w) continue;
+        done->done = true;
+        done->failed = !ok;
+        done->cv.notify_one();
+    }
+    // hand leadership to the next queued writer
+    if (!writers.empty()) writers.front()->cv.notify_one();
+    lock.unlock();
+
+    if (!ok) throw std::runtime_error("Failed to write WAL: " + segmentPath(activeSegment).string());
+}
+
+void WAL::sync() {
+    std::lock_guard lock(fdMtx);
+    if (fd >= 0) syncData(fd);
+    dirty = false;
 }
 
 
@@ -79,7 +348,30 @@ std::vector<uint8_t> WalRecord::serialize() const {
     return buffer;
 }
 
-// read a record from a WAL file
+std::optional<WalRecord> WalRecord::decode(std::string_view payload) {
+    const char* p = payload.data();
+    size_t left = payload.size();
+    if (left < 1 + 4) return std::nullopt;
+
+    WalRecord record;
+    record.opType = static_cast<OpType>(static_cast<uint8_t>(p[0]));
+    uint32_t keySize = load<uint32_t>(p + 1);
+    p += 5;
+    left -= 5;
+    if (keySize > left || left - keySize < 4) return std::nullopt;
+    record.key.assign(p, keySize);
+    p += keySize;
+    left -= keySize;
+
+    uint32_t valueSize = load<uint32_t>(p);
+    p += 4;
+    left -= 4;
+    if (valueSize != left) return std::nullopt;
+    record.value.assign(p, valueSize);
+    return record;
+}
+
+// read a record from an unsegmented WAL file
 std::optional<WalRecord> WalRecord::deserialize(FILE* fp) {
     WalRecord record;
     uint8_t op;
@@ -119,35 +411,164 @@ std::optional<WalRecord> WalRecord::deserialize(FILE* fp) {
 }
 
 
+WAL::ReadSegment WAL::readSegment(uint64_t segment) const {
+    ReadSegment seg;
+    seg.path = segmentPath(segment);
+    {
+        std::ifstream in(seg.path, std::ios::binary);
+        if (!in) throw std::runtime_error("Failed to open WAL segment: " + seg.path.string());
+        seg.data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    const std::string& data = seg.data;
+    size_t pos = 0;
+    while (data.size() - pos >= RECORD_HEADER_BYTES) {
+        const char* header = data.data() + pos;
+        uint32_t crc = load<uint32_t>(header);
+        uint32_t size = load<uint32_t>(header + 4);
+        bool intact = size <= data.size() - pos - RECORD_HEADER_BYTES &&
+                      crc32c::value(header + 4, RECORD_HEADER_BYTES - 4 + size) == crc;
+        if (load<uint64_t>(header + 8) != segment) {
+            // zeroes, or an intact record from before the segment was
+            // recycled: the segment ends here. anything else, a flipped id
+            // included, is damage
+            bool zeroed = std::all_of(header, header + RECORD_HEADER_BYTES, [](char c) { return c == 0; });
+            seg.bad = !zeroed && !intact;
+            break;
+        }
+        if (!intact) {
+            seg.bad = true;
+            break;
+        }
+        seg.payloads.emplace_back(pos + RECORD_HEADER_BYTES, size);
+        pos += RECORD_HEADER_BYTES + size;
+    }
+    seg.validBytes = pos;
+    return seg;
+}
+
 void WAL::replay(std::function<void(const WalRecord&)> handler) {
-    FILE* fp = std::fopen(filepath.string().c_str(), "rb");
-    if (!fp) return;
-
-    try {
-        while (true) {
-            std::optional<WalRecord> rec = WalRecord::deserialize(fp);
-            if (rec == std::nullopt) {
-                std::cout << "WAL Empty." << std::endl;
-                return;
+    // logs from before segmentation come first; their records are copied into
+    // the active segment so the old files can go
+    std::vector<fs::path> legacy = legacyLogs();
+    std::vector<WalRecord> migrated;
+    for (const auto& path : legacy) {
+        std::unique_ptr<FILE, int (*)(FILE*)> fp(std::fopen(path.string().c_str(), "rb"), &std::fclose);
+        if (!fp) continue;
+        try {
+            while (auto rec = WalRecord::deserialize(fp.get())) {
+                replayRecord(*rec, handler);
+                migrated.push_back(std::move(*rec));
             }
+        } catch (const std::exception& e) {
+            // the old format can't tell a torn tail from corruption
+            LOG_WARN("[WAL] " << path.string() << ": " << e.what());
+        }
+    }
+
+    std::vector<ReadSegment> segments;
+    for (uint64_t id : liveSegments) {
+        if (id < firstActiveSegment) segments.push_back(readSegment(id));
+    }
 
-            handler(rec.value());
+    for (size_t i = 0; i < segments.size(); ++i) {
+        auto& seg = segments[i];
+        if (!seg.bad) continue;
+        bool followed = std::any_of(segments.begin() + i + 1, segments.end(),
+                                    [](const ReadSegment& s) { return !s.payloads.empty(); });
+        if (followed) {
+            throw std::runtime_error("WAL corruption in " + seg.path.string() +
+                                     " at offset " + std::to_string(seg.validBytes));
         }
-    } catch (const std::exception& e) {
-        std::cout << e.what() << std::endl;
+        // the last write before a crash never completed
+        LOG_WARN("[WAL] Truncating torn record at " << seg.path.string()
+                << ":" << seg.validBytes);
+        std::error_code ec;
+        fs::resize_file(seg.path, seg.validBytes, ec);
     }
 
-    std::fclose(fp);
+    size_t records = 0;
+    for (const auto& seg : segments) {
+        for (auto [offset, size] : seg.payloads) {
+            auto rec = WalRecord::decode(std::string_view(seg.data).substr(offset, size));
+            if (!rec) {
+                throw std::runtime_error("WAL corruption in " + seg.path.string() +
+                                         " at offset " + std::to_string(offset));
+            }
+            replayRecord(*rec, handler);
+            ++records;
+        }
+    }
+    LOG_INFO("[WAL] Replayed " << records << " records from " << segments.size() << " segments");
+
+    if (legacy.empty()) return;
+    for (auto& rec : migrated) append(std::move(rec));
+    sync();
+    for (const auto& path : legacy) {
+        std::error_code ec;
+        fs::remove(path, ec);
+    }
+}
+
+void WAL::replayRecord(const WalRecord& record, const std::function<void(const WalRecord&)>& handler) {
+    if (record.opType != OpType::BATCH) {
+        handler(record);
+        return;
+    }
+    auto batch = WriteBatch::decode(record.value);
+    if (!batch) {
+        LOG_WARN("[WAL] Skipping corrupt batch");
+        return;
+    }
+    for (const auto& op : batch->ops()) handler(WalRecord{op.type, op.key, op.value});
 }
 
 void WAL::clear() {
-    if (fp) {
-        std::fclose(fp);
-        fp = nullptr;
+    std::lock_guard lock(fdMtx);
+    closeActive();
+    for (uint64_t id : liveSegments) recycle(id);
+    liveSegments.clear();
+    openSegment();
+}
+
+std::vector<fs::path> WAL::legacyLogs() const {
+    // <path> was the active log and <path>.<n> the sealed ones, oldest first
+    std::vector<std::pair<uint64_t, fs::path>> logs;
+    const auto prefix = filepath.filename().string() + ".";
+    auto dir = filepath.parent_path().empty() ? fs::path(".") : filepath.parent_path();
+    for (const auto& entry : fs::directory_iterator(dir)) {
+        auto name = entry.path().filename().string();
+        if (name.rfind(prefix, 0) != 0) continue;
+        auto suffix = name.substr(prefix.size());
+        if (suffix.empty() || suffix.find_first_not_of("0123456789") != std::string::npos) continue;
+        logs.emplace_back(std::stoull(suffix), entry.path());
     }
-    std::filesystem::remove(filepath);
-    fp = std::fopen(filepath.string().c_str(), "ab");
-    if (!fp) {
-        throw std::runtime_error("Failed to reopen WAL after reset.");
+    std::sort(logs.begin(), logs.end());
+
+    std::vector<fs::path> paths;
+    for (auto& [n, path] : logs) paths.push_back(std::move(path));
+    if (fs::is_regular_file(filepath)) paths.push_back(filepath);
+    return paths;
+}
+
+uint64_t WAL::rotate() {
+    std::lock_guard lock(fdMtx);
+    uint64_t sealed = activeSegment;
+    closeActive();
+    openSegment();
+    return sealed;
+}
+
+void WAL::removeSealed(uint64_t logNumber) {
+    std::lock_guard lock(fdMtx);
+    size_t n = 0;
+    while (n < liveSegments.size() && liveSegments[n] <= logNumber && liveSegments[n] != activeSegment) {
+        recycle(liveSegments[n]);
+        ++n;
     }
-}
\ No newline at end of file
+    if (n == 0) return;
+    liveSegments.erase(liveSegments.begin(), liveSegments.begin() + n);
+    // a segment that reappeared after a crash would replay stale records
+    // over newer flushed data
+    if (syncMode != WalSyncMode::NONE) syncDirectory();
+}
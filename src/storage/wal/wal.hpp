@@ -1,13 +1,24 @@
 #pragma once
 #include <cstdio>
 #include <string>
+#include <string_view>
 #include <filesystem>
+#include <optional>
+#include <vector>
+#include <functional>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include "../../config.hpp"
 
 enum OpType {
     CREATE,
     READ,
     UPDATE,
-    DELETE
+    DELETE,
+    BATCH // value holds an encoded WriteBatch
 };
 
 struct WalRecord {
@@ -15,25 +26,117 @@ struct WalRecord {
     std::string key;
     std::string value;
     std::vector<uint8_t> serialize() const;
+    // nullopt if payload is not exactly one serialized record
+    static std::optional<WalRecord> decode(std::string_view payload);
+    // reads the unframed format of logs written before segmented WALs
     static std::optional<WalRecord> deserialize(FILE* fp);
 };
 
+/**
+ * append-only log with group commit, stored as fixed-size segment files.
+ *
+ * 1. concurrent append() calls queue up; the first in line becomes the leader
+ * 2. the leader writes every queued record with one write() and, in BATCH
+ *    mode, one fdatasync() for the whole group
+ * 3. followers sleep until the leader marks their record written
+ * 4. in PERIODIC mode a background thread syncs every syncInterval instead
+ *
+ * segments are named <path>-<id>, ids increasing. each record is framed as
+ *
+ *   [4B crc32c][4B payload size][8B segment id][payload: WalRecord::serialize]
+ *
+ * with the crc covering everything after itself. a record never spans two
+ * segments; when the next one doesn't fit, the log moves on to a new segment.
+ * obsolete segments are renamed to <path>-<id>.free and overwritten later,
+ * which is why each record carries its segment id: leftovers from a
+ * segment's previous life fail that check and end the segment. a segment is
+ * trimmed to its last record when sealed, so past that point only zeroes or
+ * whole intact old records may follow; any other header with the wrong id is
+ * damage.
+ *
+ * on replay, a bad record followed only by empty segments is a torn write
+ * from a crash and is cut off. one followed by more records is corruption,
+ * and replay throws instead of dropping data silently.
+ *
+ * rotate() and clear() must not run concurrently with append().
+ */
 class WAL {
 public:
-    explicit WAL(std::optional<std::filesystem::path> pathOverride = std::nullopt);
+    explicit WAL(std::optional<std::filesystem::path> pathOverride = std::nullopt,
+                 WalSyncMode syncMode = WAL_SYNC_MODE,
+                 std::chrono::milliseconds syncInterval = std::chrono::milliseconds(WAL_SYNC_INTERVAL_MS),
+                 size_t segmentBytes = WAL_SEGMENT_BYTES);
     ~WAL();
 
     WAL(const WAL&)= delete;
     WAL& operator=(const WAL&) = delete;
 
-    WAL(WAL&& other) noexcept;
-    WAL& operator=(WAL&& other) noexcept;
-
+    // returns once the record is written (and synced in BATCH mode). throws if the write fails.
     void append(WalRecord&& record);
+    // as above, numbering the record with `sequences` consecutive sequence
+    // numbers in log order. firstSequence is set when the record is queued,
+    // so it is known even if the write then fails
+    void append(WalRecord&& record, uint64_t sequences, uint64_t& firstSequence);
+    // numbering continues after sequence
+    void setLastSequence(uint64_t sequence);
+    // replays the segments left by previous runs, oldest first. a BATCH record
+    // is handed over as its individual CREATE/DELETE records. logs in the old
+    // unsegmented format are replayed too, then copied into the active segment
+    // and deleted. throws if a segment is corrupt.
     void replay(std::function<void(const WalRecord&)> handler);
+    // drops every record, recycling all segments
     void clear();
+    // forces everything written so far to disk, whatever the sync mode
+    void sync();
+
+    // seals the active segment and continues in a new one. returns the sealed
+    // segment's id, to be passed to removeSealed once every record up to it is
+    // persisted elsewhere.
+    uint64_t rotate();
+    // recycles every segment up to and including logNumber
+    void removeSealed(uint64_t logNumber);
 
 private:
+    struct Writer {
+        const WalRecord* record;
+        bool done = false;
+        bool failed = false;
+        std::condition_variable cv;
+    };
+
+    struct ReadSegment;
+
     std::filesystem::path filepath;
-    FILE* fp;
-};
\ No newline at end of file
+    WalSyncMode syncMode;
+    std::chrono::milliseconds syncInterval;
+    size_t segmentBytes;
+
+    std::mutex queueMtx;          // guards writers and lastSequence
+    std::deque<Writer*> writers;  // front is the current leader
+    uint64_t lastSequence = 0;    // last sequence number handed out
+    std::vector<uint8_t> batchBuffer; // only touched by the leader
+
+    // guarded by fdMtx, which the leader, the sync thread and rotate share
+    std::mutex fdMtx;
+    int fd = -1;                  // the active segment
+    uint64_t activeSegment = 0;
+    size_t activeOffset = 0;      // where the next record goes in the active segment
+    uint64_t firstActiveSegment = 0; // segments before this one were left by earlier runs
+    std::vector<uint64_t> liveSegments;               // sorted, including the active one
+    std::vector<std::filesystem::path> freeSegments;  // obsolete segments waiting for reuse
+    bool dirty = false;           // written since the last sync
+    bool stopSync = false;
+    std::condition_variable syncCv;
+    std::thread syncThread;
+
+    void openSegment(); // caller holds fdMtx
+    void closeActive(); // caller holds fdMtx
+    void recycle(uint64_t segment); // caller holds fdMtx
+    void syncDirectory() const;
+    void writeAll(const uint8_t* data, size_t size); // caller holds fdMtx
+    void writeGroup(const std::vector<size_t>& recordOffsets); // caller holds fdMtx
+    std::filesystem::path segmentPath(uint64_t segment) const;
+    std::vector<std::filesystem::path> legacyLogs() const;
+    ReadSegment readSegment(uint64_t segment) const;
+    void replayRecord(const WalRecord& record, const std::function<void(const WalRecord&)>& handler);
+};
@@ -0,0 +1,56 @@
+#include "write_batch.hpp"
+#include "../common/utils/coding.hpp"
+#include <algorithm>
+
+void WriteBatch::put(std::string key, std::string value) {
+    ops_.push_back(Op{OpType::CREATE, std::move(key), std::move(value)});
+}
+
+void WriteBatch::remove(std::string key) {
+    ops_.push_back(Op{OpType::DELETE, std::move(key), ""});
+}
+
+void WriteBatch::clear() {
+    ops_.clear();
+}
+
+std::string WriteBatch::encode() const {
+    size_t bytes = sizeof(uint32_t);
+    for (const auto& op : ops_) bytes += 1 + 2 * sizeof(uint32_t) + op.key.size() + op.value.size();
+
+    std::string out;
+    out.reserve(bytes);
+    coding::putU32(out, static_cast<uint32_t>(ops_.size()));
+    for (const auto& op : ops_) {
+        out.push_back(static_cast<char>(op.type));
+        coding::putBytes(out, op.key);
+        coding::putBytes(out, op.value);
+    }
+    return out;
+}
+
+std::optional<WriteBatch> WriteBatch::decode(std::string_view data) {
+    coding::Reader in(data);
+    auto count = in.u32();
+    if (!count) return std::nullopt;
+
+    WriteBatch batch;
+    // every op takes at least 9 bytes, so a corrupt count can't force a huge reserve
+    batch.ops_.reserve(std::min<size_t>(*count, in.remaining() / 9));
+    for (uint32_t i = 0; i < *count; ++i) {
+        auto type = in.u8();
+        if (!type) return std::nullopt;
+        Op op;
+        op.type = static_cast<OpType>(*type);
+        if (op.type != OpType::CREATE && op.type != OpType::DELETE) return std::nullopt;
+        auto key = in.bytes();
+        if (!key) return std::nullopt;
+        auto value = in.bytes();
+        if (!value) return std::nullopt;
+        op.key.assign(*key);
+        op.value.assign(*value);
+        batch.ops_.push_back(std::move(op));
+    }
+    if (!in.done()) return std::nullopt;
+    return batch;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "wal/wal.hpp"
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * a group of puts and deletes applied as one unit.
+ *
+ * the whole batch is logged as a single BATCH WAL record, so after a crash
+ * either every operation in it is replayed or none is.
+ */
+class WriteBatch {
+public:
+    struct Op {
+        OpType type; // CREATE or DELETE
+        std::string key;
+        std::string value;
+    };
+
+    void put(std::string key, std::string value);
+    void remove(std::string key);
+    void clear();
+
+    const std::vector<Op>& ops() const { return ops_; }
+    size_t size() const { return ops_.size(); }
+    bool empty() const { return ops_.empty(); }
+
+    /**
+     * [4B  op count]
+     * per op:
+     *   [1B  opType]
+     *   [4B  key size][key bytes]
+     *   [4B  value size][value bytes]
+     */
+    std::string encode() const;
+    // nullopt if the payload is truncated or malformed
+    static std::optional<WriteBatch> decode(std::string_view data);
+
+private:
+    std::vector<Op> ops_;
+};
@@ -41,7 +41,8 @@ clear_daemon_log() {
 # Function to run a CLI command safely
 run_cli_command() {
     local command="$1"
-    local output=$(echo "${command}" | nc -U "${SOCKET_PATH}")
+    # connections are persistent; quit makes the daemon hang up after replying
+    local output=$(printf '%s\nquit\n' "${command}" | nc -U "${SOCKET_PATH}")
     local exit_code=$?
     if [ $exit_code -ne 0 ]; then
         echo "CLI Error ($command): ${output}" >&2
@@ -0,0 +1,136 @@
+#include "catch2/catch_test_macros.hpp"
+#include "../src/common/containers/arena_skiplist.hpp"
+#include "../src/common/utils/arena.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdio>
+
+TEST_CASE("[arena] aligned allocations and exact usage") {
+    Arena arena;
+    REQUIRE(arena.memoryUsage() == 0);
+
+    arena.allocate(3);
+    char* p = arena.allocateAligned(16);
+    REQUIRE(reinterpret_cast<uintptr_t>(p) % alignof(std::max_align_t) == 0);
+    size_t oneBlock = arena.memoryUsage();
+    REQUIRE(oneBlock >= Arena::BLOCK_SIZE);
+
+    // large requests get their own block sized to fit
+    arena.allocate(Arena::BLOCK_SIZE * 3);
+    REQUIRE(arena.memoryUsage() >= oneBlock + Arena::BLOCK_SIZE * 3);
+
+    arena.reset();
+    REQUIRE(arena.memoryUsage() == 0);
+}
+
+TEST_CASE("[arena_skiplist] matches std::map under random inserts") {
+    ArenaSkipList list;
+    std::map<std::string, std::string> expected;
+    std::mt19937 gen(42);
+
+    for (int i = 0; i < 5000; ++i) {
+        std::string key = "k" + std::to_string(gen() % 1000);
+        std::string value(gen() % 40, 'a' + i % 26);
+        list.insert(key, value);
+        expected[key] = value;
+    }
+
+    REQUIRE(list.size() == expected.size());
+    for (const auto& [key, value] : expected) {
+        REQUIRE(list.get(key).value() == value);
+    }
+    REQUIRE_FALSE(list.get("missing").has_value());
+
+    // base level is in key order
+    ArenaSkipList::Iterator it(list);
+    auto want = expected.begin();
+    for (it.seekToFirst(); it.valid(); it.next(), ++want) {
+        REQUIRE(it.key() == want->first);
+        REQUIRE(it.value() == want->second);
+    }
+    REQUIRE(want == expected.end());
+
+    it.seek("k5");
+    REQUIRE(it.key() == expected.lower_bound("k5")->first);
+}
+
+TEST_CASE("[arena_skiplist] memory usage grows with data and clear releases it") {
+    ArenaSkipList list;
+    size_t empty = list.memoryUsage();
+
+    std::string value(100, 'v');
+    for (int i = 0; i < 1000; ++i) list.insert("key" + std::to_string(i), value);
+    REQUIRE(list.memoryUsage() >= empty + 1000 * value.size());
+
+    list.clear();
+    REQUIRE(list.size() == 0);
+    REQUIRE(list.memoryUsage() == empty);
+    REQUIRE_FALSE(list.get("key1").has_value());
+
+    list.insert("a", "1");
+    REQUIRE(list.get("a").value() == "1");
+}
+
+TEST_CASE("[arena_skiplist] concurrent writers and readers") {
+    constexpr int WRITERS = 4;
+    constexpr int KEYS_PER_WRITER = 5000;
+
+    ArenaSkipList list;
+    std::atomic<bool> done{false};
+    std::atomic<int> readerErrors{0};
+
+    auto keyFor = [](int i) {
+        char buf[16];
+        std::snprintf(buf, sizeof(buf), "key%08d", i);
+        return std::string(buf);
+    };
+
+    // readers check the list stays sorted and every value is intact while writers link nodes
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 2; ++r) {
+        readers.emplace_back([&]() {
+            while (!done.load()) {
+                ArenaSkipList::Iterator it(list);
+                std::string prev;
+                for (it.seekToFirst(); it.valid(); it.next()) {
+                    if (!prev.empty() && !(prev < it.key())) readerErrors++;
+                    if (it.value().substr(0, it.key().size()) != it.key()) readerErrors++;
+                    prev = it.key();
+                }
+            }
+        });
+    }
+
+    // writers interleave their keys and all overwrite a shared hot set
+    std::vector<std::thread> writers;
+    for (int w = 0; w < WRITERS; ++w) {
+        writers.emplace_back([&, w]() {
+            for (int i = 0; i < KEYS_PER_WRITER; ++i) {
+                std::string key = keyFor(i * WRITERS + w);
+                list.insert(key, key + "-v");
+                std::string hot = keyFor(WRITERS * KEYS_PER_WRITER + i % 16);
+                list.insert(hot, hot + "-" + std::to_string(w));
+            }
+        });
+    }
+    for (auto& t : writers) t.join();
+    done.store(true);
+    for (auto& t : readers) t.join();
+
+    REQUIRE(readerErrors.load() == 0);
+    REQUIRE(list.size() == WRITERS * KEYS_PER_WRITER + 16);
+    for (int i = 0; i < WRITERS * KEYS_PER_WRITER; ++i) {
+        REQUIRE(list.get(keyFor(i)).value() == keyFor(i) + "-v");
+    }
+
+    size_t seen = 0;
+    ArenaSkipList::Iterator it(list);
+    for (it.seekToFirst(); it.valid(); it.next()) ++seen;
+    REQUIRE(seen == list.size());
+}
@@ -0,0 +1,83 @@
+#include "catch2/catch_test_macros.hpp"
+#include "../src/storage/lsm/sstable/block_cache.hpp"
+#include "../src/storage/lsm/engine/lsm_engine.hpp"
+#include <filesystem>
+#include <string>
+
+static BlockCache::Block makeBlock(size_t size, char fill) {
+    return std::make_shared<const std::string>(size, fill);
+}
+
+TEST_CASE("[block_cache]: lookup counts hits and misses") {
+    BlockCache cache(1 << 20);
+
+    REQUIRE(cache.lookup(1, 0) == nullptr);
+    cache.insert(1, 0, makeBlock(100, 'a'));
+
+    auto block = cache.lookup(1, 0);
+    REQUIRE(block != nullptr);
+    REQUIRE(*block == std::string(100, 'a'));
+    REQUIRE(cache.lookup(1, 4096) == nullptr);
+    REQUIRE(cache.lookup(2, 0) == nullptr);
+
+    auto stats = cache.stats();
+    REQUIRE(stats.hits == 1);
+    REQUIRE(stats.misses == 3);
+    REQUIRE(stats.usage > 0);
+}
+
+TEST_CASE("[block_cache]: stays within its byte budget") {
+    BlockCache cache(64 * 1024);
+
+    for (uint64_t i = 0; i < 1000; ++i) {
+        cache.insert(i, i * 4096, makeBlock(1024, 'x'));
+    }
+
+    auto stats = cache.stats();
+    REQUIRE(stats.usage <= stats.capacity);
+    REQUIRE(stats.evictions > 0);
+    // the most recent insert is still cached
+    REQUIRE(cache.lookup(999, 999 * 4096) != nullptr);
+}
+
+TEST_CASE("[block_cache]: serves repeated segment reads") {
+    std::filesystem::remove_all("data-cache");
+    {
+        LSMEngine engine("data-cache/db.wal", 400, "data-cache/segments");
+        // the first memtable fills after about ten puts and the second one waits
+        // for its flush, so key3 is on disk by the time the loop returns
+        for (int i = 0; i < 25; ++i) engine.put("key" + std::to_string(i), "value");
+
+        REQUIRE(engine.get("key3").value() == "value");
+        REQUIRE(engine.get("key3").value() == "value");
+
+        auto stats = engine.blockCacheStats();
+        REQUIRE(stats.misses == 1);
+        REQUIRE(stats.hits == 1);
+    }
+}
+
+TEST_CASE("[block_cache]: shrinks while the shared memory budget is exceeded") {
+    auto budget = std::make_shared<MemoryBudget>(64 * 1024);
+    BlockCache cache(1024 * 1024, budget);
+
+    auto block = std::make_shared<const std::string>(1024, 'x');
+    for (uint64_t i = 0; i < 32; ++i) cache.insert(1, i * 4096, block);
+    REQUIRE(budget->usage() == cache.stats().usage);
+    REQUIRE(cache.stats().evictions == 0);
+
+    // someone else takes the rest of the budget: new inserts push old blocks out
+    budget->reserve(64 * 1024);
+    for (uint64_t i = 32; i < 64; ++i) cache.insert(1, i * 4096, block);
+    REQUIRE(cache.stats().evictions > 0);
+    REQUIRE(cache.stats().usage < 32 * 1024);
+    budget->release(64 * 1024);
+
+    size_t held = cache.stats().usage;
+    {
+        BlockCache other(1024 * 1024, budget);
+        other.insert(2, 0, block);
+        REQUIRE(budget->usage() > held);
+    }
+    REQUIRE(budget->usage() == held); // released on destruction
+}
@@ -0,0 +1,38 @@
+#include "catch2/catch_test_macros.hpp"
+#include "../src/common/containers/bloom_filter.hpp"
+#include <string>
+
+TEST_CASE("[bloom_filter] no false negatives") {
+    BloomFilter filter(1000, 10);
+    for (int i = 0; i < 1000; ++i) filter.add("key" + std::to_string(i));
+
+    for (int i = 0; i < 1000; ++i) {
+        REQUIRE(filter.mayContain("key" + std::to_string(i)));
+    }
+}
+
+TEST_CASE("[bloom_filter] false positive rate is bounded") {
+    BloomFilter filter(10000, 10);
+    for (int i = 0; i < 10000; ++i) filter.add("key" + std::to_string(i));
+
+    int falsePositives = 0;
+    for (int i = 0; i < 10000; ++i) {
+        if (filter.mayContain("missing" + std::to_string(i))) ++falsePositives;
+    }
+    // ~1% expected at 10 bits per key
+    REQUIRE(falsePositives < 300);
+}
+
+TEST_CASE("[bloom_filter] serialize round trip") {
+    BloomFilter filter(100, 10);
+    filter.add("apple");
+    filter.add("banana");
+
+    auto restored = BloomFilter::deserialize(filter.serialize());
+    REQUIRE(restored.has_value());
+    REQUIRE(restored->mayContain("apple"));
+    REQUIRE(restored->mayContain("banana"));
+    REQUIRE(restored->byteSize() == filter.byteSize());
+
+    REQUIRE_FALSE(BloomFilter::deserialize("").has_value());
+}
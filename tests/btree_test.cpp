@@ -0,0 +1,234 @@
+#include "catch2/catch_test_macros.hpp"
+#include "../src/storage/btree/btree_engine.hpp"
+#include "../src/db/database.hpp"
+#include <atomic>
+#include <filesystem>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const fs::path DIR = "data-btree";
+
+std::string key(int i) {
+    char buf[16];
+    std::snprintf(buf, sizeof(buf), "key%06d", i);
+    return buf;
+}
+
+std::vector<std::pair<std::string, std::string>> scan(StorageEngine& engine, ScanOptions options) {
+    std::vector<std::pair<std::string, std::string>> rows;
+    for (auto cursor = engine.newCursor(options); cursor->valid(); cursor->next()) {
+        rows.emplace_back(cursor->key(), cursor->value());
+    }
+    return rows;
+}
+
+} // namespace
+
+TEST_CASE("[btree]: matches a map through splits, overwrites and deletes") {
+    fs::remove_all(DIR);
+    // small pages make for a deep tree quickly
+    BTreeEngine engine(DIR / "tree.db", 512);
+    std::map<std::string, std::string> expected;
+    std::mt19937 rng(7);
+
+    for (int i = 0; i < 5000; ++i) {
+        int k = static_cast<int>(rng() % 2000);
+        switch (rng() % 4) {
+        case 0:
+            engine.remove(key(k));
+            expected.erase(key(k));
+            break;
+        default: {
+            std::string value = "v" + std::to_string(i) + std::string(rng() % 40, 'x');
+            engine.put(key(k), value);
+            expected[key(k)] = value;
+        }
+        }
+    }
+    REQUIRE(engine.height() >= 3);
+
+    for (int k = 0; k < 2000; ++k) {
+        auto it = expected.find(key(k));
+        auto value = engine.get(key(k));
+        if (it == expected.end()) REQUIRE(!value);
+        else REQUIRE(value == it->second);
+    }
+    REQUIRE(engine.getRange() == std::vector<std::pair<std::string, std::string>>(expected.begin(), expected.end()));
+}
+
+TEST_CASE("[btree]: cursors walk the leaf chain both ways within bounds") {
+    fs::remove_all(DIR);
+    BTreeEngine engine(DIR / "tree.db", 512);
+    for (int i = 0; i < 1000; i += 2) engine.put(key(i), "v" + std::to_string(i));
+
+    ScanOptions forward;
+    forward.start = key(101);
+    forward.end = key(301);
+    auto rows = scan(engine, forward);
+    REQUIRE(rows.size() == 100);
+    REQUIRE(rows.front().first == key(102));
+    REQUIRE(rows.back().first == key(300));
+
+    ScanOptions reverse = forward;
+    reverse.reverse = true;
+    rows = scan(engine, reverse);
+    REQUIRE(rows.size() == 100);
+    REQUIRE(rows.front().first == key(300));
+    REQUIRE(rows.back().first == key(102));
+
+    // seek clamps to the bounds
+    auto cursor = engine.newCursor(reverse);
+    cursor->seek(key(201));
+    REQUIRE(cursor->key() == key(200));
+    cursor->seek(key(999));
+    REQUIRE(cursor->key() == key(300));
+
+    // leaves emptied by deletes are skipped
+    for (int i = 200; i < 800; i += 2) engine.remove(key(i));
+    rows = scan(engine, {});
+    REQUIRE(rows.size() == 200);
+    REQUIRE(rows[99].first == key(198));
+    REQUIRE(rows[100].first == key(800));
+    ScanOptions all;
+    all.reverse = true;
+    rows = scan(engine, all);
+    REQUIRE(rows[99].first == key(800));
+    REQUIRE(rows[100].first == key(198));
+}
+
+TEST_CASE("[btree]: large values overflow and their pages are reused") {
+    fs::remove_all(DIR);
+    BTreeEngine engine(DIR / "tree.db");
+    std::string big(100 * 1000, 'b');
+    for (size_t i = 0; i < big.size(); ++i) big[i] = static_cast<char>('a' + i % 26);
+
+    engine.put("big", big);
+    engine.put("small", "s");
+    REQUIRE(engine.get("big") == big);
+    auto pages = engine.pageCount();
+
+    // rewriting the value frees its chain, and the new one reuses those pages
+    for (int i = 0; i < 10; ++i) engine.put("big", big);
+    engine.remove("big");
+    engine.put("big2", big);
+    REQUIRE(engine.get("big2") == big);
+    REQUIRE(!engine.get("big"));
+    REQUIRE(engine.pageCount() <= pages + 2);
+
+    REQUIRE_THROWS(engine.put(std::string(engine.maxKeySize() + 1, 'k'), "v"));
+}
+
+TEST_CASE("[btree]: survives reopening, from the page file or from the WAL") {
+    fs::remove_all(DIR);
+    {
+        BTreeEngine engine(DIR / "tree.db");
+        for (int i = 0; i < 3000; ++i) engine.put(key(i), "v" + std::to_string(i));
+        WriteBatch batch;
+        batch.put("batch", "1");
+        batch.remove(key(0));
+        engine.write(batch);
+    }
+    {
+        BTreeEngine engine(DIR / "tree.db");
+        REQUIRE(engine.get(key(2999)) == "v2999");
+        REQUIRE(engine.get("batch") == "1");
+        REQUIRE(!engine.get(key(0)));
+
+        // a process crash leaves the pages written back so far, the journal
+        // and the WAL; copy them while the engine is still open and open the
+        // copy. the page file goes first: anything written back after that
+        // is still covered by the journal copied next
+        engine.put("after", "checkpoint");
+        engine.remove(key(1));
+        fs::remove_all("data-btree-crash");
+        fs::create_directories("data-btree-crash");
+        fs::copy(DIR / "tree.db", "data-btree-crash/tree.db");
+        for (const auto& entry : fs::directory_iterator(DIR)) {
+            if (entry.path().filename() == "tree.db") continue;
+            fs::copy(entry.path(), "data-btree-crash" / entry.path().filename(), fs::copy_options::overwrite_existing);
+        }
+    }
+    {
+        BTreeEngine engine("data-btree-crash/tree.db");
+        REQUIRE(engine.get("after") == "checkpoint");
+        REQUIRE(!engine.get(key(1)));
+        REQUIRE(engine.get(key(2)) == "v2");
+        REQUIRE(engine.getRange().size() == 3000);
+    }
+    fs::remove_all("data-btree-crash");
+    REQUIRE_THROWS(BTreeEngine(DIR / "tree.db", 8192));
+}
+
+TEST_CASE("[btree]: reverse scans see every key while writers split the leaves") {
+    fs::remove_all(DIR);
+    BTreeEngine engine(DIR / "tree.db", 1024);
+    for (int i = 0; i < 4000; i += 2) engine.put(key(i), "0");
+
+    // the writer fills in the odd keys, splitting leaves behind the readers
+    std::atomic<bool> done{false};
+    std::atomic<int> bad{0};
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 2; ++r) {
+        readers.emplace_back([&]() {
+            ScanOptions options;
+            options.reverse = true;
+            while (!done.load()) {
+                int expected = 3998;
+                for (auto cursor = engine.newCursor(options); cursor->valid(); cursor->next()) {
+                    int k = std::stoi(std::string(cursor->key().substr(3)));
+                    if (k % 2 != 0) continue;
+                    if (k != expected) bad.fetch_add(1);
+                    expected = k - 2;
+                }
+                if (expected != -2) bad.fetch_add(1);
+            }
+        });
+    }
+    for (int i = 1; i < 4000; i += 2) engine.put(key(i), std::string(40, 'v'));
+    done = true;
+    for (auto& t : readers) t.join();
+    REQUIRE(bad.load() == 0);
+    REQUIRE(engine.getRange().size() == 4000);
+}
+
+TEST_CASE("[btree]: concurrent readers and writers, and selection through Database") {
+    fs::remove_all(DIR);
+    BTreeEngine engine(DIR / "tree.db", 1024);
+    for (int i = 0; i < 2000; ++i) engine.put(key(i), "0");
+
+    std::atomic<bool> done{false};
+    std::atomic<int> bad{0};
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 3; ++r) {
+        readers.emplace_back([&]() {
+            while (!done.load()) {
+                // keys are never deleted, so every scan sees all of them
+                size_t rows = 0;
+                for (auto cursor = engine.newCursor(); cursor->valid(); cursor->next()) ++rows;
+                if (rows < 2000) bad.fetch_add(1);
+                if (!engine.get(key(1234))) bad.fetch_add(1);
+            }
+        });
+    }
+    for (int i = 0; i < 4000; ++i) engine.put(key(i % 3000), std::to_string(i) + std::string(i % 100, 'w'));
+    done = true;
+    for (auto& t : readers) t.join();
+    REQUIRE(bad.load() == 0);
+    REQUIRE(engine.getRange().size() == 3000);
+
+    fs::remove_all("data");
+    {
+        Database db(EngineType::BTREE);
+        db.put("k", "v");
+    }
+    REQUIRE(fs::exists(BTREE_PATH));
+    REQUIRE(Database(EngineType::BTREE).get("k") == "v");
+    fs::remove_all("data");
+}
@@ -0,0 +1,174 @@
+#include "catch2/catch_test_macros.hpp"
+#include "../src/storage/btree/buffer_manager.hpp"
+#include "../src/storage/btree/btree_engine.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const fs::path DIR = "data-buffers";
+
+// fills a page with a byte derived from its id and a version
+void fill(char* page, size_t pageSize, uint64_t id, int version) {
+    std::memset(page + 4, static_cast<int>('a' + (id * 7 + static_cast<uint64_t>(version)) % 26), pageSize - 4);
+}
+
+bool filled(const char* page, size_t pageSize, uint64_t id, int version) {
+    char expected = static_cast<char>('a' + (id * 7 + static_cast<uint64_t>(version)) % 26);
+    for (size_t i = 4; i < pageSize; ++i) {
+        if (page[i] != expected) return false;
+    }
+    return true;
+}
+
+} // namespace
+
+TEST_CASE("[buffer_manager]: pages outnumbering the frames are evicted and read back") {
+    fs::remove_all(DIR);
+    Pager pager(DIR / "pages.db", 4096);
+    BufferManager buffers(pager, 16, std::chrono::hours(1));
+
+    for (uint64_t id = 0; id < 100; ++id) {
+        auto page = buffers.create(pager.allocate());
+        fill(page.data(), 4096, id, 0);
+        page.markDirty();
+    }
+    auto stats = buffers.stats();
+    REQUIRE(stats.frames == 16);
+    REQUIRE(stats.evictions >= 84);
+    // dirty victims are written before their frames are reused
+    REQUIRE(stats.writes >= 84);
+
+    // a pinned page stays put while everything else cycles through
+    auto held = buffers.fetch(3);
+    for (int round = 0; round < 3; ++round) {
+        for (uint64_t id = 0; id < 100; ++id) {
+            auto page = buffers.fetch(id);
+            REQUIRE(filled(page.data(), 4096, id, 0));
+        }
+    }
+    REQUIRE(held.data() == buffers.fetch(3).data());
+    REQUIRE(buffers.stats().pinned == 1);
+    held.release();
+    REQUIRE(buffers.stats().pinned == 0);
+
+    // never more than a pool's worth of frames in use, even with every
+    // frame pinned: the next miss waits for an unpin
+    std::vector<BufferManager::PageRef> pins;
+    for (uint64_t id = 0; id < 16; ++id) pins.push_back(buffers.fetch(id));
+    std::atomic<bool> fetched{false};
+    std::thread waiter([&]() { fetched = filled(buffers.fetch(50).data(), 4096, 50, 0); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    REQUIRE(!fetched.load());
+    REQUIRE(buffers.stats().pinned == 16);
+    pins.pop_back();
+    waiter.join();
+    REQUIRE(fetched.load());
+}
+
+TEST_CASE("[buffer_manager]: dirty pages are written back in the background") {
+    fs::remove_all(DIR);
+    Pager pager(DIR / "pages.db", 4096);
+    BufferManager buffers(pager, 64, std::chrono::milliseconds(10));
+
+    for (uint64_t id = 0; id < 10; ++id) {
+        auto page = buffers.create(pager.allocate());
+        fill(page.data(), 4096, id, 1);
+        page.markDirty();
+    }
+    for (int i = 0; i < 200 && buffers.stats().dirty > 0; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    REQUIRE(buffers.stats().dirty == 0);
+    REQUIRE(buffers.stats().writes == 10);
+
+    // straight from the file, past the pool
+    std::vector<char> page(4096);
+    for (uint64_t id = 0; id < 10; ++id) {
+        pager.read(id, page.data());
+        REQUIRE(filled(page.data(), 4096, id, 1));
+    }
+}
+
+TEST_CASE("[buffer_manager]: a crash rolls the page file back to the last commit") {
+    fs::remove_all(DIR);
+    {
+        Pager pager(DIR / "pages.db", 4096);
+        BufferManager buffers(pager, 16, std::chrono::hours(1));
+        for (uint64_t id = 0; id < 20; ++id) {
+            auto page = buffers.create(pager.allocate());
+            fill(page.data(), 4096, id, 0);
+            page.markDirty();
+        }
+        buffers.flush();
+        pager.commit();
+        REQUIRE(!fs::exists(DIR / "pages.db-journal"));
+
+        // overwrite some pages, add others, and stop without committing
+        for (uint64_t id = 5; id < 10; ++id) {
+            auto page = buffers.fetch(id);
+            fill(page.data(), 4096, id, 1);
+            page.markDirty();
+        }
+        for (uint64_t id = 20; id < 25; ++id) {
+            auto page = buffers.create(pager.allocate());
+            fill(page.data(), 4096, id, 1);
+            page.markDirty();
+        }
+        buffers.flush();
+        REQUIRE(fs::exists(DIR / "pages.db-journal"));
+        REQUIRE(pager.pageCount() == 25);
+    }
+    // the destructors don't commit, so this is what a crash would leave
+
+    Pager pager(DIR / "pages.db", 4096);
+    REQUIRE(!fs::exists(DIR / "pages.db-journal"));
+    REQUIRE(pager.pageCount() == 20);
+    std::vector<char> page(4096);
+    for (uint64_t id = 0; id < 20; ++id) {
+        pager.read(id, page.data());
+        REQUIRE(filled(page.data(), 4096, id, 0));
+    }
+}
+
+TEST_CASE("[buffer_manager]: a B+tree many times the pool, with O_DIRECT") {
+    fs::remove_all(DIR);
+    REQUIRE_THROWS(Pager(DIR / "small.db", 512, true));
+
+    std::map<std::string, std::string> expected;
+    {
+        // 16 frames of 4 KiB against a few hundred pages of tree
+        BTreeEngine engine(DIR / "tree.db", 4096, 16 * 4096, true);
+        std::mt19937 rng(11);
+        for (int i = 0; i < 20000; ++i) {
+            std::string key = "key" + std::to_string(rng() % 5000);
+            std::string value = std::to_string(i) + std::string(rng() % 200, 'v');
+            if (i % 7 == 0) {
+                engine.remove(key);
+                expected.erase(key);
+            } else {
+                engine.put(key, value);
+                expected[key] = value;
+            }
+        }
+        auto stats = engine.bufferStats();
+        REQUIRE(stats.frames == 16);
+        REQUIRE(stats.evictions > 1000);
+        REQUIRE(stats.pinned == 0);
+        REQUIRE(engine.getRange() == std::vector<std::pair<std::string, std::string>>(expected.begin(), expected.end()));
+    }
+    {
+        BTreeEngine engine(DIR / "tree.db", 4096, 16 * 4096, true);
+        for (const auto& [key, value] : expected) REQUIRE(engine.get(key) == value);
+    }
+    fs::remove_all(DIR);
+}
@@ -1,5 +1,6 @@
 #include "catch2/catch_test_macros.hpp"
 #include "../src/storage/lsm/engine/lsm_engine.hpp"
+#include "../src/storage/lsm/sstable/segment_manager.hpp"
 #include "../src/storage/wal/wal.hpp"
 #include "../src/config.hpp"
 
@@ -7,25 +8,68 @@
 #include <cstdio>
 #include <string>
 
+static int countSegmentFiles(const std::string& dir) {
+    int datFiles = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+        if (entry.path().extension() == ".dat") datFiles++;
+    }
+    return datFiles;
+}
+
 TEST_CASE("[Compaction]: works in background thread") {
     std::string testSStableDir = "data/segments";
     std::filesystem::remove_all(testSStableDir);
 
-    LSMEngine engine("./wal", 5, 5000);
+    LSMEngine engine("./wal", 100);
 
     // insert enough keys to flush multiple segments
     for (int i = 0; i < 50; ++i) {
         engine.put("key" + std::to_string(i % 10), "val" + std::to_string(i));
     }
 
-    // wait for compaction thread to run
-    std::this_thread::sleep_for(std::chrono::milliseconds(6000));
+    // the compaction thread wakes up on flush; wait for it to drain L0
+    for (int i = 0; i < 50 && countSegmentFiles(testSStableDir) >= static_cast<int>(LSM_L0_COMPACTION_TRIGGER); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
 
-    // expect only 1 segment file to remain after compaction
-    int datFiles = 0;
-    for (const auto& entry : std::filesystem::directory_iterator(testSStableDir)) {
-        if (entry.path().extension() == ".dat") datFiles++;
+    // 10 flushes were merged down: fewer than a trigger's worth of L0 segments plus L1
+    REQUIRE(countSegmentFiles(testSStableDir) <= static_cast<int>(LSM_L0_COMPACTION_TRIGGER));
+    for (int i = 40; i < 50; ++i) {
+        REQUIRE(engine.get("key" + std::to_string(i % 10)).value() == "val" + std::to_string(i));
     }
+}
+
+TEST_CASE("[Compaction]: L0 merges into L1 and drops tombstones at the bottom") {
+    std::string dir = "data-leveled/segments";
+    std::filesystem::remove_all(dir);
+
+    SegmentManager sm;
+    sm.loadSegments(dir);
+    REQUIRE_FALSE(sm.needsCompaction());
+    REQUIRE_FALSE(sm.compact()); // idle when there is no work
+
+    for (size_t i = 0; i < LSM_L0_COMPACTION_TRIGGER; ++i) {
+        sm.flush({{"a", "a" + std::to_string(i)}, {"b", TOMBSTONE_MARKER}, {"c", "c" + std::to_string(i)}});
+    }
+    REQUIRE(sm.needsCompaction());
+    REQUIRE(sm.compact());
+
+    auto counts = sm.levelFileCounts();
+    REQUIRE(counts[0] == 0);
+    REQUIRE(counts[1] == 1);
+    REQUIRE_FALSE(sm.needsCompaction());
+
+    auto last = std::to_string(LSM_L0_COMPACTION_TRIGGER - 1);
+    REQUIRE(sm.get("a").value() == "a" + last);
+    REQUIRE_FALSE(sm.get("b").has_value());
+    REQUIRE(sm.get("c").value() == "c" + last);
 
-    REQUIRE(datFiles == 1); // all merged into 1 file
-}
\ No newline at end of file
+    // a newer L0 segment shadows L1, and the levels survive a reload
+    sm.flush({{"a", "newest"}});
+    SegmentManager reloaded;
+    reloaded.loadSegments(dir);
+    REQUIRE(reloaded.levelFileCounts()[0] == 1);
+    REQUIRE(reloaded.levelFileCounts()[1] == 1);
+    REQUIRE(reloaded.get("a").value() == "newest");
+    REQUIRE(reloaded.get("c").value() == "c" + last);
+}
@@ -0,0 +1,124 @@
+#include "catch2/catch_test_macros.hpp"
+#include "../src/storage/lsm/sstable/compression.hpp"
+#include "../src/storage/lsm/sstable/sstable_builder.hpp"
+#include "../src/storage/lsm/sstable/sstable_reader.hpp"
+#include "../src/common/utils/stats.hpp"
+
+#include <filesystem>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static std::string jsonValue(int i) {
+    return R"({"id":)" + std::to_string(i) + R"(,"name":"user)" + std::to_string(i % 97) +
+           R"(","active":true,"tags":["alpha","beta","gamma"],"score":)" + std::to_string(i * 7 % 1000) + "}";
+}
+
+TEST_CASE("[compression]: LZ round trips edge cases and real-looking data") {
+    const Codec* lz = codecFor(CompressionType::LZ);
+    REQUIRE(lz != nullptr);
+    REQUIRE(codecFor(CompressionType::NONE) == nullptr);
+
+    std::mt19937 gen(3);
+    std::string random(100000, '\0');
+    for (auto& c : random) c = static_cast<char>(gen());
+
+    std::string json;
+    for (int i = 0; i < 500; ++i) json += jsonValue(i);
+
+    std::vector<std::string> inputs = {
+        "", "a", "abcd", "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa",
+        std::string(200000, 'z'), random, json,
+        random.substr(0, 70000) + random.substr(0, 70000), // match just beyond the 64 KiB window
+    };
+    for (const auto& in : inputs) {
+        std::string compressed, out;
+        lz->compress(in, compressed);
+        REQUIRE(lz->decompress(compressed, out));
+        REQUIRE(out == in);
+    }
+
+    std::string compressed;
+    lz->compress(json, compressed);
+    REQUIRE(compressed.size() * 3 < json.size());
+}
+
+TEST_CASE("[compression]: corrupt LZ payloads are rejected, not overrun") {
+    const Codec* lz = codecFor(CompressionType::LZ);
+    std::string json;
+    for (int i = 0; i < 100; ++i) json += jsonValue(i);
+    std::string compressed, out;
+    lz->compress(json, compressed);
+
+    for (size_t len = 0; len < compressed.size(); ++len) {
+        REQUIRE_FALSE(lz->decompress(compressed.substr(0, len), out));
+    }
+    std::mt19937 gen(5);
+    for (int i = 0; i < 200; ++i) {
+        std::string damaged = compressed;
+        damaged[gen() % damaged.size()] ^= static_cast<char>(1 + gen() % 255);
+        if (lz->decompress(damaged, out)) REQUIRE(out.size() == json.size());
+    }
+
+    // a damaged size header claims far more than the payload can hold: no
+    // allocation is attempted, the block is just undecodable
+    for (uint64_t claimed : {uint64_t{1} << 62, uint64_t{1} << 40, uint64_t(compressed.size()) * 1000}) {
+        std::string header;
+        for (uint64_t v = claimed; ; v >>= 7) {
+            if (v < 0x80) {
+                header.push_back(static_cast<char>(v));
+                break;
+            }
+            header.push_back(static_cast<char>(v | 0x80));
+        }
+        REQUIRE(json.size() < (1 << 14)); // so its size takes two varint bytes
+        std::string damaged = header + compressed.substr(2);
+        REQUIRE_FALSE(lz->decompress(damaged, out));
+    }
+}
+
+TEST_CASE("[compression]: compressed segments are smaller and read back identically") {
+    fs::create_directories("data-compression");
+    auto build = [](const fs::path& path, CompressionType type) {
+        SSTableBuilder builder(path, 0, LSM_BLOOM_BITS_PER_KEY, type);
+        for (int i = 0; i < 3000; ++i) {
+            char key[16];
+            std::snprintf(key, sizeof(key), "user%06d", i);
+            builder.add(key, jsonValue(i));
+        }
+        return builder.finish();
+    };
+
+    auto& registry = StatsRegistry::process();
+    uint64_t rawBefore = registry.counter("lsm.compression.raw_bytes").value();
+    uint64_t decodedBefore = registry.histogram("lsm.compression.decode_nanos").snapshot().count();
+    uint64_t rawSize = build("data-compression/raw.dat", CompressionType::NONE);
+    uint64_t lzSize = build("data-compression/lz.dat", CompressionType::LZ);
+    REQUIRE(lzSize * 2 < rawSize);
+
+    auto raw = SSTableReader::open("data-compression/raw.dat");
+    for (bool useMmap : {false, true}) {
+        auto lz = SSTableReader::open("data-compression/lz.dat", std::make_shared<BlockCache>(1 << 20), useMmap);
+        REQUIRE(lz != nullptr);
+        REQUIRE(lz->entries() == raw->entries());
+        REQUIRE(lz->get("user001234").value() == jsonValue(1234));
+        REQUIRE(lz->get("user001234").value() == jsonValue(1234)); // served from the cache
+        REQUIRE_FALSE(lz->get("user999999").has_value());
+    }
+
+    REQUIRE(registry.counter("lsm.compression.raw_bytes").value() > rawBefore);
+    REQUIRE(registry.histogram("lsm.compression.decode_nanos").snapshot().count() > decodedBefore);
+    REQUIRE(registry.counter("lsm.compression.stored_bytes").value()
+            < registry.counter("lsm.compression.raw_bytes").value());
+    REQUIRE(registry.dump().find("lsm.compression.decode_nanos count=") != std::string::npos);
+}
+
+TEST_CASE("[compression]: per-level codec falls back to what was built") {
+    for (uint32_t level = 0; level < LSM_NUM_LEVELS; ++level) {
+        CompressionType type = compressionForLevel(level);
+        REQUIRE((type == CompressionType::NONE || codecFor(type) != nullptr));
+    }
+}
@@ -0,0 +1,30 @@
+#include "catch2/catch_test_macros.hpp"
+#include "../src/common/utils/crc32c.hpp"
+#include <string>
+#include <vector>
+
+TEST_CASE("[crc32c]: known values") {
+    // test vectors from RFC 3720, B.4
+    std::vector<uint8_t> zeros(32, 0x00), ones(32, 0xFF), ascending(32);
+    for (int i = 0; i < 32; ++i) ascending[i] = static_cast<uint8_t>(i);
+
+    REQUIRE(crc32c::value(zeros.data(), zeros.size()) == 0x8A9136AA);
+    REQUIRE(crc32c::value(ones.data(), ones.size()) == 0x62A8AB43);
+    REQUIRE(crc32c::value(ascending.data(), ascending.size()) == 0x46DD794E);
+
+    std::string check = "123456789";
+    REQUIRE(crc32c::value(check.data(), check.size()) == 0xE3069283);
+    REQUIRE(crc32c::value(nullptr, 0) == 0);
+}
+
+TEST_CASE("[crc32c]: extend matches a single pass at any split") {
+    std::string data;
+    for (int i = 0; i < 1000; ++i) data.push_back(static_cast<char>(i * 31 + 7));
+    uint32_t whole = crc32c::value(data.data(), data.size());
+
+    for (size_t split : {0, 1, 3, 8, 13, 500, 999, 1000}) {
+        uint32_t crc = crc32c::extend(0, data.data(), split);
+        crc = crc32c::extend(crc, data.data() + split, data.size() - split);
+        REQUIRE(crc == whole);
+    }
+}
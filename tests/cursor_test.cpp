@@ -0,0 +1,124 @@
+#include "catch2/catch_test_macros.hpp"
+#include "../src/storage/lsm/engine/lsm_engine.hpp"
+#include "../src/db/database.hpp"
+
+#include <filesystem>
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+using Rows = std::vector<std::pair<std::string, std::string>>;
+
+static Rows drain(Cursor& cursor, size_t limit = SIZE_MAX) {
+    Rows rows;
+    for (; cursor.valid() && rows.size() < limit; cursor.next()) rows.emplace_back(cursor.key(), cursor.value());
+    return rows;
+}
+
+static Rows expectedRange(const std::map<std::string, std::string>& model, const ScanOptions& options) {
+    Rows rows;
+    for (const auto& [k, v] : model) {
+        if (options.start && k < *options.start) continue;
+        if (options.end && k >= *options.end) continue;
+        rows.emplace_back(k, v);
+    }
+    if (options.reverse) std::reverse(rows.begin(), rows.end());
+    return rows;
+}
+
+static std::string keyFor(int i) {
+    char buf[16];
+    std::snprintf(buf, sizeof(buf), "key%05d", i);
+    return buf;
+}
+
+TEST_CASE("[cursor]: bounded forward and reverse scans match a model") {
+    std::filesystem::remove_all("data-cursor");
+    // a small memtable spreads the keys over segments, the immutable memtable and the active one
+    LSMEngine engine("data-cursor/db.wal", 2048, "data-cursor/segments");
+    std::map<std::string, std::string> model;
+    std::mt19937 gen(1);
+
+    for (int i = 0; i < 3000; ++i) {
+        std::string key = keyFor(gen() % 800);
+        if (gen() % 5 == 0) {
+            engine.remove(key);
+            model.erase(key);
+        } else {
+            std::string value = "v" + std::to_string(i);
+            engine.put(key, value);
+            model[key] = value;
+        }
+    }
+
+    for (bool reverse : {false, true}) {
+        ScanOptions all;
+        all.reverse = reverse;
+        auto cursor = engine.newCursor(all);
+        REQUIRE(drain(*cursor) == expectedRange(model, all));
+
+        for (int i = 0; i < 50; ++i) {
+            int a = gen() % 850, b = gen() % 850;
+            ScanOptions options;
+            options.reverse = reverse;
+            if (gen() % 4) options.start = keyFor(std::min(a, b));
+            if (gen() % 4) options.end = keyFor(std::max(a, b));
+            auto bounded = engine.newCursor(options);
+            REQUIRE(drain(*bounded) == expectedRange(model, options));
+        }
+    }
+}
+
+TEST_CASE("[cursor]: seek repositions within the bounds") {
+    std::filesystem::remove_all("data-cursor-seek");
+    LSMEngine engine("data-cursor-seek/db.wal", 512, "data-cursor-seek/segments");
+    for (int i = 0; i < 100; i += 2) engine.put(keyFor(i), std::to_string(i));
+
+    ScanOptions options;
+    options.start = keyFor(20);
+    options.end = keyFor(40);
+    auto cursor = engine.newCursor(options);
+    REQUIRE(cursor->key() == keyFor(20));
+
+    cursor->seek(keyFor(31));
+    REQUIRE(cursor->key() == keyFor(32));
+    cursor->seek(keyFor(0)); // clamped to start
+    REQUIRE(cursor->key() == keyFor(20));
+    cursor->seek(keyFor(40));
+    REQUIRE_FALSE(cursor->valid());
+
+    options.reverse = true;
+    auto reverse = engine.newCursor(options);
+    REQUIRE(reverse->key() == keyFor(38));
+    reverse->seek(keyFor(31));
+    REQUIRE(reverse->key() == keyFor(30));
+    reverse->seek(keyFor(99)); // clamped to end
+    REQUIRE(reverse->key() == keyFor(38));
+    reverse->seek(keyFor(19));
+    REQUIRE_FALSE(reverse->valid());
+}
+
+TEST_CASE("[cursor]: pages through a range via Database") {
+    std::filesystem::remove_all("data-cursor-page");
+    Database db(std::make_unique<LSMEngine>("data-cursor-page/db.wal", 1024, "data-cursor-page/segments"));
+    for (int i = 0; i < 500; ++i) db.put(keyFor(i), std::to_string(i));
+
+    // pages of 7 rows from key00100 up to key00200, each resuming after the last key seen
+    ScanOptions options;
+    options.start = keyFor(100);
+    options.end = keyFor(200);
+    Rows all;
+    while (true) {
+        auto cursor = db.newCursor(options);
+        auto page = drain(*cursor, 7);
+        if (page.empty()) break;
+        all.insert(all.end(), page.begin(), page.end());
+        options.start = page.back().first + '\0';
+    }
+    REQUIRE(all.size() == 100);
+    REQUIRE(all.front().first == keyFor(100));
+    REQUIRE(all.back().first == keyFor(199));
+}
@@ -0,0 +1,44 @@
+#include "catch2/catch_test_macros.hpp"
+#include "../src/common/utils/histogram.hpp"
+#include <cmath>
+
+TEST_CASE("[histogram]: percentiles stay within a bucket's precision") {
+    Histogram h;
+    REQUIRE(h.count() == 0);
+    REQUIRE(h.percentile(99) == 0.0);
+
+    for (uint64_t v = 1; v <= 100000; ++v) h.add(v);
+    REQUIRE(h.count() == 100000);
+    REQUIRE(h.min() == 1);
+    REQUIRE(h.max() == 100000);
+    REQUIRE(std::abs(h.mean() - 50000.5) < 1e-6);
+    for (double p : {50.0, 90.0, 99.0, 99.9}) {
+        double expected = p / 100.0 * 100000;
+        REQUIRE(std::abs(h.percentile(p) - expected) <= expected * 0.07);
+    }
+    REQUIRE(h.percentile(100) == 100000);
+
+    // small values are exact
+    Histogram small;
+    for (int i = 0; i < 10; ++i) small.add(3);
+    REQUIRE(small.percentile(50) == 3);
+    REQUIRE(small.percentile(99.9) == 3);
+}
+
+TEST_CASE("[histogram]: merging matches adding everything to one") {
+    Histogram a, b, all;
+    for (uint64_t v = 0; v < 1000; ++v) {
+        (v % 3 ? a : b).add(v * v);
+        all.add(v * v);
+    }
+    a.merge(b);
+    REQUIRE(a.count() == all.count());
+    REQUIRE(a.min() == all.min());
+    REQUIRE(a.max() == all.max());
+    REQUIRE(a.percentile(99) == all.percentile(99));
+    REQUIRE(a.summary() == all.summary());
+
+    a.clear();
+    REQUIRE(a.count() == 0);
+    REQUIRE(a.max() == 0);
+}
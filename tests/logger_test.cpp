@@ -0,0 +1,132 @@
+#include "catch2/catch_test_macros.hpp"
+#include "../src/common/containers/ring_buffer.hpp"
+#include "../src/common/utils/logger.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::string readFile(const std::filesystem::path& path) {
+    std::ifstream in(path);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+size_t countLines(const std::string& text, const std::string& needle) {
+    size_t count = 0;
+    for (size_t pos = text.find(needle); pos != std::string::npos; pos = text.find(needle, pos + 1)) ++count;
+    return count;
+}
+
+} // namespace
+
+TEST_CASE("[ring_buffer]: producers on many threads, one consumer") {
+    RingBuffer<uint64_t> ring(1000);
+    REQUIRE(ring.capacity() == 1024);
+
+    uint64_t v = 7;
+    REQUIRE(ring.tryPush(v));
+    REQUIRE(ring.tryPop() == 7);
+    REQUIRE(!ring.tryPop());
+
+    // fills up and refuses, then accepts again once drained
+    for (uint64_t i = 0; i < ring.capacity(); ++i) REQUIRE(ring.tryPush(i));
+    REQUIRE(!ring.tryPush(v));
+    for (uint64_t i = 0; i < ring.capacity(); ++i) REQUIRE(ring.tryPop() == i);
+
+    constexpr uint64_t PRODUCERS = 4, PER_PRODUCER = 50000;
+    std::vector<std::thread> producers;
+    for (uint64_t p = 0; p < PRODUCERS; ++p) {
+        producers.emplace_back([&ring, p]() {
+            for (uint64_t i = 0; i < PER_PRODUCER; ++i) {
+                uint64_t value = p * PER_PRODUCER + i;
+                while (!ring.tryPush(value)) std::this_thread::yield();
+            }
+        });
+    }
+
+    // each producer's values come out in the order it pushed them
+    std::vector<uint64_t> next(PRODUCERS, 0);
+    uint64_t popped = 0;
+    bool ordered = true;
+    while (popped < PRODUCERS * PER_PRODUCER) {
+        auto value = ring.tryPop();
+        if (!value) {
+            std::this_thread::yield();
+            continue;
+        }
+        uint64_t p = *value / PER_PRODUCER;
+        ordered = ordered && *value % PER_PRODUCER == next[p];
+        ++next[p];
+        ++popped;
+    }
+    for (auto& t : producers) t.join();
+    REQUIRE(ordered);
+    REQUIRE(!ring.tryPop());
+}
+
+TEST_CASE("[logger]: lines are filtered by level and written in the background") {
+    using namespace std::filesystem;
+    path file = "data-logger/log.txt";
+    remove_all(file.parent_path());
+    create_directories(file.parent_path());
+    int fd = ::open(file.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    REQUIRE(fd >= 0);
+
+    {
+        Logger logger(fd, 64, std::chrono::milliseconds(10));
+        logger.setLevel(LogLevel::INFO);
+        REQUIRE(!logger.enabled(LogLevel::DEBUG));
+        REQUIRE(logger.enabled(LogLevel::ERROR));
+
+        logger.log(LogLevel::INFO, "[Test] first");
+        logger.log(LogLevel::ERROR, "[Test] second");
+        // picked up by the writer without a flush
+        for (int i = 0; i < 200 && countLines(readFile(file), "[Test]") < 2; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        std::string text = readFile(file);
+        REQUIRE(text.find("INFO  [Test] first\n") != std::string::npos);
+        REQUIRE(text.find("ERROR [Test] second\n") != std::string::npos);
+        REQUIRE(text.find("[Test] first") < text.find("[Test] second"));
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([&logger, t]() {
+                for (int i = 0; i < 500; ++i) logger.log(LogLevel::INFO, "[Thread] " + std::to_string(t));
+            });
+        }
+        for (auto& t : threads) t.join();
+        logger.flush();
+
+        // every line is either written or counted as dropped
+        text = readFile(file);
+        size_t written = countLines(text, "[Thread] ");
+        REQUIRE(written + logger.dropped() == 2000);
+        if (logger.dropped() > 0) REQUIRE(text.find("[Log] Dropped") != std::string::npos);
+    }
+
+    ::close(fd);
+    remove_all(file.parent_path());
+}
+
+TEST_CASE("[logger]: lines below the compiled level cost nothing") {
+    int evaluated = 0;
+    auto count = [&evaluated]() { return ++evaluated; };
+    LOG_DEBUG("[Test] " << count());
+    REQUIRE(evaluated == (KVDB_LOG_LEVEL <= 0 ? 1 : 0));
+
+    // a level switched off at runtime isn't formatted either
+    Logger::process().setLevel(LogLevel::ERROR);
+    LOG_INFO("[Test] " << count());
+    Logger::process().setLevel(static_cast<LogLevel>(KVDB_LOG_LEVEL));
+    REQUIRE(evaluated == (KVDB_LOG_LEVEL <= 0 ? 1 : 0));
+}
@@ -3,8 +3,14 @@
 #include "../src/storage/wal/wal.hpp"
 #include "../src/config.hpp"
 
+#include <chrono>
 #include <filesystem>
+#include <fstream>
+#include <future>
+#include <memory>
 #include <cstdio>
+#include <thread>
+#include <vector>
 
 TEST_CASE("[lsm_engine]: WAL is correctly written by put/remove") {
     using namespace std;
@@ -12,7 +18,7 @@ TEST_CASE("[lsm_engine]: WAL is correctly written by put/remove") {
 
     // Setup
     path walPath = "data-engine/db.wal";
-    remove(walPath);
+    remove_all(walPath.parent_path());
 
     {
         LSMEngine engine(walPath);
@@ -22,25 +28,25 @@ TEST_CASE("[lsm_engine]: WAL is correctly written by put/remove") {
     }
 
     // read back WAL manually
-    FILE* fp = std::fopen(walPath.string().c_str(), "rb");
-    REQUIRE(fp != nullptr);
+    std::vector<WalRecord> records;
+    WAL wal(walPath);
+    wal.replay([&](const WalRecord& rec) { records.push_back(rec); });
+    REQUIRE(records.size() == 3);
 
-    WalRecord r1 = WalRecord::deserialize(fp).value();
+    const WalRecord& r1 = records[0];
     REQUIRE(r1.opType == OpType::CREATE);
     REQUIRE(r1.key == "a");
     REQUIRE(r1.value == "apple");
 
-    WalRecord r2 = WalRecord::deserialize(fp).value();
+    const WalRecord& r2 = records[1];
     REQUIRE(r2.opType == OpType::CREATE);
     REQUIRE(r2.key == "b");
     REQUIRE(r2.value == "banana");
 
-    WalRecord r3 = WalRecord::deserialize(fp).value();
+    const WalRecord& r3 = records[2];
     REQUIRE(r3.opType == OpType::DELETE);
     REQUIRE(r3.key == "a");
     REQUIRE(r3.value == "");
-
-    std::fclose(fp);
 }
 
 TEST_CASE("[lsm_engine]: WAL replay on recovery") {
@@ -71,4 +77,127 @@ TEST_CASE("[lsm_engine]: WAL replay on recovery") {
         REQUIRE(valB.has_value());
         REQUIRE(valB.value() == "banana");
     }
-}
\ No newline at end of file
+}
+
+TEST_CASE("[lsm_engine]: reads see the immutable memtable and recovery keeps the last write") {
+    using namespace std;
+    using namespace std::filesystem;
+
+    path walPath = "data-rotate/db.wal";
+    remove_all(walPath.parent_path());
+
+    {
+        // a 64 byte memtable is sealed, with its WAL, every few writes
+        LSMEngine engine(walPath, 64, "data-rotate/segments");
+        for (int i = 0; i < 50; ++i) {
+            engine.put("k" + to_string(i % 7), "v" + to_string(i));
+            REQUIRE(engine.get("k" + to_string(i % 7)).value() == "v" + to_string(i));
+        }
+        engine.remove("k0");
+        REQUIRE(!engine.get("k0").has_value());
+        REQUIRE(engine.getRange().size() == 6);
+    }
+
+    {
+        LSMEngine engine(walPath, 64, "data-rotate/segments");
+        REQUIRE(!engine.get("k0").has_value());
+        // the last writes to k6 and k1 were i = 48 and i = 43
+        REQUIRE(engine.get("k6").value() == "v48");
+        REQUIRE(engine.get("k1").value() == "v43");
+        REQUIRE(engine.getRange().size() == 6);
+    }
+}
+
+TEST_CASE("[lsm_engine]: concurrent writers across memtable swaps") {
+    using namespace std;
+    using namespace std::filesystem;
+
+    path walPath = "data-concurrent/db.wal";
+    remove_all(walPath.parent_path());
+
+    constexpr int THREADS = 4;
+    constexpr int PER_THREAD = 300;
+    {
+        LSMEngine engine(walPath, 2048, "data-concurrent/segments");
+        vector<thread> writers;
+        for (int t = 0; t < THREADS; ++t) {
+            writers.emplace_back([&engine, t]() {
+                for (int i = 0; i < PER_THREAD; ++i) {
+                    engine.put("t" + to_string(t) + "-" + to_string(i), to_string(i));
+                }
+            });
+        }
+        for (auto& w : writers) w.join();
+        REQUIRE(engine.getRange().size() == THREADS * PER_THREAD);
+    }
+
+    // whatever was still in a memtable comes back from the WAL
+    LSMEngine engine(walPath, 2048, "data-concurrent/segments");
+    for (int t = 0; t < THREADS; ++t) {
+        for (int i = 0; i < PER_THREAD; ++i) {
+            REQUIRE(engine.get("t" + to_string(t) + "-" + to_string(i)).value() == to_string(i));
+        }
+    }
+}
+
+TEST_CASE("[lsm_engine]: memtables flush on bytes and under a shared memory budget") {
+    using namespace std;
+    using namespace std::filesystem;
+
+    auto segmentFiles = [](const path& dir) {
+        size_t n = 0;
+        for (const auto& entry : directory_iterator(dir)) n += entry.path().extension() == ".dat";
+        return n;
+    };
+
+    remove_all("data-bytes");
+    {
+        // a few large values fill a 64 KiB memtable long before any entry count would
+        LSMEngine engine("data-bytes/a.wal", 64 * 1024, "data-bytes/a");
+        for (int i = 0; i < 8; ++i) engine.put("big" + to_string(i), string(20 * 1024, 'x'));
+    }
+    REQUIRE(segmentFiles("data-bytes/a") >= 2);
+
+    auto budget = make_shared<MemoryBudget>(32 * 1024);
+    {
+        // the memtable budget alone would never flush; the shared budget does
+        LSMEngine engine("data-bytes/b.wal", 16 * 1024 * 1024, "data-bytes/b", 0, budget);
+        for (int i = 0; i < 40; ++i) engine.put("k" + to_string(i), string(4 * 1024, 'y'));
+        REQUIRE(engine.get("k7").value().size() == 4 * 1024);
+    }
+    REQUIRE(segmentFiles("data-bytes/b") >= 2);
+    REQUIRE(budget->usage() == 0);
+}
+
+TEST_CASE("[lsm_engine]: a failed flush is retried by a later write, not by a sleeping worker") {
+    using namespace std;
+    using namespace std::filesystem;
+
+    remove_all("data-flush-retry");
+    auto pool = make_shared<ThreadPool>(1);
+    LSMEngine engine("data-flush-retry/db.wal", 1024, "data-flush-retry/segments", 0, nullptr, pool);
+    // the pool's only worker is free again once it has run everything queued before
+    auto poolDrains = [&pool]() {
+        auto done = make_shared<promise<void>>();
+        auto drained = done->get_future();
+        pool->submit(ThreadPool::Priority::NORMAL, [done]() { done->set_value(); });
+        return drained.wait_for(chrono::seconds(3)) == future_status::ready;
+    };
+
+    // no segment can be created while the directory is a file
+    remove_all("data-flush-retry/segments");
+    ofstream("data-flush-retry/segments") << "x";
+    for (int i = 0; i < 6; ++i) engine.put("k" + to_string(i), string(200, 'v')); // one memtable swap
+    REQUIRE(poolDrains());
+
+    remove("data-flush-retry/segments");
+    create_directories("data-flush-retry/segments");
+    this_thread::sleep_for(chrono::milliseconds(1100));
+    engine.put("after", "x");
+    REQUIRE(poolDrains());
+
+    size_t segments = 0;
+    for (const auto& entry : directory_iterator("data-flush-retry/segments")) segments += entry.path().extension() == ".dat";
+    REQUIRE(segments == 1);
+    REQUIRE(engine.get("k0").value() == string(200, 'v'));
+}
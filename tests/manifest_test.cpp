@@ -0,0 +1,250 @@
+#include "catch2/catch_test_macros.hpp"
+#include "../src/storage/lsm/sstable/manifest.hpp"
+#include "../src/storage/lsm/sstable/segment_manager.hpp"
+#include "../src/storage/lsm/sstable/sstable_builder.hpp"
+#include "../src/common/utils/coding.hpp"
+
+#include <csignal>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include <sys/resource.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+VersionEdit::NewSegment segment(uint64_t number, uint32_t level, std::string smallest, std::string largest) {
+    return {number, {level, 1000 + number, 10 * number, std::move(smallest), std::move(largest)}};
+}
+
+} // namespace
+
+TEST_CASE("[manifest]: edits round trip and rebuild the live set") {
+    fs::path dir = "data-manifest/edits";
+    fs::remove_all(dir);
+
+    VersionEdit edit;
+    edit.added = {segment(1, 0, "a", "m"), segment(2, 1, "", "z")};
+    edit.removed = {7};
+    edit.nextFileNumber = 9;
+    auto decoded = VersionEdit::decode(edit.encode());
+    REQUIRE(decoded);
+    REQUIRE(decoded->added.size() == 2);
+    REQUIRE(decoded->added[1].metadata.smallestKey.empty());
+    REQUIRE(decoded->added[1].metadata.largestKey == "z");
+    REQUIRE(decoded->removed == std::vector<uint64_t>{7});
+    REQUIRE(decoded->nextFileNumber == 9);
+    REQUIRE_FALSE(VersionEdit::decode(edit.encode().substr(0, 20)));
+
+    {
+        Manifest manifest(dir);
+        REQUIRE_FALSE(manifest.existed());
+        uint64_t n1 = manifest.newFileNumber();
+        uint64_t n2 = manifest.newFileNumber();
+        manifest.apply({{segment(n1, 0, "a", "c"), segment(n2, 0, "b", "d")}, {}});
+        uint64_t n3 = manifest.newFileNumber();
+        manifest.apply({{segment(n3, 1, "a", "d")}, {n1, n2}});
+    }
+
+    Manifest manifest(dir);
+    REQUIRE(manifest.existed());
+    auto live = manifest.segments();
+    REQUIRE(live.size() == 1);
+    REQUIRE(live.begin()->second.level == 1);
+    REQUIRE(live.begin()->second.largestKey == "d");
+    // numbers are never handed out twice, even across restarts
+    REQUIRE(manifest.newFileNumber() > live.begin()->first);
+}
+
+TEST_CASE("[manifest]: a torn last edit is dropped, earlier damage throws") {
+    fs::path dir = "data-manifest/torn";
+    fs::remove_all(dir);
+    {
+        Manifest manifest(dir);
+        manifest.apply({{segment(1, 0, "a", "b")}, {}});
+        manifest.apply({{segment(2, 0, "c", "d")}, {}});
+    }
+    auto path = dir / "MANIFEST";
+    auto size = fs::file_size(path);
+
+    SECTION("torn") {
+        fs::resize_file(path, size - 5);
+        {
+            Manifest manifest(dir);
+            REQUIRE(manifest.segments().size() == 1);
+            // appends continue after the last good edit
+            manifest.apply({{segment(3, 0, "e", "f")}, {}});
+        }
+        Manifest manifest(dir);
+        REQUIRE(manifest.segments().size() == 2);
+        REQUIRE(manifest.segments().count(3));
+    }
+
+    SECTION("corrupt") {
+        std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+        f.seekp(12);
+        f.put('#');
+        f.close();
+        REQUIRE_THROWS_AS(Manifest(dir), std::runtime_error);
+    }
+}
+
+TEST_CASE("[manifest]: a failed append is cut off before the next edit") {
+    fs::path dir = "data-manifest/failed";
+    fs::remove_all(dir);
+    {
+        Manifest manifest(dir);
+        manifest.apply({{segment(1, 0, "a", "b")}, {}});
+
+        // a file size limit a few bytes past the end makes the next write come up short
+        auto size = fs::file_size(dir / "MANIFEST");
+        rlimit saved{};
+        ::getrlimit(RLIMIT_FSIZE, &saved);
+        auto previousHandler = std::signal(SIGXFSZ, SIG_IGN);
+        rlimit limited = saved;
+        limited.rlim_cur = size + 5;
+        ::setrlimit(RLIMIT_FSIZE, &limited);
+        REQUIRE_THROWS_AS(manifest.apply({{segment(2, 0, "c", std::string(100, 'd'))}, {}}), std::runtime_error);
+        ::setrlimit(RLIMIT_FSIZE, &saved);
+        std::signal(SIGXFSZ, previousHandler);
+        REQUIRE(fs::file_size(dir / "MANIFEST") == size);
+
+        manifest.apply({{segment(3, 0, "e", "f")}, {}});
+    }
+    Manifest manifest(dir);
+    auto live = manifest.segments();
+    REQUIRE(live.size() == 2);
+    REQUIRE(live.count(3));
+}
+
+TEST_CASE("[manifest]: a large log is rewritten as a snapshot") {
+    fs::path dir = "data-manifest/rewrite";
+    fs::remove_all(dir);
+    {
+        Manifest manifest(dir, 512);
+        for (uint64_t n = 1; n <= 100; ++n) {
+            VersionEdit edit;
+            edit.added.push_back(segment(n, 1, "k" + std::to_string(n), "k" + std::to_string(n)));
+            if (n > 1) edit.removed.push_back(n - 1);
+            manifest.apply(std::move(edit));
+            REQUIRE(fs::file_size(dir / "MANIFEST") <= 512 + 128);
+        }
+    }
+    Manifest manifest(dir);
+    auto live = manifest.segments();
+    REQUIRE(live.size() == 1);
+    REQUIRE(live.begin()->first == 100);
+}
+
+TEST_CASE("[manifest]: SegmentManager opens from the manifest and drops orphans") {
+    fs::path dir = "data-manifest/segments";
+    fs::remove_all(dir);
+    {
+        SegmentManager sm;
+        sm.loadSegments(dir);
+        sm.flush({{"a", "1"}, {"b", "2"}});
+        sm.flush({{"a", "3"}});
+    }
+
+    // a segment written by a flush that crashed before its manifest edit
+    fs::path orphan = dir / "segment_999.dat";
+    {
+        SSTableBuilder builder(orphan);
+        builder.add("a", "orphan");
+        builder.finish();
+    }
+
+    SegmentManager sm;
+    sm.loadSegments(dir);
+    REQUIRE_FALSE(fs::exists(orphan));
+    REQUIRE(sm.levelFileCounts()[0] == 2);
+    REQUIRE(sm.get("a").value() == "3");
+    REQUIRE(sm.get("b").value() == "2");
+
+    // new segments are numbered past everything seen so far
+    sm.flush({{"c", "4"}});
+    SegmentManager reloaded;
+    reloaded.loadSegments(dir);
+    REQUIRE(reloaded.get("c").value() == "4");
+    REQUIRE(reloaded.levelFileCounts()[0] == 3);
+}
+
+TEST_CASE("[manifest]: a directory without a manifest is scanned once") {
+    fs::path dir = "data-manifest/legacy";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    {
+        SSTableBuilder builder(dir / "segment_1700000000000.dat");
+        builder.add("k", "old");
+        builder.finish();
+    }
+    {
+        SSTableBuilder builder(dir / "segment_1700000000001.dat");
+        builder.add("k", "new");
+        builder.finish();
+    }
+
+    {
+        SegmentManager sm;
+        sm.loadSegments(dir);
+        REQUIRE(fs::exists(dir / "MANIFEST"));
+        REQUIRE(sm.get("k").value() == "new");
+        sm.flush({{"k", "newest"}});
+    }
+
+    SegmentManager sm;
+    sm.loadSegments(dir);
+    REQUIRE(sm.levelFileCounts()[0] == 3);
+    REQUIRE(sm.get("k").value() == "newest");
+}
+
+TEST_CASE("[manifest]: segments from before the block format are migrated, not dropped") {
+    fs::path dir = "data-manifest-legacy";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+
+    // the original flat layout: [4B key size][key][4B value size][value]
+    auto writeFlat = [](const fs::path& path, const std::vector<std::pair<std::string, std::string>>& records) {
+        std::string data;
+        for (const auto& [key, value] : records) {
+            coding::putBytes(data, key);
+            coding::putBytes(data, value);
+        }
+        std::ofstream(path, std::ios::binary) << data;
+    };
+    writeFlat(dir / "segment_1700000000000.dat", {{"a", "1"}, {"b", "old"}, {"c", "3"}});
+    writeFlat(dir / "segment_1700000000001.dat", {{"b", "new"}, {"d", "4"}, {"d", "4b"}});
+
+    {
+        SegmentManager sm;
+        sm.loadSegments(dir);
+        REQUIRE(sm.get("a").value() == "1");
+        REQUIRE(sm.get("b").value() == "new");
+        REQUIRE(sm.get("d").value() == "4b");
+    }
+
+    // migrated in place, so the next open finds them in the manifest
+    SegmentManager sm;
+    sm.loadSegments(dir);
+    REQUIRE(fs::exists(dir / "segment_1700000000000.dat"));
+    REQUIRE(sm.levelFileCounts()[0] == 2);
+    REQUIRE(sm.getRange().size() == 4);
+    REQUIRE(sm.get("b").value() == "new");
+}
+
+TEST_CASE("[manifest]: an unreadable segment stops the open instead of being dropped") {
+    fs::path dir = "data-manifest-unreadable";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    std::ofstream(dir / "segment_1.dat", std::ios::binary) << "not a segment";
+
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        SegmentManager sm;
+        REQUIRE_THROWS(sm.loadSegments(dir));
+    }
+    REQUIRE(fs::exists(dir / "segment_1.dat"));
+}
@@ -53,3 +53,25 @@ TEST_CASE("[memtable]: Basic put/get/remove operations") {
         REQUIRE(entries[2].first == "c");
     }
 }
+
+
+TEST_CASE("[memtable]: byte size and memory budget") {
+    auto budget = std::make_shared<MemoryBudget>(1024 * 1024);
+    {
+        Memtable mem(budget);
+        REQUIRE(mem.dataSize() == 0);
+
+        mem.put("a", std::string(1000, 'x'));
+        size_t one = mem.dataSize();
+        REQUIRE(one > 1000);
+
+        // overwrites and tombstones take space too, the old value stays in the arena
+        mem.put("a", std::string(1000, 'y'));
+        mem.remove("a");
+        REQUIRE(mem.dataSize() > one + 1000);
+
+        REQUIRE(mem.memoryUsage() >= mem.dataSize());
+        REQUIRE(budget->usage() == mem.memoryUsage());
+    }
+    REQUIRE(budget->usage() == 0);
+}
@@ -0,0 +1,89 @@
+#include "catch2/catch_test_macros.hpp"
+#include "../src/storage/lsm/iterator/merging_iterator.hpp"
+#include "../src/storage/lsm/memtable/memtable.hpp"
+#include "../src/config.hpp"
+#include <string>
+#include <vector>
+
+static std::vector<std::pair<std::string, std::string>> drain(KVIterator& it) {
+    std::vector<std::pair<std::string, std::string>> out;
+    for (; it.valid(); it.next()) out.emplace_back(it.key(), it.value());
+    return out;
+}
+
+TEST_CASE("[merging_iterator]: merges sorted inputs and newest wins") {
+    Memtable newer, older;
+    older.put("a", "old-a");
+    older.put("c", "old-c");
+    older.put("e", "old-e");
+    newer.put("b", "new-b");
+    newer.put("c", "new-c");
+    newer.remove("e");
+
+    std::vector<std::unique_ptr<KVIterator>> children;
+    children.push_back(newer.newIterator());
+    children.push_back(older.newIterator());
+    MergingIterator it(std::move(children));
+
+    it.seekToFirst();
+    auto all = drain(it);
+    REQUIRE(all.size() == 4);
+    REQUIRE(all[0] == std::make_pair(std::string("a"), std::string("old-a")));
+    REQUIRE(all[1] == std::make_pair(std::string("b"), std::string("new-b")));
+    REQUIRE(all[2] == std::make_pair(std::string("c"), std::string("new-c")));
+    REQUIRE(all[3].first == "e");
+    REQUIRE(all[3].second == TOMBSTONE_MARKER); // tombstones are left to the caller
+}
+
+TEST_CASE("[merging_iterator]: seek positions every child") {
+    Memtable first, second;
+    for (int i = 0; i < 10; i += 2) first.put("k" + std::to_string(i), "first");
+    for (int i = 1; i < 10; i += 2) second.put("k" + std::to_string(i), "second");
+
+    std::vector<std::unique_ptr<KVIterator>> children;
+    children.push_back(first.newIterator());
+    children.push_back(second.newIterator());
+    MergingIterator it(std::move(children));
+
+    it.seek("k5");
+    auto rest = drain(it);
+    REQUIRE(rest.size() == 5);
+    REQUIRE(rest.front().first == "k5");
+    REQUIRE(rest.front().second == "second");
+    REQUIRE(rest.back().first == "k9");
+
+    it.seek("zzz");
+    REQUIRE_FALSE(it.valid());
+}
+
+TEST_CASE("[merging_iterator]: reverse iteration and direction changes") {
+    Memtable newer, older;
+    for (int i = 0; i < 10; ++i) older.put("k" + std::to_string(i), "old");
+    for (int i = 0; i < 10; i += 3) newer.put("k" + std::to_string(i), "new");
+
+    std::vector<std::unique_ptr<KVIterator>> children;
+    children.push_back(newer.newIterator());
+    children.push_back(older.newIterator());
+    MergingIterator it(std::move(children));
+
+    std::vector<std::pair<std::string, std::string>> backward;
+    for (it.seekToLast(); it.valid(); it.prev()) backward.emplace_back(it.key(), it.value());
+    REQUIRE(backward.size() == 10);
+    REQUIRE(backward.front() == std::make_pair(std::string("k9"), std::string("new")));
+    REQUIRE(backward[1] == std::make_pair(std::string("k8"), std::string("old")));
+    REQUIRE(backward.back() == std::make_pair(std::string("k0"), std::string("new")));
+
+    it.seekForPrev("k45");
+    REQUIRE(it.key() == "k4");
+    it.next(); // switch to forward
+    REQUIRE(it.key() == "k5");
+    it.next();
+    REQUIRE(it.key() == "k6");
+    REQUIRE(it.value() == "new");
+    it.prev(); // and back again, without returning the shadowed k6
+    REQUIRE(it.key() == "k5");
+    it.prev();
+    REQUIRE(it.key() == "k4");
+    it.next();
+    REQUIRE(it.key() == "k5");
+}
@@ -0,0 +1,291 @@
+#include "catch2/catch_test_macros.hpp"
+#include "../src/server/server.hpp"
+#include "../src/server/binary_protocol.hpp"
+#include "../src/storage/lsm/engine/lsm_engine.hpp"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const std::string SOCKET_PATH = "data-server/db.sock";
+
+// these run on client threads too, where catch assertions aren't allowed;
+// a failure shows up as a missing reply instead
+int connectClient() {
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, SOCKET_PATH.c_str(), sizeof(addr.sun_path) - 1);
+    ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    return fd;
+}
+
+void sendAll(int fd, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = ::write(fd, data.data() + sent, data.size() - sent);
+        if (n <= 0) return;
+        sent += static_cast<size_t>(n);
+    }
+}
+
+// reads until lines newlines arrived, or until EOF when lines is 0
+std::string readReply(int fd, size_t lines = 0) {
+    std::string out;
+    char buf[4096];
+    while (lines == 0 || static_cast<size_t>(std::count(out.begin(), out.end(), '\n')) < lines) {
+        ssize_t n = ::read(fd, buf, sizeof(buf));
+        if (n <= 0) break;
+        out.append(buf, static_cast<size_t>(n));
+    }
+    return out;
+}
+
+struct Response {
+    binary_protocol::Status status;
+    std::string body;
+};
+
+// reads count response frames, fewer if the server hangs up first
+std::vector<Response> readFrames(int fd, size_t count) {
+    std::vector<Response> out;
+    std::string buf;
+    char chunk[4096];
+    while (out.size() < count) {
+        binary_protocol::Frame frame;
+        size_t consumed = 0;
+        if (binary_protocol::parse(buf, SIZE_MAX, frame, consumed) == binary_protocol::ParseResult::FRAME) {
+            out.push_back({static_cast<binary_protocol::Status>(frame.code), std::string(frame.body)});
+            buf.erase(0, consumed);
+            continue;
+        }
+        ssize_t n = ::read(fd, chunk, sizeof(chunk));
+        if (n <= 0) break;
+        buf.append(chunk, static_cast<size_t>(n));
+    }
+    return out;
+}
+
+struct ServerFixture {
+    ServerFixture(int workers = 3) {
+        std::filesystem::remove_all("data-server");
+        std::filesystem::create_directories("data-server");
+        db = std::make_unique<Database>(std::make_unique<LSMEngine>(
+            "data-server/db.wal", LSM_MEMTABLE_BYTES, "data-server/segments"));
+        ServerOptions options;
+        options.socketPath = SOCKET_PATH;
+        options.workers = workers;
+        options.backlog = 64;
+        server = std::make_unique<Server>(*db, options);
+        server->start();
+    }
+    ~ServerFixture() {
+        server.reset();
+        db.reset();
+    }
+
+    std::unique_ptr<Database> db;
+    std::unique_ptr<Server> server;
+};
+
+} // namespace
+
+TEST_CASE("[server]: persistent connections serve pipelined requests concurrently") {
+    ServerFixture fixture;
+
+    constexpr int CLIENTS = 8;
+    constexpr int REQUESTS = 200;
+    std::vector<std::string> replies(CLIENTS);
+    std::vector<std::thread> threads;
+    for (int c = 0; c < CLIENTS; ++c) {
+        threads.emplace_back([&replies, c]() {
+            int fd = connectClient();
+            // every request goes out before the first reply is read
+            std::string requests;
+            for (int i = 0; i < REQUESTS; ++i) {
+                requests += "put c" + std::to_string(c) + "k" + std::to_string(i) + " v" + std::to_string(i) + "\n";
+                requests += "get c" + std::to_string(c) + "k" + std::to_string(i) + "\n";
+            }
+            sendAll(fd, requests);
+            replies[c] = readReply(fd, 2 * REQUESTS);
+            ::close(fd);
+        });
+    }
+    for (auto& t : threads) t.join();
+
+    for (int c = 0; c < CLIENTS; ++c) {
+        std::string expected;
+        for (int i = 0; i < REQUESTS; ++i) {
+            std::string key = "c" + std::to_string(c) + "k" + std::to_string(i);
+            std::string value = "v" + std::to_string(i);
+            expected += "Inserted " + key + ": " + value + "\n" + key + ": " + value + "\n";
+        }
+        REQUIRE(replies[c] == expected);
+    }
+}
+
+TEST_CASE("[server]: requests split across writes, quit and half-closed clients") {
+    ServerFixture fixture(1);
+
+    int fd = connectClient();
+    sendAll(fd, "put sp");
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    sendAll(fd, "lit value\r\nget split\n");
+    REQUIRE(readReply(fd, 2) == "Inserted split: value\nsplit: value\n");
+
+    // quit hangs up after the replies before it
+    sendAll(fd, "get split\nquit\nget split\n");
+    REQUIRE(readReply(fd) == "split: value\n");
+    ::close(fd);
+
+    // a last request without a newline still runs once the client stops writing
+    fd = connectClient();
+    sendAll(fd, "get split");
+    ::shutdown(fd, SHUT_WR);
+    REQUIRE(readReply(fd) == "split: value\n");
+    ::close(fd);
+}
+
+TEST_CASE("[server]: replies larger than the socket buffer are sent in full") {
+    ServerFixture fixture;
+
+    std::string value(1000, 'x');
+    for (int i = 0; i < 2000; ++i) fixture.db->put("key" + std::to_string(i), value);
+
+    int fd = connectClient();
+    sendAll(fd, "getall\ngetall\nquit\n");
+    std::string reply = readReply(fd);
+    ::close(fd);
+
+    std::string expected;
+    for (const auto& [k, v] : fixture.db->getRange()) expected += k + ": " + v + "\n";
+    REQUIRE(expected.size() > 2 * 1000 * 1000);
+    REQUIRE(reply == expected + expected);
+
+    for (int i = 0; i < 100 && fixture.server->connectionCount() > 0; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    REQUIRE(fixture.server->connectionCount() == 0);
+}
+
+TEST_CASE("[server]: binary protocol pipelines arbitrary keys and values") {
+    using binary_protocol::Status;
+    ServerFixture fixture;
+
+    // spaces, newlines and NULs are fine, and so is a value far past 1 KB
+    std::string spaced = "a key with spaces\n";
+    std::string binary("v\0al\xDB", 5);
+    std::string large(256 * 1024, 'L');
+
+    int fd = connectClient();
+    std::string requests;
+    requests += binary_protocol::put(spaced, binary);
+    requests += binary_protocol::put("large", large);
+    for (int i = 0; i < 500; ++i) requests += binary_protocol::put("k" + std::to_string(i), "v" + std::to_string(i));
+    requests += binary_protocol::get(spaced);
+    requests += binary_protocol::get("large");
+    requests += binary_protocol::get("missing");
+    requests += binary_protocol::remove("k0");
+    requests += binary_protocol::multiGet({"k0", "k1", spaced, "k499"});
+    sendAll(fd, requests);
+
+    auto responses = readFrames(fd, 507);
+    REQUIRE(responses.size() == 507);
+    for (size_t i = 0; i < 502; ++i) REQUIRE(responses[i].status == Status::OK);
+    REQUIRE(responses[502].body == binary);
+    REQUIRE(responses[503].body == large);
+    REQUIRE(responses[504].status == Status::NOT_FOUND);
+    REQUIRE(responses[505].status == Status::OK);
+
+    auto values = binary_protocol::decodeMultiGet(responses[506].body);
+    REQUIRE(values);
+    REQUIRE(values->size() == 4);
+    REQUIRE(!(*values)[0]);
+    REQUIRE((*values)[1] == "v1");
+    REQUIRE((*values)[2] == binary);
+    REQUIRE((*values)[3] == "v499");
+
+    // a batch is one frame and lands atomically; scans return raw rows
+    WriteBatch batch;
+    batch.put("scan a", "1");
+    batch.put("scan b", "2");
+    batch.put("scan c", "3");
+    batch.remove("scan b");
+    ScanOptions options;
+    options.start = "scan ";
+    options.end = "scan z";
+    options.reverse = true;
+    sendAll(fd, binary_protocol::write(batch) + binary_protocol::scan(options, 10) + binary_protocol::quit());
+
+    responses = readFrames(fd, 4);
+    REQUIRE(responses.size() == 3);
+    REQUIRE(responses[0].status == Status::OK);
+    auto rows = binary_protocol::decodeScan(responses[1].body);
+    REQUIRE(rows);
+    REQUIRE(*rows == std::vector<std::pair<std::string, std::string>>{{"scan c", "3"}, {"scan a", "1"}});
+    REQUIRE(responses[2].status == Status::OK);
+    ::close(fd);
+}
+
+TEST_CASE("[server]: binary protocol rejects bad requests") {
+    using binary_protocol::Status;
+    ServerFixture fixture(1);
+
+    int fd = connectClient();
+    // a body that doesn't decode is answered and skipped
+    std::string truncatedPut;
+    binary_protocol::appendFrame(truncatedPut, static_cast<uint8_t>(binary_protocol::Op::PUT),
+                                std::string_view("\x05\0\0\0ab", 6));
+    std::string unknownOp;
+    binary_protocol::appendFrame(unknownOp, 99, "");
+    sendAll(fd, truncatedPut + unknownOp + binary_protocol::put("k", "v") + binary_protocol::get("k"));
+
+    auto responses = readFrames(fd, 4);
+    REQUIRE(responses.size() == 4);
+    REQUIRE(responses[0].status == Status::ERROR);
+    REQUIRE(responses[0].body == "malformed request");
+    REQUIRE(responses[1].status == Status::ERROR);
+    REQUIRE(responses[2].status == Status::OK);
+    REQUIRE(responses[3].body == "v");
+
+    // a value that would read back as a tombstone is refused, alone or in a batch
+    WriteBatch batch;
+    batch.put("b", "ok");
+    batch.put("k", std::string(TOMBSTONE_MARKER) + "x");
+    sendAll(fd, binary_protocol::put("k", TOMBSTONE_MARKER) + binary_protocol::write(batch)
+                + binary_protocol::get("k") + binary_protocol::get("b"));
+    responses = readFrames(fd, 4);
+    REQUIRE(responses.size() == 4);
+    REQUIRE(responses[0].status == Status::ERROR);
+    REQUIRE(responses[1].status == Status::ERROR);
+    REQUIRE(responses[2].body == "v");
+    REQUIRE(responses[3].status == Status::NOT_FOUND);
+
+    // a broken header can't be skipped: the server answers and hangs up
+    sendAll(fd, "get k\n");
+    responses = readFrames(fd, 2);
+    REQUIRE(responses.size() == 1);
+    REQUIRE(responses[0].status == Status::ERROR);
+    ::close(fd);
+
+    // so does a frame over the request limit, without waiting for its body
+    fd = connectClient();
+    std::string header(1, static_cast<char>(binary_protocol::MAGIC));
+    header.push_back(static_cast<char>(binary_protocol::Op::PUT));
+    uint32_t size = SERVER_MAX_REQUEST_BYTES + 1;
+    header.append(reinterpret_cast<const char*>(&size), sizeof(size));
+    sendAll(fd, header);
+    responses = readFrames(fd, 2);
+    REQUIRE(responses.size() == 1);
+    REQUIRE(responses[0].body == "invalid frame");
+    ::close(fd);
+}
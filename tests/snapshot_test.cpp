@@ -0,0 +1,191 @@
+#include "catch2/catch_test_macros.hpp"
+#include "../src/storage/lsm/engine/lsm_engine.hpp"
+#include "../src/storage/lsm/memtable/memtable.hpp"
+#include "../src/storage/lsm/sstable/segment_manager.hpp"
+#include "../src/common/utils/file_utils.hpp"
+#include "../src/config.hpp"
+
+#include <atomic>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::vector<std::pair<std::string, std::string>> drain(KVIterator& it) {
+    std::vector<std::pair<std::string, std::string>> out;
+    for (it.seekToFirst(); it.valid(); it.next()) out.emplace_back(it.key(), it.value());
+    return out;
+}
+
+// flushes one memtable holding the given versions of key
+void flushVersions(SegmentManager& sm, const std::string& key,
+                   const std::vector<std::pair<SequenceNumber, std::string>>& versions,
+                   const std::vector<SequenceNumber>& snapshots) {
+    Memtable mem;
+    for (const auto& [sequence, value] : versions) {
+        if (value == TOMBSTONE_MARKER) mem.remove(key, sequence);
+        else mem.put(key, value, sequence);
+    }
+    sm.flush(*mem.newIterator(), snapshots);
+}
+
+} // namespace
+
+TEST_CASE("[snapshot]: the memtable reads each key as of a sequence number") {
+    Memtable mem;
+    mem.put("a", "a1", 1);
+    mem.put("b", "b2", 2);
+    mem.put("a", "a4", 4);
+    mem.remove("b", 5);
+    mem.put("c", "c6", 6);
+
+    REQUIRE(mem.get("a").value() == "a4");
+    REQUIRE(mem.get("a", 3).value() == "a1");
+    REQUIRE(mem.get("b", 4).value() == "b2");
+    REQUIRE(isTombstone(mem.get("b").value()));
+    REQUIRE(!mem.get("c", 5));
+    REQUIRE(!mem.get("a", 0));
+
+    // a version that arrives late still slots in by its sequence number
+    mem.put("a", "a3", 3);
+    REQUIRE(mem.get("a", 3).value() == "a3");
+    REQUIRE(mem.get("a").value() == "a4");
+
+    auto it = mem.newIterator(3);
+    REQUIRE(drain(*it) == std::vector<std::pair<std::string, std::string>>{{"a", "a3"}, {"b", "b2"}});
+    it->seekToLast();
+    REQUIRE(it->key() == "b");
+    REQUIRE(it->sequence() == 2);
+
+    // versions() ignores the iterator's snapshot
+    it->seek("a");
+    std::vector<ValueVersion> versions;
+    it->versions(versions);
+    REQUIRE(versions.size() == 3);
+    REQUIRE(versions[0].sequence == 4);
+    REQUIRE(versions[1].value == "a3");
+    REQUIRE(versions[2].sequence == 1);
+}
+
+TEST_CASE("[snapshot]: flush and compaction keep only the versions snapshots can read") {
+    std::string dir = "data-snapshot-gc/segments";
+    std::filesystem::remove_all(dir);
+
+    SegmentManager sm;
+    sm.loadSegments(dir);
+
+    // a snapshot at 2, and 4 is the newest visible write
+    flushVersions(sm, "k", {{1, "v1"}, {2, "v2"}, {3, "v3"}, {4, "v4"}}, {2, 4});
+    REQUIRE(sm.lastSequence() == 4);
+    REQUIRE(sm.get("k").value() == "v4");
+    REQUIRE(sm.get("k", 2).value() == "v2");
+    REQUIRE(sm.get("k", 3).value() == "v2"); // nobody can read v3
+    REQUIRE(!sm.get("k", 1));
+
+    // the snapshot is still live when L0 is merged into L1
+    for (SequenceNumber s = 5; s < 4 + LSM_L0_COMPACTION_TRIGGER; ++s) {
+        flushVersions(sm, "k", {{s, "v" + std::to_string(s)}}, {2, s});
+    }
+    SequenceNumber last = 3 + LSM_L0_COMPACTION_TRIGGER;
+    REQUIRE(sm.compact({2, last}));
+    REQUIRE(sm.levelFileCounts()[1] == 1);
+    REQUIRE(sm.get("k", 2).value() == "v2");
+    REQUIRE(sm.get("k").value() == "v" + std::to_string(last));
+
+    // released: the next compaction drops v2, and a tombstone with
+    // nothing under it goes with the key
+    for (size_t i = 0; i < LSM_L0_COMPACTION_TRIGGER; ++i) {
+        ++last;
+        if (i + 1 < LSM_L0_COMPACTION_TRIGGER) flushVersions(sm, "k", {{last, "v" + std::to_string(last)}}, {last});
+        else flushVersions(sm, "k", {{last, TOMBSTONE_MARKER}}, {last});
+    }
+    REQUIRE(sm.compact({last}));
+    REQUIRE(!sm.get("k", 2));
+    REQUIRE(sm.getRange().empty());
+    REQUIRE(sm.lastSequence() == last);
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("[snapshot]: reads through a snapshot ignore later writes, flushes and compactions") {
+    using namespace std;
+    using namespace std::filesystem;
+
+    path walPath = "data-snapshot/db.wal";
+    remove_all(walPath.parent_path());
+
+    {
+        // a 256 byte memtable flushes every few writes, and L0 compacts
+        LSMEngine engine(walPath, 256, "data-snapshot/segments");
+        for (int i = 0; i < 20; ++i) engine.put("k" + to_string(i), "old");
+        auto snapshot = engine.snapshot();
+
+        for (int round = 0; round < 10; ++round) {
+            for (int i = 0; i < 20; ++i) engine.put("k" + to_string(i), "new" + to_string(round));
+            engine.remove("k0");
+            engine.put("extra", "x");
+        }
+
+        for (int i = 0; i < 20; ++i) REQUIRE(engine.get("k" + to_string(i), *snapshot).value() == "old");
+        REQUIRE(!engine.get("extra", *snapshot));
+        {
+            ScanOptions options;
+            options.snapshot = snapshot;
+            size_t rows = 0;
+            for (auto cursor = engine.newCursor(options); cursor->valid(); cursor->next(), ++rows) {
+                REQUIRE(cursor->value() == "old");
+            }
+            REQUIRE(rows == 20);
+        }
+
+        REQUIRE(engine.get("k1").value() == "new9");
+        REQUIRE(!engine.get("k0"));
+        REQUIRE(engine.getRange().size() == 20);
+
+        REQUIRE(engine.liveSnapshots() == 1);
+        snapshot.reset();
+        REQUIRE(engine.liveSnapshots() == 0);
+    }
+
+    // numbering resumes above the flushed and the logged writes
+    LSMEngine engine(walPath, 256, "data-snapshot/segments");
+    auto snapshot = engine.snapshot();
+    engine.put("k1", "after");
+    REQUIRE(engine.get("k1", *snapshot).value() == "new9");
+    REQUIRE(engine.get("k1").value() == "after");
+}
+
+TEST_CASE("[snapshot]: readers never see half of a write batch") {
+    using namespace std;
+    using namespace std::filesystem;
+
+    path walPath = "data-snapshot-batch/db.wal";
+    remove_all(walPath.parent_path());
+
+    LSMEngine engine(walPath, 1024, "data-snapshot-batch/segments");
+    atomic<bool> done{false};
+    thread writer([&]() {
+        for (int i = 0; i < 300; ++i) {
+            WriteBatch batch;
+            batch.put("a", to_string(i));
+            batch.put("b", to_string(i));
+            engine.write(batch);
+        }
+        done.store(true);
+    });
+
+    bool consistent = true;
+    while (!done.load()) {
+        auto snapshot = engine.snapshot();
+        consistent = consistent && engine.get("a", *snapshot) == engine.get("b", *snapshot);
+
+        // a cursor without a snapshot reads one state as well
+        vector<string> values;
+        for (auto cursor = engine.newCursor(); cursor->valid(); cursor->next()) values.emplace_back(cursor->value());
+        consistent = consistent && (values.empty() || (values.size() == 2 && values[0] == values[1]));
+    }
+    writer.join();
+    REQUIRE(consistent);
+    REQUIRE(engine.get("b").value() == "299");
+}
@@ -0,0 +1,111 @@
+#include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <fstream>
+#include "../src/storage/lsm/sstable/sstable_builder.hpp"
+#include "../src/storage/lsm/sstable/sstable_reader.hpp"
+
+namespace fs = std::filesystem;
+
+static std::string paddedKey(int i) {
+    std::string num = std::to_string(i);
+    return "key" + std::string(6 - num.size(), '0') + num;
+}
+
+TEST_CASE("[SSTable]: round trip across many blocks") {
+    fs::create_directories("data-sstable");
+    fs::path path = "data-sstable/multi_block.dat";
+
+    SSTableBuilder builder(path);
+    for (int i = 0; i < 2000; ++i) {
+        builder.add(paddedKey(i), "value" + std::to_string(i));
+    }
+    builder.finish();
+
+    auto reader = SSTableReader::open(path);
+    REQUIRE(reader != nullptr);
+    REQUIRE(reader->entryCount() == 2000);
+    REQUIRE(reader->blockCount() > 1);
+    REQUIRE(reader->smallestKey() == paddedKey(0));
+    REQUIRE(reader->largestKey() == paddedKey(1999));
+
+    REQUIRE(reader->get(paddedKey(0)).value() == "value0");
+    REQUIRE(reader->get(paddedKey(1234)).value() == "value1234");
+    REQUIRE(reader->get(paddedKey(1999)).value() == "value1999");
+    REQUIRE_FALSE(reader->get("aaa").has_value());
+    REQUIRE_FALSE(reader->get("key0012345").has_value());
+    REQUIRE_FALSE(reader->get("zzz").has_value());
+
+    auto all = reader->entries();
+    REQUIRE(all.size() == 2000);
+    REQUIRE(all[42].first == paddedKey(42));
+}
+
+TEST_CASE("[SSTable]: rejects files that are not segments") {
+    fs::create_directories("data-sstable");
+    fs::path path = "data-sstable/garbage.dat";
+    {
+        std::ofstream out(path, std::ios::binary);
+        out << "this is not a segment file, just some bytes of text";
+    }
+    REQUIRE(SSTableReader::open(path) == nullptr);
+}
+
+TEST_CASE("[SSTable]: pread and mmap readers agree, obsolete files are removed on release") {
+    fs::create_directories("data-sstable");
+    fs::path path = "data-sstable/retired.dat";
+
+    SSTableBuilder builder(path);
+    for (int i = 0; i < 500; ++i) {
+        builder.add(paddedKey(i), "value" + std::to_string(i));
+    }
+    builder.finish();
+
+    auto mapped = SSTableReader::open(path, nullptr, true);
+    auto positioned = SSTableReader::open(path, nullptr, false);
+    REQUIRE(mapped != nullptr);
+    REQUIRE(positioned != nullptr);
+    REQUIRE(mapped->get(paddedKey(321)) == positioned->get(paddedKey(321)));
+    REQUIRE(mapped->entries() == positioned->entries());
+
+    auto inFlight = mapped; // e.g. a get racing a compaction
+    mapped->markObsolete();
+    mapped.reset();
+    REQUIRE(fs::exists(path));
+    REQUIRE(inFlight->get(paddedKey(7)).value() == "value7");
+
+    inFlight.reset();
+    REQUIRE_FALSE(fs::exists(path));
+}
+
+TEST_CASE("[SSTable]: iterates backward across blocks") {
+    fs::create_directories("data-sstable");
+    fs::path path = "data-sstable/reverse.dat";
+
+    SSTableBuilder builder(path);
+    for (int i = 0; i < 2000; i += 2) builder.add(paddedKey(i), std::to_string(i));
+    builder.finish();
+
+    auto reader = SSTableReader::open(path);
+    REQUIRE(reader->blockCount() > 1);
+    auto it = reader->newIterator();
+
+    int expected = 1998;
+    for (it->seekToLast(); it->valid(); it->prev(), expected -= 2) {
+        REQUIRE(it->key() == paddedKey(expected));
+    }
+    REQUIRE(expected == -2);
+
+    it->seekForPrev(paddedKey(1001)); // between keys
+    REQUIRE(it->key() == paddedKey(1000));
+    it->seekForPrev(paddedKey(1000)); // exact
+    REQUIRE(it->key() == paddedKey(1000));
+    it->prev();
+    REQUIRE(it->key() == paddedKey(998));
+    it->next();
+    REQUIRE(it->key() == paddedKey(1000));
+
+    it->seekForPrev("zzz");
+    REQUIRE(it->key() == paddedKey(1998));
+    it->seekForPrev("aaa");
+    REQUIRE_FALSE(it->valid());
+}
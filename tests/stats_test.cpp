@@ -0,0 +1,153 @@
+#include "catch2/catch_test_macros.hpp"
+#include "../src/common/utils/stats.hpp"
+#include "../src/cli/command.hpp"
+#include "../src/server/text_protocol.hpp"
+#include "../src/storage/lsm/engine/lsm_engine.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// the value on the "name value" line of a dump, or "" if it isn't there
+std::string valueOf(const std::string& dump, const std::string& name) {
+    std::istringstream lines(dump);
+    for (std::string line; std::getline(lines, line);) {
+        if (line.rfind(name + " ", 0) == 0) return line.substr(name.size() + 1);
+    }
+    return "";
+}
+
+} // namespace
+
+TEST_CASE("[stats]: counters and histograms add up over threads") {
+    StatsRegistry registry;
+    Counter& counter = registry.counter("test.ops");
+    ConcurrentHistogram& latency = registry.histogram("test.nanos");
+    REQUIRE(&registry.counter("test.ops") == &counter);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&]() {
+            for (uint64_t i = 1; i <= 10000; ++i) {
+                counter.add();
+                latency.add(i);
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+
+    REQUIRE(counter.value() == 80000);
+    Histogram merged = latency.snapshot();
+    REQUIRE(merged.count() == 80000);
+    REQUIRE(merged.min() == 1);
+    REQUIRE(merged.max() == 10000);
+
+    Gauge& gauge = registry.gauge("test.level");
+    gauge.set(10);
+    gauge.add(-3);
+    REQUIRE(gauge.value() == 7);
+}
+
+TEST_CASE("[stats]: dumps are sorted and callbacks go with their owner") {
+    StatsRegistry registry;
+    registry.counter("b.count").add(3);
+    registry.histogram("c.nanos").add(42);
+    int owner = 0;
+    uint64_t depth = 5;
+    registry.callback("a.depth", &owner, [&depth]() { return depth; });
+
+    std::string dump = registry.dump();
+    REQUIRE(dump.find("a.depth 5\n") == 0);
+    REQUIRE(valueOf(dump, "b.count") == "3");
+    REQUIRE(valueOf(dump, "c.nanos").rfind("count=1 mean=42.00", 0) == 0);
+    REQUIRE(dump.find("a.depth") < dump.find("b.count"));
+    REQUIRE(dump.find("b.count") < dump.find("c.nanos"));
+
+    depth = 9;
+    REQUIRE(valueOf(registry.dump(), "a.depth") == "9");
+    registry.removeCallbacks(&owner);
+    REQUIRE(valueOf(registry.dump(), "a.depth").empty());
+}
+
+TEST_CASE("[stats]: the exporter appends timestamped dumps") {
+    using namespace std::filesystem;
+    path file = "data-stats/stats.log";
+    remove_all(file.parent_path());
+    create_directories(file.parent_path());
+
+    StatsRegistry registry;
+    registry.counter("test.ops").add(4);
+    {
+        StatsExporter exporter(file, std::chrono::milliseconds(20), registry);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    std::ifstream in(file);
+    size_t lines = 0;
+    for (std::string line; std::getline(in, line); ++lines) {
+        std::istringstream fields(line);
+        uint64_t millis = 0;
+        std::string name, value;
+        fields >> millis >> name >> value;
+        REQUIRE(millis > 0);
+        REQUIRE(name == "test.ops");
+        REQUIRE(value == "4");
+    }
+    // at least one periodic dump and the final one
+    REQUIRE(lines >= 2);
+    remove_all(file.parent_path());
+}
+
+TEST_CASE("[stats]: the stats command reports engine and request metrics") {
+    using namespace std::filesystem;
+    path walPath = "data-stats-engine/db.wal";
+    remove_all(walPath.parent_path());
+
+    {
+        Database db(std::make_unique<LSMEngine>(walPath, LSM_MEMTABLE_BYTES, "data-stats-engine/sstables"));
+        std::string out;
+        // other tests in the process count into the same registry
+        std::string before = valueOf(StatsCommand().execute(db), "db.gets");
+        uint64_t gets = before.empty() ? 0 : std::stoull(before);
+
+        text_protocol::execute("put a apple", db, out);
+        text_protocol::execute("get a", db, out);
+        out.clear();
+        REQUIRE(text_protocol::execute("stats", db, out));
+
+        REQUIRE(std::stoull(valueOf(out, "db.gets")) == gets + 1);
+        REQUIRE(valueOf(out, "db.get_nanos").rfind("count=", 0) == 0);
+        REQUIRE(std::stoull(valueOf(out, "lsm.memtable_bytes")) > 0);
+        REQUIRE(std::stoull(valueOf(out, "wal.bytes_written")) > 0);
+        REQUIRE(!valueOf(out, "lsm.segments").empty());
+    }
+
+    // the engine took its callbacks with it
+    REQUIRE(valueOf(StatsRegistry::process().dump(), "lsm.memtable_bytes").empty());
+    remove_all(walPath.parent_path());
+}
+
+TEST_CASE("[stats]: two engines in one process keep their callbacks apart") {
+    using namespace std::filesystem;
+    remove_all("data-stats-two");
+    auto memtableBytes = []() { return valueOf(StatsRegistry::process().dump(), "lsm.memtable_bytes"); };
+
+    {
+        LSMEngine first("data-stats-two/first/db.wal", LSM_MEMTABLE_BYTES, "data-stats-two/first/sstables");
+        first.put("a", "apple");
+        REQUIRE(std::stoull(memtableBytes()) > 0);
+        {
+            // the newest engine is reported while it lives
+            LSMEngine second("data-stats-two/second/db.wal", LSM_MEMTABLE_BYTES, "data-stats-two/second/sstables");
+            REQUIRE(memtableBytes() == "0");
+        }
+        // and the first one again once it is gone
+        REQUIRE(std::stoull(memtableBytes()) > 0);
+    }
+    REQUIRE(memtableBytes().empty());
+    remove_all("data-stats-two");
+}
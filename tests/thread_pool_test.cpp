@@ -0,0 +1,96 @@
+#include "catch2/catch_test_macros.hpp"
+#include "../src/common/utils/thread_pool.hpp"
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Priority = ThreadPool::Priority;
+
+TEST_CASE("[thread_pool]: queued tasks run by priority") {
+    ThreadPool pool(1);
+    std::promise<void> release;
+    std::shared_future<void> gate = release.get_future().share();
+    std::atomic<bool> blocked{false};
+    // hold the only worker so everything below queues up
+    pool.submit(Priority::NORMAL, [gate, &blocked]() {
+        blocked = true;
+        gate.wait();
+    });
+    while (!blocked) std::this_thread::yield();
+
+    std::mutex mtx;
+    std::string order;
+    auto record = [&](char c) {
+        return [&, c]() {
+            std::lock_guard lock(mtx);
+            order.push_back(c);
+        };
+    };
+    pool.submit(Priority::LOW, record('c'));
+    pool.submit(Priority::NORMAL, record('s'));
+    pool.submit(Priority::LOW, record('C'));
+    pool.submit(Priority::HIGH, record('f'));
+    pool.submit(Priority::NORMAL, record('S'));
+
+    auto stats = pool.stats();
+    REQUIRE(stats.threads == 1);
+    REQUIRE(stats.running == 1);
+    REQUIRE(stats.queued[0] == 1);
+    REQUIRE(stats.queued[1] == 2);
+    REQUIRE(stats.queued[2] == 2);
+
+    release.set_value();
+    while (pool.stats().executed < 6) std::this_thread::yield();
+    // first in, first out within a priority
+    REQUIRE(order == "fsScC");
+}
+
+TEST_CASE("[thread_pool]: idle workers steal queued tasks") {
+    ThreadPool pool(4);
+    std::atomic<int> done{0};
+    std::promise<void> release;
+    std::shared_future<void> gate = release.get_future().share();
+
+    // a task submitted from a worker lands on that worker's deque; the
+    // submitter then blocks, so only other workers can run them
+    pool.submit(Priority::NORMAL, [&, gate]() {
+        for (int i = 0; i < 100; ++i) pool.submit(Priority::NORMAL, [&]() { done.fetch_add(1); });
+        gate.wait();
+    });
+    while (done.load() < 100) std::this_thread::yield();
+    REQUIRE(pool.stats().stolen >= 100);
+    release.set_value();
+}
+
+TEST_CASE("[thread_pool]: callers can run queued work and shutdown drains the queues") {
+    std::atomic<int> done{0};
+    {
+        ThreadPool pool(1);
+        std::promise<void> release;
+        std::shared_future<void> gate = release.get_future().share();
+        std::atomic<bool> blocked{false};
+        pool.submit(Priority::LOW, [gate, &blocked]() {
+            blocked = true;
+            gate.wait();
+        });
+        while (!blocked) std::this_thread::yield();
+
+        pool.submit(Priority::LOW, [&]() { done.fetch_add(1); });
+        pool.submit(Priority::HIGH, [&]() { done.fetch_add(10); });
+        // only the HIGH task qualifies
+        REQUIRE(pool.runPendingTask(Priority::HIGH));
+        REQUIRE(done.load() == 10);
+        REQUIRE(!pool.runPendingTask(Priority::NORMAL));
+
+        // a throwing task doesn't take its worker down
+        pool.submit(Priority::NORMAL, []() { throw std::runtime_error("task failed"); });
+        for (int i = 0; i < 50; ++i) pool.submit(Priority::NORMAL, [&]() { done.fetch_add(100); });
+        release.set_value();
+    }
+    REQUIRE(done.load() == 10 + 1 + 50 * 100);
+}
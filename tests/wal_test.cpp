@@ -3,6 +3,11 @@
 #include <filesystem>
 #include <fstream>
 #include <cstdio>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
 
 TEST_CASE("[wal]: WAL append and deserialize") {
     using namespace std;
@@ -45,3 +50,224 @@ TEST_CASE("[wal]: WAL append and deserialize") {
         REQUIRE(out2.value == "value2");
     }
 }
+
+TEST_CASE("[wal]: concurrent appends are group committed") {
+    using namespace std::filesystem;
+
+    path testPath = "data-group/db.wal";
+    remove_all(testPath.parent_path());
+
+    constexpr int THREADS = 8;
+    constexpr int PER_THREAD = 200;
+    for (WalSyncMode mode : {WalSyncMode::NONE, WalSyncMode::BATCH, WalSyncMode::PERIODIC}) {
+        remove_all(testPath.parent_path());
+        {
+            WAL wal(testPath, mode, std::chrono::milliseconds(5));
+            std::vector<std::thread> threads;
+            for (int t = 0; t < THREADS; ++t) {
+                threads.emplace_back([&wal, t]() {
+                    for (int i = 0; i < PER_THREAD; ++i) {
+                        wal.append(WalRecord{OpType::CREATE, std::to_string(t), std::to_string(i)});
+                    }
+                });
+            }
+            for (auto& th : threads) th.join();
+        }
+
+        // every record is intact, and each writer's records stay in order
+        std::vector<int> next(THREADS, 0);
+        int total = 0;
+        WAL wal(testPath, mode);
+        wal.replay([&](const WalRecord& rec) {
+            int t = std::stoi(rec.key);
+            REQUIRE(std::stoi(rec.value) == next[t]);
+            ++next[t];
+            ++total;
+        });
+        REQUIRE(total == THREADS * PER_THREAD);
+    }
+}
+
+namespace {
+
+std::vector<std::filesystem::path> walFiles(const std::filesystem::path& dir, const std::string& suffix) {
+    std::vector<std::filesystem::path> files;
+    for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+        auto name = entry.path().filename().string();
+        bool recycled = name.size() > 5 && name.compare(name.size() - 5, 5, ".free") == 0;
+        if ((suffix == ".free") == recycled) files.push_back(entry.path());
+    }
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+int replayCount(const std::filesystem::path& path) {
+    int n = 0;
+    WAL wal(path, WalSyncMode::NONE);
+    wal.replay([&](const WalRecord&) { ++n; });
+    return n;
+}
+
+} // namespace
+
+TEST_CASE("[wal]: records roll over into fixed-size segments") {
+    using namespace std::filesystem;
+    path testPath = "data-segments/db.wal";
+    remove_all(testPath.parent_path());
+
+    {
+        WAL wal(testPath, WalSyncMode::NONE, std::chrono::milliseconds(100), 1024);
+        for (int i = 0; i < 100; ++i) {
+            wal.append(WalRecord{OpType::CREATE, "key" + std::to_string(i), std::string(50, 'v')});
+        }
+    }
+
+    auto segments = walFiles(testPath.parent_path(), "");
+    REQUIRE(segments.size() > 5);
+    for (const auto& seg : segments) REQUIRE(file_size(seg) <= 1024);
+
+    std::vector<std::string> keys;
+    WAL wal(testPath, WalSyncMode::NONE, std::chrono::milliseconds(100), 1024);
+    wal.replay([&](const WalRecord& rec) { keys.push_back(rec.key); });
+    REQUIRE(keys.size() == 100);
+    for (int i = 0; i < 100; ++i) REQUIRE(keys[i] == "key" + std::to_string(i));
+}
+
+TEST_CASE("[wal]: obsolete segments are recycled") {
+    using namespace std::filesystem;
+    path testPath = "data-recycle/db.wal";
+    remove_all(testPath.parent_path());
+
+    {
+        WAL wal(testPath, WalSyncMode::BATCH);
+        for (int round = 0; round < 10; ++round) {
+            wal.append(WalRecord{OpType::CREATE, "round", std::to_string(round)});
+            wal.removeSealed(wal.rotate());
+            // each new segment reuses the one released before it
+            REQUIRE(walFiles(testPath.parent_path(), ".free").size() == 1);
+            REQUIRE(walFiles(testPath.parent_path(), "").size() == 1);
+        }
+
+        // the pool is capped; everything beyond it is deleted
+        uint64_t sealed = 0;
+        for (size_t i = 0; i < WAL_RECYCLED_SEGMENTS + 3; ++i) {
+            wal.append(WalRecord{OpType::CREATE, "round", "x"});
+            sealed = wal.rotate();
+        }
+        wal.removeSealed(sealed);
+        REQUIRE(walFiles(testPath.parent_path(), ".free").size() == WAL_RECYCLED_SEGMENTS);
+        REQUIRE(walFiles(testPath.parent_path(), "").size() == 1);
+        wal.append(WalRecord{OpType::CREATE, "last", std::string(10, 'x')});
+    }
+
+    // stale records left in reused segments are not replayed
+    std::vector<std::string> keys;
+    WAL wal(testPath, WalSyncMode::NONE);
+    wal.replay([&](const WalRecord& rec) { keys.push_back(rec.key); });
+    REQUIRE(keys == std::vector<std::string>{"last"});
+}
+
+TEST_CASE("[wal]: a reused segment sealed mid-way through its old records replays cleanly") {
+    using namespace std::filesystem;
+    path testPath = "data-recycle-sealed/db.wal";
+    remove_all(testPath.parent_path());
+
+    {
+        WAL wal(testPath, WalSyncMode::BATCH);
+        for (int i = 0; i < 20; ++i) wal.append(WalRecord{OpType::CREATE, "old", std::string(30, 'o')});
+        wal.removeSealed(wal.rotate());
+        // a shorter record ends inside the old ones, then the segment is sealed
+        wal.append(WalRecord{OpType::CREATE, "reused", "r"});
+        wal.rotate();
+        wal.append(WalRecord{OpType::CREATE, "next", "n"});
+    }
+
+    std::vector<std::string> keys;
+    WAL wal(testPath, WalSyncMode::NONE);
+    wal.replay([&](const WalRecord& rec) { keys.push_back(rec.key); });
+    REQUIRE(keys == std::vector<std::string>{"reused", "next"});
+}
+
+TEST_CASE("[wal]: a torn tail is truncated, corruption before it throws") {
+    using namespace std::filesystem;
+    path testPath = "data-torn/db.wal";
+    remove_all(testPath.parent_path());
+
+    {
+        WAL wal(testPath, WalSyncMode::NONE);
+        for (int i = 0; i < 10; ++i) wal.append(WalRecord{OpType::CREATE, "a" + std::to_string(i), "1"});
+        wal.rotate();
+        for (int i = 0; i < 10; ++i) wal.append(WalRecord{OpType::CREATE, "b" + std::to_string(i), "2"});
+    }
+    auto segments = walFiles(testPath.parent_path(), "");
+    REQUIRE(segments.size() == 2);
+    auto firstSize = file_size(segments[0]);
+    auto lastSize = file_size(segments[1]);
+
+    SECTION("torn final record") {
+        resize_file(segments[1], lastSize - 3);
+        REQUIRE(replayCount(testPath) == 19);
+        REQUIRE(file_size(segments[1]) < lastSize - 3);
+        // the truncated log replays cleanly from then on
+        REQUIRE(replayCount(testPath) == 19);
+    }
+
+    SECTION("flipped byte in the last record") {
+        std::fstream f(segments[1], std::ios::in | std::ios::out | std::ios::binary);
+        f.seekp(static_cast<std::streamoff>(lastSize - 1));
+        f.put('#');
+        f.close();
+        REQUIRE(replayCount(testPath) == 19);
+    }
+
+    SECTION("flipped byte in a sealed segment") {
+        std::fstream f(segments[0], std::ios::in | std::ios::out | std::ios::binary);
+        f.seekp(static_cast<std::streamoff>(firstSize / 2));
+        f.put('#');
+        f.close();
+        WAL wal(testPath, WalSyncMode::NONE);
+        REQUIRE_THROWS_AS(wal.replay([](const WalRecord&) {}), std::runtime_error);
+    }
+
+    SECTION("flipped segment id in a sealed segment") {
+        // the ten records are the same size; the id follows the crc and the size
+        auto recordSize = firstSize / 10;
+        std::fstream f(segments[0], std::ios::in | std::ios::out | std::ios::binary);
+        f.seekp(static_cast<std::streamoff>(3 * recordSize + 8));
+        f.put('#');
+        f.close();
+        WAL wal(testPath, WalSyncMode::NONE);
+        REQUIRE_THROWS_AS(wal.replay([](const WalRecord&) {}), std::runtime_error);
+    }
+}
+
+TEST_CASE("[wal]: logs in the unsegmented format are migrated") {
+    using namespace std::filesystem;
+    path testPath = "data-legacy/db.wal";
+    remove_all(testPath.parent_path());
+    create_directories(testPath.parent_path());
+
+    auto writeLegacy = [](const path& p, const std::vector<WalRecord>& records) {
+        FILE* fp = std::fopen(p.string().c_str(), "wb");
+        REQUIRE(fp != nullptr);
+        for (const auto& rec : records) {
+            auto data = rec.serialize();
+            std::fwrite(data.data(), 1, data.size(), fp);
+        }
+        std::fclose(fp);
+    };
+    writeLegacy(testPath.string() + ".1", {{OpType::CREATE, "k", "sealed"}});
+    writeLegacy(testPath, {{OpType::CREATE, "k", "active"}, {OpType::DELETE, "j", ""}});
+
+    std::vector<std::string> values;
+    {
+        WAL wal(testPath, WalSyncMode::NONE);
+        wal.replay([&](const WalRecord& rec) { values.push_back(rec.value); });
+    }
+    REQUIRE(values == std::vector<std::string>{"sealed", "active", ""});
+    REQUIRE_FALSE(exists(testPath));
+    REQUIRE_FALSE(exists(testPath.string() + ".1"));
+
+    // the records now live in a segment
+    REQUIRE(replayCount(testPath) == 3);
+}
@@ -0,0 +1,78 @@
+#include "catch2/catch_test_macros.hpp"
+#include "../src/storage/write_batch.hpp"
+#include "../src/storage/lsm/engine/lsm_engine.hpp"
+#include "../src/db/database.hpp"
+
+#include <filesystem>
+#include <string>
+
+TEST_CASE("[write_batch]: encode and decode round trip") {
+    WriteBatch batch;
+    batch.put("a", "apple");
+    batch.remove("b");
+    batch.put("", std::string(300, '\0'));
+
+    auto decoded = WriteBatch::decode(batch.encode());
+    REQUIRE(decoded.has_value());
+    REQUIRE(decoded->size() == 3);
+    REQUIRE(decoded->ops()[0].type == OpType::CREATE);
+    REQUIRE(decoded->ops()[0].key == "a");
+    REQUIRE(decoded->ops()[0].value == "apple");
+    REQUIRE(decoded->ops()[1].type == OpType::DELETE);
+    REQUIRE(decoded->ops()[1].key == "b");
+    REQUIRE(decoded->ops()[2].value == std::string(300, '\0'));
+
+    // every truncation is rejected rather than half-decoded
+    auto encoded = batch.encode();
+    for (size_t len = 0; len < encoded.size(); ++len) {
+        REQUIRE_FALSE(WriteBatch::decode(std::string_view(encoded).substr(0, len)).has_value());
+    }
+}
+
+TEST_CASE("[write_batch]: applied through Database and recovered from the WAL") {
+    std::filesystem::remove_all("data-batch");
+    {
+        Database db(std::make_unique<LSMEngine>("data-batch/db.wal", 4096, "data-batch/segments"));
+        db.put("gone", "soon");
+
+        WriteBatch batch;
+        for (int i = 0; i < 100; ++i) batch.put("k" + std::to_string(i), std::to_string(i));
+        batch.remove("gone");
+        batch.put("k7", "seven");
+        db.write(batch);
+
+        REQUIRE(db.get("k99").value() == "99");
+        REQUIRE(db.get("k7").value() == "seven");
+        REQUIRE_FALSE(db.get("gone").has_value());
+    }
+
+    Database db(std::make_unique<LSMEngine>("data-batch/db.wal", 4096, "data-batch/segments"));
+    REQUIRE(db.get("k0").value() == "0");
+    REQUIRE(db.get("k7").value() == "seven");
+    REQUIRE_FALSE(db.get("gone").has_value());
+    REQUIRE(db.getRange().size() == 100);
+}
+
+TEST_CASE("[write_batch]: a torn batch record is dropped as a whole") {
+    std::filesystem::path dir = "data-batch-torn";
+    std::filesystem::remove_all(dir);
+    {
+        LSMEngine engine(dir / "db.wal", LSM_MEMTABLE_BYTES, (dir / "segments").string());
+        engine.put("before", "1");
+
+        WriteBatch batch;
+        for (int i = 0; i < 50; ++i) batch.put("b" + std::to_string(i), "x");
+        engine.write(batch);
+    }
+
+    // cut the log in the middle of the batch record, as a crash mid-write would
+    auto segment = dir / "db.wal-000001";
+    auto size = std::filesystem::file_size(segment);
+    std::filesystem::resize_file(segment, size - 40);
+
+    LSMEngine engine(dir / "db.wal", LSM_MEMTABLE_BYTES, (dir / "segments").string());
+    REQUIRE(engine.get("before").value() == "1");
+    for (int i = 0; i < 50; ++i) REQUIRE_FALSE(engine.get("b" + std::to_string(i)).has_value());
+    // the torn tail is cut off, so the log ends on a record boundary again
+    REQUIRE(std::filesystem::file_size(segment) < size - 40);
+}